@@ -23,24 +23,37 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include "vector.h"
 #include "common.h"
 #include "cslime.h"
+#include "cslime_phys.h"
+#include "cslime_fixed.h"
 
 
-#define CONSERVATION 1
-#define CONSERVATION_WALL .9
-#define TRANSMISSION_DOWN -0.3
-#define TRANSMISSION -0.3
+/* Build with -DCSLIME_NOTRIG to use the trigonometry-free collisions */
+#ifdef CSLIME_NOTRIG
+#define CSLIME_NOTRIG_DEFAULT 1
+#else
+#define CSLIME_NOTRIG_DEFAULT 0
+#endif
 
-static const struct player def_player = {
+/* For the functions whose flags must be folded into every caller */
+#ifdef __GNUC__
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+
+const struct player def_player = {
 	.body = {.pos = {0, 0}, .vel = {0, 0}, .acc = {0, PLAYER_G},
 		.box = {AVATAR_W, AVATAR_H}, .mass = AVATAR_MASS, .drag = 0},
 	.on_fire = 0, .points = 0
 };
 
-static const struct ball def_ball = {
+const struct ball def_ball = {
 	.body = {	.pos = {0, 0},
 				.vel = {.0, .0},
 				.acc = {.0, BALL_G},
@@ -50,53 +63,110 @@ static const struct ball def_ball = {
 			}
 };
 
-static const struct r_vector Default_p0_pos = {
-       	     	    PLAYER_AREA_W * START_POS_RATIO - AVATAR_W/2,
-					    GAME_AREA_H - AVATAR_H*2};
-static const struct r_vector Default_p1_pos = {
-       	            PLAYER_AREA_W * (1 - START_POS_RATIO) + AREA2_STARTX - AVATAR_W/2,
-						GAME_AREA_H - AVATAR_H*2};
-
+/* The derived fields are filled by init_physics_default() */
+struct physics_params PhysicsDefault = {
+	.oversampling = OVERSAMPLING,
+	.ball_g = .000133f, .player_g = .000133f*2,
+	.avatar_vx = PLAYER_AREA_W*0.01f, .avatar_vy = .006f,
+	.vlimitx = {.000f, .0065f}, .vlimity = {.000f, .00515f},
+	.bouncicity = BOUNCICITY, .bouncicity_x = BOUNCICITY_X,
+	.conservation = CONSERVATION, .conservation_wall = CONSERVATION_WALL,
+	.transmission = TRANSMISSION,
+	.floor_hit_tol = FLOOR_HIT_TOL,
+	.start_pos_ratio = START_POS_RATIO, .start_ball_y = START_BALL_Y
+};
 
-static const struct limit ZoneLimX[N_PLAYERS] = {{0, PLAYER_AREA_W},
+const struct limit ZoneLimX[N_PLAYERS] = {{0, PLAYER_AREA_W},
 				{AREA2_STARTX, AREA2_STARTX + PLAYER_AREA_W}};
-static const struct limit LimX = {0, GAME_AREA_W};
-static const struct limit LimY = {0, GAME_AREA_H};
+const struct limit LimX = {0, GAME_AREA_W};
+const struct limit LimY = {0, GAME_AREA_H};
 
 static const struct free_body Net = {.pos = {PLAYER_AREA_W, PLAYER_AREA_H - NET_H},
 				.box = {NET_W, NET_H}};
 
+int physics_params_init(struct physics_params *pp)
+{
+	float sf, sf2;
+
+	if (pp->oversampling < 1 || pp->oversampling > MAX_OVERSAMPLING)
+		return -E_BADARGS;
+
+	/* same operations as SAMPLE_FACTOR and the scaled defines */
+	sf = pp->sample_factor = (pp->oversampling*10.0f)/SIMSTEP;
+	sf2 = sf*sf;
+	pp->scaled.ball_g = pp->ball_g/sf2;
+	pp->scaled.player_g = pp->player_g/sf2;
+	pp->scaled.avatar_vx = pp->avatar_vx/sf;
+	pp->scaled.avatar_vy = pp->avatar_vy/sf;
+	pp->scaled.vlimitx = l_make(pp->vlimitx.min/sf, pp->vlimitx.max/sf);
+	pp->scaled.vlimity = l_make(pp->vlimity.min/sf, pp->vlimity.max/sf);
+
+	/* In double and rounded once, so that neither -ffast-math nor FMA can
+	 * change the result. The fixed point engine starts from these. */
+	pp->start_pos[0] = r_make(
+		(double)PLAYER_AREA_W * pp->start_pos_ratio - AVATAR_W/2.0,
+		GAME_AREA_H - AVATAR_H*2);
+	pp->start_pos[1] = r_make(
+		(double)PLAYER_AREA_W * (1 - (double)pp->start_pos_ratio)
+				+ (double)AREA2_STARTX - AVATAR_W/2.0,
+		GAME_AREA_H - AVATAR_H*2);
+
+	pp->body_class[BODY_CLASS_PLAYER].acc = r_make(0, pp->scaled.player_g);
+	pp->body_class[BODY_CLASS_PLAYER].box = def_player.body.box;
+	pp->body_class[BODY_CLASS_PLAYER].mass = def_player.body.mass;
+	pp->body_class[BODY_CLASS_PLAYER].drag = def_player.body.drag;
+	pp->body_class[BODY_CLASS_BALL].acc = r_make(0, pp->scaled.ball_g);
+	pp->body_class[BODY_CLASS_BALL].box = def_ball.body.box;
+	pp->body_class[BODY_CLASS_BALL].mass = def_ball.body.mass;
+	pp->body_class[BODY_CLASS_BALL].drag = def_ball.body.drag;
+
+	return -E_OK;
+}
+
+/* Parameters built at run time with the default values must be the same as
+ * PhysicsDefault, so its derived fields are computed by the same code. */
+#ifdef __GNUC__
+__attribute__((constructor))
+#endif
+static void init_physics_default(void)
+{
+	physics_params_init(&PhysicsDefault);
+}
+
 void game_reset(struct game *g, int turn)
 {
-	g->p[0].body.pos = Default_p0_pos;
-	g->p[1].body.pos = Default_p1_pos;
+	g->p[0].body.pos = g->phys->start_pos[0];
+	g->p[1].body.pos = g->phys->start_pos[1];
 	g->b.body.pos.x = g->p[turn].body.pos.x +
 				(g->p[turn].body.box.x - g->b.body.box.x)/2;
-	g->b.body.pos.y = START_BALL_Y;
+	g->b.body.pos.y = g->phys->start_ball_y;
 	g->b.body.vel = r_zero;
 }
 
-struct game game_init(int start_points, int first_turn)
+struct game game_init_params(int start_points, int first_turn,
+					const struct physics_params *pp)
 {
 	struct game g;
 	int i;
 
 	for (i = 0; i < N_PLAYERS; i++) {
 		g.p[i] = def_player;
+		body_set_class(&g.p[i].body, pp->body_class + BODY_CLASS_PLAYER);
 		g.p[i].points = start_points;
 	}
 	g.b = def_ball;
+	body_set_class(&g.b.body, pp->body_class + BODY_CLASS_BALL);
+	g.phys = pp;
 
 	game_reset(&g, first_turn);
 
 	return g;
 }
 
-enum {REBOUND_OFF, REBOUND_ON};
-
-struct kinetic {
-	struct r_vector pos, vel;
-};
+struct game game_init(int start_points, int first_turn)
+{
+	return game_init_params(start_points, first_turn, &PhysicsDefault);
+}
 
 /* Physics simulation:
 	1- 'kinetic_step': Propose a new state
@@ -108,7 +178,7 @@ struct kinetic {
 	3- Accept the proposition
 		body <- proposed_state
 */
-static struct kinetic kinetic_step(struct free_body b)
+struct kinetic kinetic_step(struct free_body b)
 {
 	struct kinetic new_k;
 
@@ -158,9 +228,9 @@ static struct kinetic oblique_collision(
 	return new_k;
 }
 
-static struct kinetic original_collision(
+struct kinetic original_collision(
 		struct free_body b, struct kinetic proposed, struct free_body p,
-		float bouncicity)
+		const struct physics_params *phys)
 {
  	struct kinetic new_k;
 	struct r_vector p_center = r_sum(p.pos, r_make(p.box.x/2, p.box.y));
@@ -172,7 +242,7 @@ static struct kinetic original_collision(
 	if (dist < (p.box.x + b.box.y/2) && delta_p.y < 0) {
 		struct r_vector delta_v = r_subs(proposed.vel, p.vel);
 		float bounce_coeff;
-                bounce_coeff = (delta_v.x * delta_p.x * BOUNCICITY_X
+                bounce_coeff = (delta_v.x * delta_p.x * phys->bouncicity_x
 				+ delta_v.y * delta_p.y)/dist;
 		new_k.pos = r_sum(p_center, r_scale(delta_p,
 	 		    		 (p.box.x/2 + b.box.y/2)/dist));
@@ -180,10 +250,11 @@ static struct kinetic original_collision(
 		new_k.vel = proposed.vel;
 		if (bounce_coeff <= 0) {
 			struct r_vector delta_p2 = delta_p;
-			delta_p2.x *= BOUNCICITY_X;
+			delta_p2.x *= phys->bouncicity_x;
  			new_k.vel = r_subs(r_sum(new_k.vel, p.vel),
-				r_scale(delta_p2, bouncicity*bounce_coeff/dist));
-			new_k.vel = r_absclip(new_k.vel, vlimitx, vlimity);
+				r_scale(delta_p2, phys->bouncicity*bounce_coeff/dist));
+			new_k.vel = r_absclip(new_k.vel, phys->scaled.vlimitx,
+							phys->scaled.vlimity);
 		}
 	} else {
 		new_k = proposed;
@@ -194,7 +265,7 @@ static struct kinetic original_collision(
 
 static struct kinetic world_limit_collision(struct free_body b,
 			struct kinetic proposed, struct limit limx,
-						struct limit limy, int rebound)
+					struct limit limy, float conservation)
 {
 	struct kinetic new_k;
 	struct r_vector normal = {0,0};
@@ -214,10 +285,10 @@ static struct kinetic world_limit_collision(struct free_body b,
 	new_k = proposed;
 	if (normal.x)
 		new_k = oblique_collision(b, new_k, r_zero, r_make(normal.x, 0),
-					rebound? CONSERVATION_WALL: 0, 0);
+					conservation, 0);
 	if (normal.y)
 		new_k = oblique_collision(b, new_k, r_zero, r_make(0, normal.y),
-					rebound? CONSERVATION_WALL: 0, 0);
+					conservation, 0);
 
 	return new_k;
 }
@@ -283,23 +354,24 @@ static bool point_segment_near(struct r_vector p, struct r_vector v1,
 	return (p2.x < w1.x) && (p2.x > w2.x) && (p2.y <= w2.y + h) && (p2.y >= w2.y);
 }
 
-static struct kinetic ball_poly_collision(struct ball b, struct kinetic proposed,
-		const struct r_vector *edges, int n_edges, struct r_vector extra_vel,
-		float conservation, float v_transmission)
+struct kinetic ball_poly_collision_p(const struct ball *b,
+		const struct kinetic *proposed, const struct r_vector *edges,
+		int n_edges, struct r_vector extra_vel, float conservation,
+		float v_transmission)
 {
 	struct kinetic new_k;
 	int i;
 
-	new_k = proposed;
+	new_k = *proposed;
 	for (i = 0; i < n_edges; i++) {
 		int i_next;
 
 		i_next = (i + 1)%n_edges;
-		if (point_segment_near(r_sum(proposed.pos, r_scale(b.body.box, .5)),
-				   edges[i], edges[i_next], b.body.box.y/2)) {
+		if (point_segment_near(r_sum(proposed->pos, r_scale(b->body.box, .5)),
+				   edges[i], edges[i_next], b->body.box.y/2)) {
 			struct r_vector normal = r_unit(r_normal(
 						r_subs(edges[i], edges[i_next])));
-			new_k = oblique_collision(b.body, new_k, extra_vel, normal,
+			new_k = oblique_collision(b->body, new_k, extra_vel, normal,
 					conservation, v_transmission);
 		} else {
 			int i_prev = (i == 0)? n_edges - 1 : i - 1;
@@ -309,9 +381,9 @@ static struct kinetic ball_poly_collision(struct ball b, struct kinetic proposed
 			edge.pos = edges[i];
 			edge.vel = extra_vel;
 			l.min = r_to_p(r_subs(edges[i], edges[i_prev])).titha;
-			l.min = r_to_p(r_subs(edges[i_next], edges[i])).titha;
+			l.max = r_to_p(r_subs(edges[i_next], edges[i])).titha;
 
-			new_k = ball_edge_collision(b, new_k, edge,
+			new_k = ball_edge_collision(*b, new_k, edge,
 						l, conservation, v_transmission);
 		}
 	}
@@ -319,18 +391,20 @@ static struct kinetic ball_poly_collision(struct ball b, struct kinetic proposed
 	return new_k;
 }
 
-static struct kinetic ball_player_collision(struct ball b, struct kinetic k, struct player p)
+struct kinetic ball_player_collision_p(const struct ball *b,
+		const struct kinetic *k, const struct player *p,
+		const struct physics_params *phys)
 {
 	struct kinetic new_k;
 	struct r_vector b_center;
 	struct r_vector p_center;
 	struct p_vector incidence;
-	float min_dist = b.body.box.y/2 + p.body.box.y;
+	float min_dist = b->body.box.y/2 + p->body.box.y;
 
-	b_center = r_make(k.pos.x + b.body.box.x / 2,
-					k.pos.y + b.body.box.y/2);
-	p_center = r_make(p.body.pos.x + p.body.box.x / 2,
-					p.body.pos.y + p.body.box.y);
+	b_center = r_make(k->pos.x + b->body.box.x / 2,
+					k->pos.y + b->body.box.y/2);
+	p_center = r_make(p->body.pos.x + p->body.box.x / 2,
+					p->body.pos.y + p->body.box.y);
 
 	incidence = r_to_p(r_subs(b_center, p_center));
 
@@ -339,53 +413,489 @@ static struct kinetic ball_player_collision(struct ball b, struct kinetic k, str
 		/* lets reflect the V vector on the axis given by the normal */
 		/*struct r_vector normal = p_to_r(p_make(1, incidence.titha));*/
 		/*new_k = oblique_collision(b.body, k, p.body.vel, normal,
-						CONSERVATION, TRANSMISSION);
+						phys->conservation, phys->transmission);
 		*/
                 /*NADA*/
-        	new_k = original_collision(b.body, k, p.body, BOUNCICITY);
+        	new_k = original_collision(b->body, *k, p->body, phys);
 	} else if (
-		fabsf(b_center.y - (p.body.pos.y + p.body.box.y)) <  b.body.box.y/2
-		&& b_center.x > p.body.pos.x
-		&& b_center.x < p.body.pos.x + p.body.box.x
+		fabsf(b_center.y - (p->body.pos.y + p->body.box.y)) <  b->body.box.y/2
+		&& b_center.x > p->body.pos.x
+		&& b_center.x < p->body.pos.x + p->body.box.x
 		) {
 		/*new_k = oblique_collision(b.body, k, p.body.vel, r_make(0, 1),
 						CONSERVATION, TRANSMISSION_DOWN); */
-	     new_k = original_collision(b.body, k, p.body, BOUNCICITY);
+	     new_k = original_collision(b->body, *k, p->body, phys);
 	} else{
 		struct kinetic edge;
 		struct limit edgeangles;
 
-		edge.vel = p.body.vel;
+		edge.vel = p->body.vel;
 		if (incidence.titha < (float)M_PI_2) {
-			edge.pos = r_sum(p.body.pos, p.body.box);
+			edge.pos = r_sum(p->body.pos, p->body.box);
 			edgeangles = l_make(-M_PI, -M_PI_2);
 		} else {
-			edge.pos = p.body.pos;
-			edge.pos.y += p.body.box.y;
+			edge.pos = p->body.pos;
+			edge.pos.y += p->body.box.y;
 			edgeangles = l_make(-M_PI_2, 0);
 		}
-		new_k = ball_edge_collision(b, k, edge, edgeangles,
-						CONSERVATION, TRANSMISSION);
+		new_k = ball_edge_collision(*b, *k, edge, edgeangles,
+						phys->conservation, phys->transmission);
+	}
+
+	return new_k;
+}
+
+/* Trigonometry-free versions of the collisions above.
+ * The same tests are done with squared distances and with the signs of dot and
+ * cross products, and the normals are built directly from the difference
+ * vectors, so no r_to_p()/p_to_r() is needed.
+ * The angular sectors are given by two vectors (not necessarily unitary), and
+ * sweep in the positive direction from the direction of the first to the
+ * direction of the second, like the limits given to angle_in_range().
+ */
+static bool dir_in_range(struct r_vector v, struct r_vector from,
+							struct r_vector to)
+{
+	bool after_from = cross_z(from, v) > 0;
+	bool before_to = cross_z(v, to) > 0;
+
+	if (cross_z(from, to) >= 0)
+		return after_from && before_to;
+	else
+		return after_from || before_to;
+}
+
+static struct kinetic ball_edge_collision_notrig(
+		struct ball b, struct kinetic proposed, struct kinetic edge,
+		struct r_vector from, struct r_vector to, float conservation,
+		float v_transmission)
+{
+	struct r_vector b_center, incidence;
+	float radius = b.body.box.y/2;
+	float dist2;
+	struct kinetic new_k;
+
+	b_center = r_make(proposed.pos.x + b.body.box.x / 2,
+					proposed.pos.y + b.body.box.y/2);
+
+	incidence = r_subs(b_center, edge.pos);
+	dist2 = r_abs2(incidence);
+
+	if (dist2 < radius*radius && !dir_in_range(incidence, from, to)) {
+		/* atan2(0, 0) is 0 */
+		struct r_vector normal = (dist2 > 0)?
+				r_scale(incidence, 1.0f/sqrtf(dist2)) : r_make(1, 0);
+		new_k = oblique_collision(b.body, proposed, edge.vel, normal,
+					conservation, v_transmission);
+	} else {
+		new_k = proposed;
+	}
+
+	return new_k;
+}
+
+struct kinetic ball_poly_collision_notrig_p(const struct ball *b,
+		const struct kinetic *proposed, const struct r_vector *edges,
+		int n_edges, struct r_vector extra_vel, float conservation,
+		float v_transmission)
+{
+	struct kinetic new_k;
+	int i;
+
+	new_k = *proposed;
+	for (i = 0; i < n_edges; i++) {
+		int i_next;
+
+		i_next = (i + 1)%n_edges;
+		if (point_segment_near(r_sum(proposed->pos, r_scale(b->body.box, .5)),
+				   edges[i], edges[i_next], b->body.box.y/2)) {
+			struct r_vector normal = r_unit(r_normal(
+						r_subs(edges[i], edges[i_next])));
+			new_k = oblique_collision(b->body, new_k, extra_vel, normal,
+					conservation, v_transmission);
+		} else {
+			int i_prev = (i == 0)? n_edges - 1 : i - 1;
+			struct kinetic edge;
+
+			edge.pos = edges[i];
+			edge.vel = extra_vel;
+
+			new_k = ball_edge_collision_notrig(*b, new_k, edge,
+					r_subs(edges[i], edges[i_prev]),
+					r_subs(edges[i_next], edges[i]),
+					conservation, v_transmission);
+		}
 	}
 
 	return new_k;
 }
 
+/* Precomputed polygons.
+ * Everything that ball_poly_collision() derives from the vertices alone is
+ * computed once, with the same operations, so the results are the same.
+ */
+static struct poly_geometry WorldGeometry, NetGeometry;
+
+struct poly_geometry poly_geometry_make(const struct r_vector *edges,
+							int n_edges)
+{
+	struct poly_geometry pg = {0};
+	int i;
+
+	if (n_edges > POLY_MAX_EDGES)
+		return pg;
+
+	pg.n = n_edges;
+	for (i = 0; i < n_edges; i++) {
+		struct poly_edge *e = pg.e + i;
+		int i_next = (i + 1)%n_edges;
+		int i_prev = (i == 0)? n_edges - 1 : i - 1;
+		struct r_vector v1 = edges[i], v2 = edges[i_next], hyp;
+
+		e->v = v1;
+		e->from = r_subs(edges[i], edges[i_prev]);
+		e->to = r_subs(edges[i_next], edges[i]);
+		e->angles.min = r_to_p(e->from).titha;
+		e->angles.max = r_to_p(e->to).titha;
+		e->normal = r_unit(r_normal(r_subs(v1, v2)));
+
+		/* see point_segment_near() */
+		hyp = r_subs(v1, v2);
+		e->len = r_abs(hyp);
+		e->cos_a = hyp.x / e->len;
+		e->sin_a = hyp.y / e->len;
+		e->w1.x = e->cos_a * v1.x + e->sin_a * v1.y;
+		e->w1.y = -e->sin_a * v1.x + e->cos_a * v1.y;
+		e->w2.x = e->cos_a * v2.x + e->sin_a * v2.y;
+		e->w2.y = -e->sin_a * v2.x + e->cos_a * v2.y;
+	}
+
+	return pg;
+}
+
+#ifdef __GNUC__
+__attribute__((constructor))
+#endif
+static void init_geometry(void)
+{
+	WorldGeometry = poly_geometry_make(world_poly, ARSIZE(world_poly));
+	NetGeometry = poly_geometry_make(net_poly, ARSIZE(net_poly));
+}
+
+static inline bool edge_near(struct r_vector p, const struct poly_edge *e,
+								float h)
+{
+	struct r_vector p2;
+
+	p2.x = e->cos_a * p.x + e->sin_a * p.y;
+	p2.y = -e->sin_a * p.x + e->cos_a * p.y;
+
+	return (p2.x < e->w1.x) && (p2.x > e->w2.x) && (p2.y <= e->w2.y + h)
+							&& (p2.y >= e->w2.y);
+}
+
+static inline struct kinetic _ball_poly_collision_geom(struct ball b,
+		struct kinetic proposed, const struct poly_geometry *pg,
+		struct r_vector extra_vel, float conservation,
+		float v_transmission, bool notrig)
+{
+	struct r_vector center = r_sum(proposed.pos, r_scale(b.body.box, .5));
+	struct kinetic new_k = proposed;
+	int i;
+
+	for (i = 0; i < pg->n; i++) {
+		const struct poly_edge *e = pg->e + i;
+
+		if (edge_near(center, e, b.body.box.y/2)) {
+			new_k = oblique_collision(b.body, new_k, extra_vel,
+					e->normal, conservation, v_transmission);
+		} else {
+			struct kinetic edge;
+
+			edge.pos = e->v;
+			edge.vel = extra_vel;
+			if (notrig)
+				new_k = ball_edge_collision_notrig(b, new_k,
+						edge, e->from, e->to,
+						conservation, v_transmission);
+			else
+				new_k = ball_edge_collision(b, new_k, edge,
+						e->angles, conservation,
+						v_transmission);
+		}
+	}
+
+	return new_k;
+}
+
+struct kinetic ball_poly_collision_geom(struct ball b, struct kinetic proposed,
+		const struct poly_geometry *pg, struct r_vector extra_vel,
+		float conservation, float v_transmission)
+{
+	return _ball_poly_collision_geom(b, proposed, pg, extra_vel,
+				conservation, v_transmission, 0);
+}
+
+struct kinetic ball_poly_collision_geom_notrig(struct ball b,
+		struct kinetic proposed, const struct poly_geometry *pg,
+		struct r_vector extra_vel, float conservation,
+		float v_transmission)
+{
+	return _ball_poly_collision_geom(b, proposed, pg, extra_vel,
+				conservation, v_transmission, 1);
+}
+
+/* 'oblique' selects the realistic model (oblique_collision against the
+ * surface of the player) instead of original_collision. It is meant to be a
+ * constant, so that the other model is compiled out. */
+static ALWAYS_INLINE struct kinetic _ball_player_collision_notrig(
+		const struct ball *b, const struct kinetic *k,
+		const struct player *p, const struct physics_params *phys,
+		bool oblique)
+{
+	struct kinetic new_k;
+	struct r_vector b_center;
+	struct r_vector p_center;
+	struct r_vector incidence;
+	float min_dist = b->body.box.y/2 + p->body.box.y;
+	float dist2;
+
+	b_center = r_make(k->pos.x + b->body.box.x / 2,
+					k->pos.y + b->body.box.y/2);
+	p_center = r_make(p->body.pos.x + p->body.box.x / 2,
+					p->body.pos.y + p->body.box.y);
+
+	incidence = r_subs(b_center, p_center);
+	dist2 = r_abs2(incidence);
+
+	/* incidence.titha in [-pi, 0] <=> incidence.y <= 0 */
+	if (dist2 <= min_dist*min_dist && incidence.y <= 0) {
+		if (oblique) {
+			struct r_vector normal = (dist2 > 0)?
+				r_scale(incidence, 1.0f/sqrtf(dist2))
+				: r_make(0, -1);
+			new_k = oblique_collision(b->body, *k, p->body.vel, normal,
+				phys->conservation, phys->transmission);
+		} else {
+			new_k = original_collision(b->body, *k, p->body, phys);
+		}
+	} else if (
+		fabsf(b_center.y - (p->body.pos.y + p->body.box.y)) <  b->body.box.y/2
+		&& b_center.x > p->body.pos.x
+		&& b_center.x < p->body.pos.x + p->body.box.x
+		) {
+		if (oblique)
+			new_k = oblique_collision(b->body, *k, p->body.vel,
+				r_make(0, 1), phys->conservation,
+				phys->transmission);
+		else
+			new_k = original_collision(b->body, *k, p->body, phys);
+	} else {
+		struct kinetic edge;
+
+		edge.vel = p->body.vel;
+		/* incidence.titha < pi/2 */
+		if (!(incidence.x <= 0 && incidence.y >= 0
+					&& (incidence.x != 0 || incidence.y != 0))) {
+			edge.pos = r_sum(p->body.pos, p->body.box);
+			new_k = ball_edge_collision_notrig(*b, *k, edge,
+					r_make(-1, 0), r_make(0, -1),
+					phys->conservation, phys->transmission);
+		} else {
+			edge.pos = p->body.pos;
+			edge.pos.y += p->body.box.y;
+			new_k = ball_edge_collision_notrig(*b, *k, edge,
+					r_make(0, -1), r_make(1, 0),
+					phys->conservation, phys->transmission);
+		}
+	}
+
+	return new_k;
+}
+
+struct kinetic ball_player_collision_notrig_p(const struct ball *b,
+		const struct kinetic *k, const struct player *p,
+		const struct physics_params *phys)
+{
+	return _ball_player_collision_notrig(b, k, p, phys, 0);
+}
+
+/* By value versions of the collisions above */
+struct kinetic ball_poly_collision(struct ball b, struct kinetic proposed,
+		const struct r_vector *edges, int n_edges, struct r_vector extra_vel,
+		float conservation, float v_transmission)
+{
+	return ball_poly_collision_p(&b, &proposed, edges, n_edges, extra_vel,
+					conservation, v_transmission);
+}
+
+struct kinetic ball_poly_collision_notrig(struct ball b,
+		struct kinetic proposed, const struct r_vector *edges,
+		int n_edges, struct r_vector extra_vel, float conservation,
+		float v_transmission)
+{
+	return ball_poly_collision_notrig_p(&b, &proposed, edges, n_edges,
+				extra_vel, conservation, v_transmission);
+}
+
+struct kinetic ball_player_collision(struct ball b, struct kinetic k,
+			struct player p, const struct physics_params *phys)
+{
+	return ball_player_collision_p(&b, &k, &p, phys);
+}
+
+struct kinetic ball_player_collision_notrig(struct ball b, struct kinetic k,
+			struct player p, const struct physics_params *phys)
+{
+	return ball_player_collision_notrig_p(&b, &k, &p, phys);
+}
+
+/* Broad phase.
+ * The narrow phase tests only look at the proposed position of the ball, and
+ * they return it untouched unless the center of the ball is within one radius
+ * of a surface. We check the segment swept by the center during the substep
+ * against the bounding box of each surface, grown by the radius plus
+ * BROAD_MARGIN to stay clear of rounding errors.
+ * The surfaces are those of world_poly, net_poly and the players' half-discs,
+ * which are inside the bounding box of the body.
+ */
+#define BROAD_MARGIN (BALL_R/8)
+
+struct box {
+	struct limit x, y;
+};
+
+static const struct box WorldBox = {{0, GAME_AREA_W}, {0, GAME_AREA_H}};
+static const struct box NetBox = {{PLAYER_AREA_W, PLAYER_AREA_W + NET_W},
+				{PLAYER_AREA_H - NET_H, PLAYER_AREA_H}};
+
+#ifdef CSLIME_STATS
+struct narrow_stats NarrowStats;
+#define COUNT_NARROW(test, run) (NarrowStats.tested[test]++, \
+				NarrowStats.skipped[test] += !(run))
+#define COUNT_SUBSTEP() (NarrowStats.substeps++)
+#else
+#define COUNT_NARROW(test, run)
+#define COUNT_SUBSTEP()
+#endif /* CSLIME_STATS */
+
+static inline struct box swept_center(struct free_body b, struct kinetic k)
+{
+	struct box sw;
+	float r = b.box.y/2;
+
+	sw.x = l_make(fminf(b.pos.x, k.pos.x) + r, fmaxf(b.pos.x, k.pos.x) + r);
+	sw.y = l_make(fminf(b.pos.y, k.pos.y) + r, fmaxf(b.pos.y, k.pos.y) + r);
+
+	return sw;
+}
+
+/* true if 'sw' comes within 'reach' of the box */
+static inline bool box_near(struct box sw, struct box b, float reach)
+{
+	return sw.x.max > b.x.min - reach && sw.x.min < b.x.max + reach
+		&& sw.y.max > b.y.min - reach && sw.y.min < b.y.max + reach;
+}
+
+/* true if 'sw' comes within 'reach' of the border of the box, from inside */
+static inline bool box_border_near(struct box sw, struct box b, float reach)
+{
+	return sw.x.min < b.x.min + reach || sw.x.max > b.x.max - reach
+		|| sw.y.min < b.y.min + reach || sw.y.max > b.y.max - reach;
+}
+
+static inline struct box body_box(struct free_body b)
+{
+	struct box bb;
+
+	bb.x = l_make(b.pos.x, b.pos.x + b.box.x);
+	bb.y = l_make(b.pos.y, b.pos.y + b.box.y);
+
+	return bb;
+}
+
+/* Run every collision test of the ball against the court and the players.
+ * 'kin' is the proposed state of the ball (see the comment on kinetic_step),
+ * g->b must still hold the current one.
+ * The flags are meant to be constants, see cslime_stepper.h.
+ * 'oblique' uses the realistic collisions with the players (implies notrig),
+ * 'box_world' replaces the court polygon by the rectangle of the court. */
+static ALWAYS_INLINE struct kinetic _ball_collisions_spec(const struct game *g,
+			struct kinetic kin, bool notrig, bool oblique,
+			bool box_world)
+{
+	int i;
+	bool run;
+	const float reach = g->b.body.box.y/2 + BROAD_MARGIN;
+
+	run = box_border_near(swept_center(g->b.body, kin), WorldBox, reach);
+	COUNT_NARROW(NARROW_WORLD, run);
+	if (run && box_world)
+		kin = world_limit_collision(g->b.body, kin, LimX, LimY,
+						g->phys->conservation_wall);
+	else if (run)
+		kin = _ball_poly_collision_geom(g->b, kin, &WorldGeometry,
+				r_zero, g->phys->conservation, 0, notrig);
+
+	for (i = 0; i < N_PLAYERS; i++) {
+		run = box_near(swept_center(g->b.body, kin),
+					body_box(g->p[i].body), reach);
+		COUNT_NARROW(NARROW_PLAYER, run);
+		if (!run)
+			continue;
+		if (oblique || notrig)
+			kin = _ball_player_collision_notrig(&g->b, &kin,
+						g->p + i, g->phys, oblique);
+		else
+			kin = ball_player_collision_p(&g->b, &kin, g->p + i,
+								g->phys);
+	}
+
+	run = box_near(swept_center(g->b.body, kin), NetBox, reach);
+	COUNT_NARROW(NARROW_NET, run);
+	if (run)
+		kin = _ball_poly_collision_geom(g->b, kin, &NetGeometry,
+				r_zero, g->phys->conservation, 0, notrig);
+
+	run = box_border_near(swept_center(g->b.body, kin), WorldBox, reach);
+	COUNT_NARROW(NARROW_WORLD, run);
+	if (run && box_world)
+		kin = world_limit_collision(g->b.body, kin, LimX, LimY,
+						g->phys->conservation_wall);
+	else if (run)
+		kin = _ball_poly_collision_geom(g->b, kin, &WorldGeometry,
+				r_zero, g->phys->conservation, 0, notrig);
+
+	return kin;
+}
+
+static inline struct kinetic _ball_collisions(const struct game *g,
+					struct kinetic kin, bool notrig)
+{
+	return _ball_collisions_spec(g, kin, notrig, 0, 0);
+}
+
+struct kinetic ball_collisions(const struct game *g, struct kinetic kin)
+{
+	return _ball_collisions(g, kin, CSLIME_NOTRIG_DEFAULT);
+}
+
 static inline void apply_kinetic(struct free_body *b, struct kinetic k)
 {
 	b->pos = k.pos;
 	b->vel = k.vel;
 }
 
-static void apply_player_comm(struct player *p,  struct pcontrol pcomm)
+static void apply_player_comm(struct player *p, const struct pcontrol *pcomm,
+					const struct physics_params *phys)
 {
-	if (pcomm.u && p->body.vel.y == 0)
-		p->body.vel.y = -AVATAR_VY;
+	if (pcomm->u && p->body.vel.y == 0)
+		p->body.vel.y = -phys->scaled.avatar_vy;
 
-	if (pcomm.l && !pcomm.r)
-		p->body.vel.x = -AVATAR_VX;
-	else if (!pcomm.l && pcomm.r)
-		p->body.vel.x = AVATAR_VX;
+	if (pcomm->l && !pcomm->r)
+		p->body.vel.x = -phys->scaled.avatar_vx;
+	else if (!pcomm->l && pcomm->r)
+		p->body.vel.x = phys->scaled.avatar_vx;
 	else
 		p->body.vel.x = 0;
 }
@@ -395,7 +905,7 @@ struct game_result game_umpire(struct game *g)
 	struct game_result gr = {0};
 
 	if (fabsf((g->b.body.pos.y + g->b.body.box.y) - GAME_AREA_H)
-		< FLOOR_HIT_TOL) {
+		< g->phys->floor_hit_tol) {
 		if ((g->b.body.pos.x + g->b.body.box.x / 2) < GAME_AREA_W/2) {
 			g->p[0].points--;
 			g->p[1].points++;
@@ -415,45 +925,76 @@ struct game_result game_umpire(struct game *g)
 	return gr;
 }
 
-static void _run_game(struct game *g, struct commands comm)
+static inline void _players_step(struct game *g,
+					const struct commands *comm)
 {
 	int i;
 	struct kinetic kin;
 
 	for (i = 0; i < N_PLAYERS; i++) {
-		apply_player_comm(g->p + i, comm.player[i]);
+		apply_player_comm(g->p + i, comm->player + i, g->phys);
 	}
 
 	/*player physics */
 	for (i = 0; i < N_PLAYERS; i++) {
 		kin = kinetic_step(g->p[i].body);
-		kin = world_limit_collision(g->p[i].body, kin, ZoneLimX[i], LimY, REBOUND_OFF);
+		kin = world_limit_collision(g->p[i].body, kin, ZoneLimX[i], LimY, 0);
 		apply_kinetic(&(g->p[i].body), kin);
 	}
+}
+
+/* Returns true if the ball did not just fly, that is, if it hit something */
+static inline bool _ball_step(struct game *g, bool notrig)
+{
+	struct kinetic free, kin;
+
+	COUNT_SUBSTEP();
+	free = kinetic_step(g->b.body);
+	kin = _ball_collisions(g, free, notrig);
+
+	apply_kinetic(&(g->b.body), kin);
+
+	return memcmp(&kin, &free, sizeof(kin)) != 0;
+}
+
+static inline void _run_game(struct game *g, const struct commands *comm,
+								bool notrig)
+{
+	_players_step(g, comm);
 
 	/* ball physics */
-	kin = kinetic_step(g->b.body);
-	/*kin = world_limit_collision(g->b.body, kin, LimX, LimY, REBOUND_ON);*/
-	kin = ball_poly_collision(g->b, kin, world_poly, ARSIZE(world_poly), r_zero, CONSERVATION, 0);
+	_ball_step(g, notrig);
+}
 
-	for (i = 0; i < N_PLAYERS; i++) {
-		kin = ball_player_collision(g->b, kin, g->p[i]);
-	}
+void players_step(struct game *g, struct commands comm)
+{
+	_players_step(g, &comm);
+}
 
-	kin = ball_poly_collision(g->b, kin, net_poly, ARSIZE(net_poly), r_zero, CONSERVATION, 0);
-	kin = ball_poly_collision(g->b, kin, world_poly, ARSIZE(world_poly), r_zero, CONSERVATION, 0);
-/*	kin = world_limit_collision(g->b.body, kin, LimX, LimY, REBOUND_ON);*/
+void player_step(struct player *p, const struct pcontrol *pcomm,
+		struct limit zone, const struct physics_params *phys)
+{
+	struct kinetic kin;
 
-	apply_kinetic(&(g->b.body), kin);
+	apply_player_comm(p, pcomm, phys);
+	kin = kinetic_step(p->body);
+	kin = world_limit_collision(p->body, kin, zone, LimY, 0);
+	apply_kinetic(&p->body, kin);
 }
 
-struct game_result run_game(struct game *g, struct commands comm)
+void ball_step(struct game *g)
+{
+	_ball_step(g, CSLIME_NOTRIG_DEFAULT);
+}
+
+static inline struct game_result _run_game_frame(struct game *g,
+				const struct commands *comm, bool notrig)
 {
 	int i;
 	struct game_result gr;
 
-	for (i = 0; i < OVERSAMPLING; i++) {
-		_run_game(g, comm);
+	for (i = 0; i < g->phys->oversampling; i++) {
+		_run_game(g, comm, notrig);
 		gr = game_umpire(g);
 		if (gr.set_end) {
 			break;
@@ -461,3 +1002,327 @@ struct game_result run_game(struct game *g, struct commands comm)
 	}
 	return gr;
 }
+
+struct game_result run_game_polar(struct game *g, struct commands comm)
+{
+	return _run_game_frame(g, &comm, 0);
+}
+
+struct game_result run_game_notrig(struct game *g, struct commands comm)
+{
+	return _run_game_frame(g, &comm, 1);
+}
+
+struct game_result run_game_p(struct game *g, const struct commands *comm)
+{
+#ifdef CSLIME_FIXED_POINT
+	/* the fixed point engine only has the default parameters */
+	if (g->phys == &PhysicsDefault)
+		return run_game_fixed(g, *comm);
+#endif
+	return _run_game_frame(g, comm, CSLIME_NOTRIG_DEFAULT);
+}
+
+struct game_result run_game(struct game *g, struct commands comm)
+{
+	return run_game_p(g, &comm);
+}
+
+/* Specialized steppers, see cslime_stepper.h */
+#define STEPPER_NAME classic
+#define STEPPER_OVERSAMPLING OVERSAMPLING
+#define STEPPER_PLAYER_MODEL PLAYER_MODEL_ORIGINAL
+#define STEPPER_WORLD WORLD_POLY
+#include "cslime_stepper.h"
+
+#define STEPPER_NAME oblique
+#define STEPPER_OVERSAMPLING OVERSAMPLING
+#define STEPPER_PLAYER_MODEL PLAYER_MODEL_OBLIQUE
+#define STEPPER_WORLD WORLD_POLY
+#include "cslime_stepper.h"
+
+#define STEPPER_NAME fast
+#define STEPPER_OVERSAMPLING (OVERSAMPLING/2)
+#define STEPPER_PLAYER_MODEL PLAYER_MODEL_ORIGINAL
+#define STEPPER_WORLD WORLD_BOX
+#include "cslime_stepper.h"
+
+const struct engine_variant EngineVariants[N_ENGINE_VARIANTS] = {
+	{"classic", "run_game() with every choice fixed at compile time",
+					OVERSAMPLING, run_game_classic},
+	{"oblique", "realistic collisions with the players",
+					OVERSAMPLING, run_game_oblique},
+	{"fast", "half the substeps, walls without corners",
+					OVERSAMPLING/2, run_game_fast},
+};
+
+int engine_variant_params(const struct engine_variant *v,
+					struct physics_params *pp)
+{
+	*pp = PhysicsDefault;
+	pp->oversampling = v->oversampling;
+
+	return physics_params_init(pp);
+}
+
+/* Fast-forward.
+ * With the commands held, the only thing that can make a frame differ from
+ * plain ballistic motion is the ball getting close to something: a wall, the
+ * floor (which also ends the set), the net or a player. We compute in closed
+ * form the first time at which the center of the ball can enter any of those
+ * regions, and advance the frames before it without any collision test.
+ * The bodies are advanced with the same operations as _run_game(), so the
+ * result is the same as calling run_game() for each frame.
+ */
+
+/* Extra room left around every region, much larger than BROAD_MARGIN, to be
+ * safe from the rounding of the closed form. The floor tolerance of the umpire
+ * is added to it. */
+#define FF_MARGIN (BALL_R/2)
+
+#ifndef CSLIME_FIXED_POINT
+
+/* Add to 'times' the instants in (0, t_max) at which
+ * 	p0 + v*t + acc*t*(t-1)/2 == level
+ * (which is the position after t substeps of a body with constant acc.) */
+static int parabola_crossings(double p0, double v, double acc, double level,
+					double t_max, float *times)
+{
+	double a = acc/2, b = v - acc/2, c = p0 - level;
+	double roots[2];
+	int i, n_roots = 0, n = 0;
+
+	if (a == 0) {
+		if (b != 0)
+			roots[n_roots++] = -c/b;
+	} else {
+		double disc = b*b - 4*a*c;
+
+		if (disc >= 0) {
+			roots[n_roots++] = (-b - sqrt(disc))/(2*a);
+			roots[n_roots++] = (-b + sqrt(disc))/(2*a);
+		}
+	}
+	for (i = 0; i < n_roots; i++) {
+		if (roots[i] > 0 && roots[i] < t_max)
+			times[n++] = roots[i];
+	}
+
+	return n;
+}
+
+static int cmp_float(const void *a, const void *b)
+{
+	float fa = *(const float *)a, fb = *(const float *)b;
+
+	return (fa > fb) - (fa < fb);
+}
+
+/* Intervals of time in [0, t_max] during which the coordinate is inside
+ * 'lim'. Returns how many were written to 'in' (at most 3). */
+static int parabola_inside(float p0, float v, float acc, struct limit lim,
+					float t_max, struct limit *in)
+{
+	float t[6];
+	int i, n = 1, n_in = 0;
+
+	t[0] = 0;
+	n += parabola_crossings(p0, v, acc, lim.min, t_max, t + n);
+	n += parabola_crossings(p0, v, acc, lim.max, t_max, t + n);
+	qsort(t + 1, n - 1, sizeof(*t), cmp_float);
+	t[n++] = t_max;
+
+	for (i = 0; i < n - 1; i++) {
+		float mid = (t[i] + t[i + 1])/2;
+		float p = p0 + v*mid + acc*mid*(mid - 1)/2;
+
+		if (p < lim.min || p > lim.max)
+			continue;
+		if (n_in > 0 && in[n_in - 1].max == t[i])
+			in[n_in - 1].max = t[i + 1];
+		else
+			in[n_in++] = l_make(t[i], t[i + 1]);
+	}
+
+	return n_in;
+}
+
+/* First time at which the center of the ball enters 'region' */
+static float ball_enters(struct free_body b, struct box region, float t_max)
+{
+	struct limit in_x[3], in_y[3];
+	float r = b.box.y/2, first = t_max;
+	int i, j, nx, ny;
+
+	nx = parabola_inside(b.pos.x + r, b.vel.x, b.acc.x, region.x, t_max, in_x);
+	ny = parabola_inside(b.pos.y + r, b.vel.y, b.acc.y, region.y, t_max, in_y);
+
+	for (i = 0; i < nx; i++) {
+		for (j = 0; j < ny; j++) {
+			float lo = fmaxf(in_x[i].min, in_y[j].min);
+
+			if (lo <= fminf(in_x[i].max, in_y[j].max))
+				first = fminf(first, lo);
+		}
+	}
+
+	return first;
+}
+
+/* First time at which the center of the ball leaves 'region' */
+static float ball_leaves(struct free_body b, struct box region, float t_max)
+{
+	struct limit in_x[3], in_y[3];
+	float r = b.box.y/2;
+	int nx, ny;
+
+	nx = parabola_inside(b.pos.x + r, b.vel.x, b.acc.x, region.x, t_max, in_x);
+	ny = parabola_inside(b.pos.y + r, b.vel.y, b.acc.y, region.y, t_max, in_y);
+
+	if (nx == 0 || ny == 0 || in_x[0].min > 0 || in_y[0].min > 0)
+		return 0;
+
+	return fminf(in_x[0].max, in_y[0].max);
+}
+
+static inline struct box box_grow(struct box b, float d)
+{
+	b.x = l_make(b.x.min - d, b.x.max + d);
+	b.y = l_make(b.y.min - d, b.y.max + d);
+
+	return b;
+}
+
+/* Every place the player can reach while holding 'pc'. The limits of the
+ * zone can be overshot by one substep. */
+static struct box player_envelope(struct free_body p, struct pcontrol pc,
+			struct limit zone, const struct physics_params *phys)
+{
+	struct box env = body_box(p);
+	float rise = 0, vy = phys->scaled.avatar_vy;
+
+	if (pc.l && !pc.r)
+		env.x.min = fminf(env.x.min, zone.min - phys->scaled.avatar_vx);
+	else if (!pc.l && pc.r)
+		env.x.max = fmaxf(env.x.max, zone.max + phys->scaled.avatar_vx);
+
+	/* what is left of the current jump, and then a new one */
+	if (p.vel.y < 0)
+		rise += p.vel.y*p.vel.y/(2*p.acc.y) - p.vel.y;
+	if (pc.u)
+		rise += vy*vy/(2*p.acc.y) + vy;
+	env.y.min -= rise;
+	env.y.max = fmaxf(env.y.max, LimY.max);
+
+	return env;
+}
+
+#endif /* CSLIME_FIXED_POINT */
+
+int game_advance_until_event(struct game *g, struct commands comm,
+							int max_frames)
+{
+#ifdef CSLIME_FIXED_POINT
+	/* the frames would have to be advanced in fixed point */
+	return 0;
+#else
+	const float reach = g->b.body.box.y/2 + FF_MARGIN
+						+ g->phys->floor_hit_tol;
+	const int n_sub = g->phys->oversampling;
+	float t_max = (float)max_frames * n_sub, t_event;
+	struct game g_players;
+	bool players_still;
+	int i, f, s, n_frames;
+
+	if (max_frames <= 0 || g->b.body.drag != 0)
+		return 0;
+
+	t_event = ball_leaves(g->b.body, box_grow(WorldBox, -reach), t_max);
+	t_event = fminf(t_event, ball_enters(g->b.body,
+					box_grow(NetBox, reach), t_event));
+	for (i = 0; i < N_PLAYERS; i++) {
+		struct box env = player_envelope(g->p[i].body, comm.player[i],
+							ZoneLimX[i], g->phys);
+		t_event = fminf(t_event, ball_enters(g->b.body,
+					box_grow(env, reach), t_event));
+	}
+
+	/* the frames that end before t_event, less one for safety */
+	n_frames = (t_event >= t_max)? max_frames
+				: (int)ceilf(t_event / n_sub) - 2;
+	if (n_frames <= 0)
+		return 0;
+
+	/* Resting players come back to the same state after each frame, in
+	 * that case there is no need to move them. */
+	g_players = *g;
+	for (s = 0; s < n_sub; s++)
+		_players_step(&g_players, &comm);
+	players_still = 1;
+	for (i = 0; i < N_PLAYERS; i++) {
+		players_still = players_still && !memcmp(&g_players.p[i].body,
+				&g->p[i].body, sizeof(g->p[i].body));
+	}
+
+	for (f = 0; f < n_frames; f++) {
+		for (s = 0; s < n_sub; s++) {
+			if (!players_still)
+				_players_step(g, &comm);
+			apply_kinetic(&(g->b.body), kinetic_step(g->b.body));
+		}
+	}
+
+	return n_frames;
+#endif /* CSLIME_FIXED_POINT */
+}
+
+/* The substeps of the k frames are run in a single loop, with the same calls
+ * as run_game(), so the trajectory is the same as calling it k times. */
+struct repeat_result run_game_repeat(struct game *g, struct commands comm,
+								int k)
+{
+	struct repeat_result rr = {{0}};
+	const int n_sub = g->phys->oversampling;
+	int i, s;
+
+	for (i = 0; i < N_PLAYERS; i++)
+		rr.points[i] = -g->p[i].points;
+
+#ifdef CSLIME_FIXED_POINT
+	if (g->phys == &PhysicsDefault) {
+		/* The frames have to go through the fixed point engine. The
+		 * ball has no drag, so it hit something if it did not end
+		 * up with the speed of free flight. */
+		const float tol = fabsf(g->b.body.acc.y)/2;
+
+		for (; rr.frames < k && !rr.last.set_end; rr.frames++) {
+			struct r_vector vel = r_sum(g->b.body.vel,
+					r_scale(g->b.body.acc, n_sub));
+
+			rr.last = run_game_fixed(g, comm);
+			vel = r_subs(g->b.body.vel, vel);
+			rr.contact = rr.contact || fabsf(vel.x) > tol
+						|| fabsf(vel.y) > tol;
+		}
+		goto run_game_repeat_end;
+	}
+#endif /* CSLIME_FIXED_POINT */
+
+	for (; rr.frames < k && !rr.last.set_end; rr.frames++) {
+		for (s = 0; s < n_sub; s++) {
+			_players_step(g, &comm);
+			rr.contact |= _ball_step(g, CSLIME_NOTRIG_DEFAULT);
+			rr.last = game_umpire(g);
+			if (rr.last.set_end)
+				break;
+		}
+	}
+
+#ifdef CSLIME_FIXED_POINT
+run_game_repeat_end:
+#endif
+	for (i = 0; i < N_PLAYERS; i++)
+		rr.points[i] += g->p[i].points;
+
+	return rr;
+}
@@ -65,6 +65,56 @@ static const struct limit vlimity = {(.000f/SAMPLE_FACTOR), (.00515f/SAMPLE_FACT
 #define N_PLAYERS 2
 #define DEF_START_POINTS 5
 
+/* Most substeps per frame that the engines support */
+#define MAX_OVERSAMPLING 64
+
+/* Per-body constants. They never change during a match and are the same for
+ * every body of a kind, so the engine keeps one copy of them for each kind in
+ * the physics parameters. */
+enum {BODY_CLASS_PLAYER, BODY_CLASS_BALL, N_BODY_CLASSES};
+
+struct body_class {
+	struct r_vector acc, box;
+	float mass, drag;
+};
+
+/* Physics parameters.
+ * The first fields are the settings, in the units of the defines above before
+ * they are divided by SAMPLE_FACTOR (e.g. ball_g = .000133f). After changing
+ * them, physics_params_init() must be called to compute the rest of the
+ * fields, which is what the engine actually uses.
+ * Games refer to their parameters through a pointer, so the parameters must
+ * outlive the games that use them.
+ */
+struct physics_params {
+	int oversampling;
+	float ball_g, player_g;
+	float avatar_vx, avatar_vy;
+	struct limit vlimitx, vlimity; /* clip of the ball speed after a hit */
+	float bouncicity, bouncicity_x;
+	float conservation, conservation_wall, transmission;
+	float floor_hit_tol;
+	float start_pos_ratio, start_ball_y;
+
+	/* derived */
+	float sample_factor;
+	struct {
+		float ball_g, player_g;
+		float avatar_vx, avatar_vy;
+		struct limit vlimitx, vlimity;
+	} scaled;
+	struct r_vector start_pos[N_PLAYERS];
+	struct body_class body_class[N_BODY_CLASSES];
+};
+
+/* The parameters of the original game. The derived fields are filled by
+ * physics_params_init() when the program starts; do not modify it. */
+extern struct physics_params PhysicsDefault;
+
+int physics_params_init(struct physics_params *pp);
+	/* Compute the derived fields. Returns -E_BADARGS if oversampling is
+	 * not between 1 and MAX_OVERSAMPLING. */
+
 struct free_body {
 	struct r_vector pos; /* top-left corner */
 	struct r_vector vel, acc;
@@ -86,6 +136,7 @@ struct ball {
 struct game {
 	struct player p[N_PLAYERS];
 	struct ball b;
+	const struct physics_params *phys;
 };
 
 struct game_result {
@@ -103,11 +154,62 @@ struct commands {
 	bool aux;
 };
 
+/* Outcome of several frames played with the same commands */
+struct repeat_result {
+	struct game_result last;	/* of the last frame played */
+	int frames;		/* less than asked if the set ended */
+	int points[N_PLAYERS];	/* points won (> 0) or lost (< 0) */
+	bool contact;		/* the ball hit a wall, the net or a player */
+};
+
 #define BODY_CENTER(b) (r_sum((b).pos, r_scale((b).box, .5f)))
 
 void game_reset(struct game *g, int turn);
 struct game game_init(int start_points, int first_turn);
+struct game game_init_params(int start_points, int first_turn,
+					const struct physics_params *pp);
+	/* game_init() uses PhysicsDefault */
 struct game_result run_game(struct game *g, struct commands comm);
+struct game_result run_game_p(struct game *g, const struct commands *comm);
+	/* Same as run_game(), without copying the commands */
+int game_advance_until_event(struct game *g, struct commands comm,
+							int max_frames);
+	/* Advance the game, holding the commands, up to the frame in which
+	 * something other than free flight may happen: a collision of the
+	 * ball, the end of the set, or reaching max_frames.
+	 * Returns the number of frames advanced, which can be zero. The game
+	 * ends up as if run_game() had been called that many times.
+	 */
+struct repeat_result run_game_repeat(struct game *g, struct commands comm,
+								int k);
+	/* Play up to k frames with the same commands, stopping after the
+	 * frame in which the set ends. The game ends up as if run_game() had
+	 * been called rr.frames times. */
+
+/* Engine variants with the collision models and the oversampling fixed at
+ * compile time (see cslime_stepper.h). A match picks one and calls its 'run'
+ * instead of run_game(), with parameters made by engine_variant_params().
+ * 	classic: same as run_game()
+ * 	oblique: realistic collisions with the players
+ * 	fast: half the substeps and the court as a rectangle
+ */
+struct engine_variant {
+	const char *name;
+	const char *description;
+	int oversampling;
+	struct game_result (*run)(struct game *g, struct commands comm);
+};
+
+#define N_ENGINE_VARIANTS 3
+extern const struct engine_variant EngineVariants[N_ENGINE_VARIANTS];
+
+int engine_variant_params(const struct engine_variant *v,
+						struct physics_params *pp);
+	/* PhysicsDefault with the oversampling of the variant */
+
+struct game_result run_game_classic(struct game *g, struct commands comm);
+struct game_result run_game_oblique(struct game *g, struct commands comm);
+struct game_result run_game_fast(struct game *g, struct commands comm);
 
 static const struct r_vector net_poly[] = {
 	{PLAYER_AREA_W, PLAYER_AREA_H - NET_H},
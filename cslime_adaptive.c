@@ -0,0 +1,230 @@
+/*
+ * cslime_adaptive.c
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Time is measured in substeps, as in cslime_ccd.c. After 's' substeps of free
+ * flight from (y0, vy0) the substep engine gives
+ * 	y(s) = y0 + vy0*s + acc*s*(s-1)/2
+ * 	vy(s) = vy0 + acc*s
+ * A player's frame is made of at most two such arcs: the one it starts in
+ * and, if it lands while jumping is held, the next jump. A player on the
+ * floor is an arc with no speed and no gravity.
+ */
+
+#include <math.h>
+#include "common.h"
+#include "cslime.h"
+#include "cslime_phys.h"
+#include "cslime_adaptive.h"
+
+/* How close to a player's envelope the ball must get to make us evaluate the
+ * player. It only has to cover the rounding errors. */
+#define ADAPTIVE_MARGIN (BALL_R/8)
+
+#ifdef CSLIME_STATS
+struct adaptive_stats AdaptiveStats;
+#define COUNT_ADAPTIVE(field) (AdaptiveStats.field++)
+#else
+#define COUNT_ADAPTIVE(field)
+#endif /* CSLIME_STATS */
+
+struct arc {
+	int start;	/* substep at which it starts */
+	float y0, vy0, acc;
+};
+
+struct player_plan {
+	float x0, vx;
+	struct limit x;		/* allowed values of pos.x */
+	float floor;		/* pos.y when on the floor */
+	struct arc arc[2];
+	int n_arcs;
+	int land;		/* substep at which arc[0] lands */
+	struct limit env_x, env_y;	/* everything the body covers */
+};
+
+static float arc_y(const struct arc *a, float t)
+{
+	t -= a->start;
+	return a->y0 + a->vy0*t + a->acc*t*(t - 1)/2;
+}
+
+/* First substep after 'a->start' in which the arc goes below 'floor', or a
+ * value above 'n_sub' if it does not before the end of the frame */
+static int arc_landing(const struct arc *a, float floor, int n_sub)
+{
+	/* acc/2*t^2 + (vy0 - acc/2)*t + (y0 - floor) = 0 */
+	float qa = a->acc/2, qb = a->vy0 - a->acc/2, qc = a->y0 - floor;
+	float delta = qb*qb - 4*qa*qc;
+	float t;
+
+	if (qa <= 0 || delta < 0)
+		return n_sub + 1;
+	t = (-qb + sqrtf(delta)) / (2*qa);
+	if (t >= n_sub - a->start)
+		return n_sub + 1;
+
+	return a->start + (int)floorf(t) + 1;
+}
+
+/* Range of y covered by the arc between the substeps 'from' and 'to' */
+static struct limit arc_range(const struct arc *a, float from, float to)
+{
+	float y1 = arc_y(a, from), y2 = arc_y(a, to);
+	struct limit r = l_make(fminf(y1, y2), fmaxf(y1, y2));
+
+	if (a->acc > 0) {
+		/* the top of the parabola, in the continuous extension */
+		float t_top = a->start + .5f - a->vy0/a->acc;
+
+		if (t_top > from && t_top < to)
+			r.min = fminf(r.min, arc_y(a, t_top));
+	}
+
+	return r;
+}
+
+static void plan_player(struct player_plan *pl, const struct player *p,
+			const struct pcontrol *pc, int i, int n_sub,
+			const struct physics_params *phys)
+{
+	const struct free_body *b = &p->body;
+	float acc = b->acc.y;
+	bool grounded;
+	struct limit r;
+	float x_end;
+
+	pl->x = l_make(ZoneLimX[i].min, ZoneLimX[i].max - b->box.x);
+	pl->floor = LimY.max - b->box.y;
+	pl->x0 = b->pos.x;
+	if (pc->l && !pc->r)
+		pl->vx = -phys->scaled.avatar_vx;
+	else if (!pc->l && pc->r)
+		pl->vx = phys->scaled.avatar_vx;
+	else
+		pl->vx = 0;
+
+	/* The substep engine leaves a player on the floor alternating between
+	 * no speed and one substep of gravity, a little above the floor. */
+	grounded = b->vel.y >= 0 && b->vel.y <= acc
+				&& pl->floor - b->pos.y < phys->floor_hit_tol;
+
+	pl->arc[0].start = 0;
+	if (grounded && !pc->u) {
+		pl->arc[0].y0 = pl->floor;
+		pl->arc[0].vy0 = 0;
+		pl->arc[0].acc = 0;
+	} else {
+		pl->arc[0].y0 = b->pos.y;
+		pl->arc[0].vy0 = grounded? -phys->scaled.avatar_vy : b->vel.y;
+		pl->arc[0].acc = acc;
+	}
+	pl->n_arcs = 1;
+	pl->land = arc_landing(pl->arc, pl->floor, n_sub);
+	if (pl->land <= n_sub) {
+		struct arc *next = pl->arc + 1;
+
+		next->start = pl->land;
+		next->y0 = pl->floor;
+		next->vy0 = pc->u? -phys->scaled.avatar_vy : 0;
+		next->acc = pc->u? acc : 0;
+		pl->n_arcs = 2;
+	}
+
+	x_end = fminf(fmaxf(pl->x0 + pl->vx*n_sub, pl->x.min), pl->x.max);
+	pl->env_x = l_make(fminf(pl->x0, x_end), fmaxf(pl->x0, x_end) + b->box.x);
+	if (pl->n_arcs == 1) {
+		r = arc_range(pl->arc, 0, n_sub);
+	} else {
+		struct limit r2 = arc_range(pl->arc + 1, pl->land, n_sub);
+
+		r = arc_range(pl->arc, 0, pl->land - 1);
+		r = l_make(fminf(fminf(r.min, r2.min), pl->floor),
+				fmaxf(fmaxf(r.max, r2.max), pl->floor));
+	}
+	pl->env_y = l_make(r.min, fminf(r.max, pl->floor) + b->box.y);
+}
+
+/* State of the player after 's' substeps */
+static void player_at(const struct player_plan *pl, int s, struct free_body *b)
+{
+	const struct arc *a = pl->arc + (s >= pl->land);
+	float x = pl->x0 + pl->vx*s;
+
+	if (x < pl->x.min || x > pl->x.max) {
+		b->pos.x = fminf(fmaxf(x, pl->x.min), pl->x.max);
+		b->vel.x = 0;
+	} else {
+		b->pos.x = x;
+		b->vel.x = pl->vx;
+	}
+	b->pos.y = fminf(arc_y(a, s), pl->floor);
+	b->vel.y = a->vy0 + a->acc*(s - a->start);
+}
+
+/* Can the ball touch the player during its next substep? */
+static bool ball_near(const struct free_body *ball, const struct player_plan *pl)
+{
+	float r = ball->box.y/2;
+	struct r_vector c = r_make(ball->pos.x + r, ball->pos.y + r);
+	float reach = r + r_abs(ball->vel) + r_abs(ball->acc) + ADAPTIVE_MARGIN;
+
+	return c.x > pl->env_x.min - reach && c.x < pl->env_x.max + reach
+		&& c.y > pl->env_y.min - reach && c.y < pl->env_y.max + reach;
+}
+
+struct game_result run_game_adaptive(struct game *g, struct commands comm)
+{
+	struct game_result gr = {0};
+	struct player_plan plan[N_PLAYERS];
+	const int n_sub = g->phys->oversampling;
+	int s, j;
+
+	COUNT_ADAPTIVE(frames);
+
+	/* Put the players where their plans start, so that a player that is
+	 * not evaluated is always inside its envelope. */
+	for (j = 0; j < N_PLAYERS; j++) {
+		plan_player(plan + j, g->p + j, comm.player + j, j, n_sub,
+								g->phys);
+		player_at(plan + j, 0, &g->p[j].body);
+	}
+
+	for (s = 1; s <= n_sub; s++) {
+		for (j = 0; j < N_PLAYERS; j++) {
+			if (ball_near(&g->b.body, plan + j)) {
+				COUNT_ADAPTIVE(player_steps);
+				player_at(plan + j, s, &g->p[j].body);
+			}
+		}
+		ball_step(g);
+		gr = game_umpire(g);
+		if (gr.set_end)
+			break;
+	}
+
+	for (j = 0; j < N_PLAYERS; j++)
+		player_at(plan + j, (s > n_sub)? n_sub : s, &g->p[j].body);
+
+	return gr;
+}
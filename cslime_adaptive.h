@@ -0,0 +1,60 @@
+/*
+ * cslime_adaptive.h
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Engine with a step rate for each body.
+ * The players move with constant horizontal speed and fall under a constant
+ * gravity, so their whole frame is planned in closed form when the frame
+ * starts: where they land, where they hit the side limits, where they jump
+ * again. Only the ball is stepped OVERSAMPLING times per frame. While it is
+ * close to a player, the player is evaluated at each ball substep so that the
+ * contact sees it where it is at that time; otherwise the player is left
+ * alone until the end of the frame.
+ *
+ * The players rest exactly on the floor and stop exactly at the side limits,
+ * which the substep engine only does up to one substep of motion, so the
+ * result is close to run_game() but not the same: cslime-bench reports the
+ * deviation.
+ */
+
+#ifndef _CSLIME_ADAPTIVE_H_
+#define _CSLIME_ADAPTIVE_H_
+
+#include "cslime.h"
+
+/* Counters, only updated when built with -DCSLIME_STATS.
+ * 'player_steps' counts the evaluations of a player inside a frame, which the
+ * substep engine does N_PLAYERS*OVERSAMPLING times per frame. */
+struct adaptive_stats {
+	unsigned long frames;
+	unsigned long player_steps;
+};
+
+#ifdef CSLIME_STATS
+extern struct adaptive_stats AdaptiveStats;
+#endif
+
+struct game_result run_game_adaptive(struct game *g, struct commands comm);
+	/* Same as run_game(), but the players are moved once per frame */
+
+#endif /* _CSLIME_ADAPTIVE_H_ */
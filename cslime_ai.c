@@ -65,29 +65,51 @@ static float kinematic_solve_x(float x0, float v0, float acc, float delta_t)
 	return x0 + v0*delta_t + 0.5f * acc * delta_t * delta_t;
 }
 
+/* rand(), or rand_r() like if 'seed' is given */
+static int _greedy_rand(unsigned int *seed)
+{
+	if (seed == NULL)
+		return rand();
+
+	*seed = *seed * 1103515245 + 12345;
+	return (*seed >> 16) & 0x7FFF;
+}
+
 struct pcontrol greedy_player(struct game g, int player_number, bool aggressive)
 {
-	struct player me;
+	return greedy_player_p(&g, player_number, aggressive, NULL);
+}
+
+struct pcontrol greedy_player_r(struct game g, int player_number,
+					bool aggressive, unsigned int *seed)
+{
+	return greedy_player_p(&g, player_number, aggressive, seed);
+}
+
+struct pcontrol greedy_player_p(const struct game *g, int player_number,
+					bool aggressive, unsigned int *seed)
+{
+	const struct player *me;
 	struct r_vector my_center, b_center;
 	float t_ground, delta_x;
 	struct pcontrol r = {0};
 
-	me = g.p[player_number];
+	me = g->p + player_number;
 
-	my_center = r_sum(me.body.pos, r_scale(me.body.box, .5));
-	b_center = r_sum(g.b.body.pos, r_scale(g.b.body.box, .5));
+	my_center = r_sum(me->body.pos, r_scale(me->body.box, .5));
+	b_center = r_sum(g->b.body.pos, r_scale(g->b.body.box, .5));
 /* delta_x = x0 + v*t + .5*a*t^2
  */
-	t_ground = kinematic_solve_t(g.b.body.pos.y + g.b.body.box.y,
-			my_center.y, g.b.body.vel.y, g.b.body.acc.y);
+	t_ground = kinematic_solve_t(g->b.body.pos.y + g->b.body.box.y,
+			my_center.y, g->b.body.vel.y, g->b.body.acc.y);
 	if (isnanf(t_ground)) {
 		delta_x = 0;
 	} else if (t_ground < 0) {
-		delta_x = g.b.body.pos.x - my_center.x;
+		delta_x = g->b.body.pos.x - my_center.x;
 	} else {
 		float x_ground;
-		x_ground = kinematic_solve_x(b_center.x, g.b.body.vel.x,
-						g.b.body.acc.x, t_ground);
+		x_ground = kinematic_solve_x(b_center.x, g->b.body.vel.x,
+						g->b.body.acc.x, t_ground);
 		if (x_ground > GAME_AREA_W)
 			x_ground = 2*GAME_AREA_W - x_ground;
 		else if (x_ground < 0)
@@ -107,16 +129,17 @@ struct pcontrol greedy_player(struct game g, int player_number, bool aggressive)
 		struct p_vector incidence;
 		incidence = r_to_p(r_subs(b_center, my_center));
 
-		if ( incidence.value < me.body.box.y*2
+		if ( incidence.value < me->body.box.y*2
 		    && t_ground > 0
-		    && fmaxf(fabsf(delta_x) - me.body.box.x/2, 0)/t_ground > AVATAR_VX) {
+		    && fmaxf(fabsf(delta_x) - me->body.box.x/2, 0)/t_ground
+						> g->phys->scaled.avatar_vx) {
 			r.u = 1;
-		} else if (incidence.value < me.body.box.y*(1.0f + 1.0f/3)) {
+		} else if (incidence.value < me->body.box.y*(1.0f + 1.0f/3)) {
 			if (incidence.titha < -((float)M_PI_4) && incidence.titha >
 							-3*((float)M_PI_4))
-				r.u = (rand()%8 == 0);
-			if (fabsf(b_center.x - my_center.x) < me.body.box.x/4) {
-				bool a = rand()%2;
+				r.u = (_greedy_rand(seed)%8 == 0);
+			if (fabsf(b_center.x - my_center.x) < me->body.box.x/4) {
+				bool a = _greedy_rand(seed)%2;
 				r.l = a;
 				r.r = !a;
 			}
@@ -128,9 +151,6 @@ struct pcontrol greedy_player(struct game g, int player_number, bool aggressive)
 
 /* Backpropagation neural-network player */
 
-enum {BP_INPUT_PX, BP_INPUT_PY, BP_INPUT_BX, BP_INPUT_BY, BP_INPUT_BVX,
-	BP_INPUT_BVY, BP_N_INPUTS};
-
 enum {BP_OUTPUT_L, BP_OUTPUT_R, BP_OUTPUT_JUMP, BP_N_OUTPUTS};
 
 struct MLP neural_bp_player_fread(FILE *f)
@@ -148,20 +168,32 @@ struct MLP neural_bp_player_fread(FILE *f)
 	return r;
 }
 
+/* Create a randomly initialized network with a single hidden layer. */
+struct MLP neural_bp_player_create(int n_hidden, int *ret_code)
+{
+	int topology[3];
+
+	topology[0] = BP_N_INPUTS;
+	topology[1] = n_hidden;
+	topology[2] = BP_N_OUTPUTS;
+
+	return MLP_create(topology, ARSIZE(topology), ret_code);
+}
+
 #define BP_LOGIC_LEVEL (1)
 #define BP_MOVE_RIGHT BP_LOGIC_LEVEL
 #define BP_MOVE_LEFT (-BP_MOVE_RIGHT)
 #define BP_NO_MOVE 0
 
-static void _bp_player_load_inputs(struct game g, int player_number,
+void neural_bp_player_inputs(const struct game *g, int player_number,
 						numeric inputs[BP_N_INPUTS])
 {
-	inputs[BP_INPUT_PX] = g.p[player_number].body.pos.x;
-	inputs[BP_INPUT_PY] = g.p[player_number].body.pos.y;
-	inputs[BP_INPUT_BX] = g.b.body.pos.x;
-	inputs[BP_INPUT_BY] = g.b.body.pos.y;
-	inputs[BP_INPUT_BVX] = g.b.body.vel.x;
-	inputs[BP_INPUT_BVY] = g.b.body.vel.y;
+	inputs[BP_INPUT_PX] = g->p[player_number].body.pos.x;
+	inputs[BP_INPUT_PY] = g->p[player_number].body.pos.y;
+	inputs[BP_INPUT_BX] = g->b.body.pos.x;
+	inputs[BP_INPUT_BY] = g->b.body.pos.y;
+	inputs[BP_INPUT_BVX] = g->b.body.vel.x;
+	inputs[BP_INPUT_BVY] = g->b.body.vel.y;
 }
 
 static void _bp_player_load_outputs(struct pcontrol ctlr,
@@ -201,12 +233,18 @@ static struct pcontrol _bp_player_read_outputs(numeric outputs[BP_N_OUTPUTS])
 
 struct pcontrol neural_bp_player(struct game g, int player_number,
 							struct MLP brain)
+{
+	return neural_bp_player_p(&g, player_number, &brain);
+}
+
+struct pcontrol neural_bp_player_p(const struct game *g, int player_number,
+						const struct MLP *brain)
 {
 	numeric inputs[BP_N_INPUTS];
 	numeric outputs[BP_N_OUTPUTS];
 
-	_bp_player_load_inputs(g, player_number, inputs);
-	MLP_eval(brain, A_TO_VMATRIX(inputs), A_TO_VMATRIX(outputs));
+	neural_bp_player_inputs(g, player_number, inputs);
+	MLP_eval(*brain, A_TO_VMATRIX(inputs), A_TO_VMATRIX(outputs));
 
 	return _bp_player_read_outputs(outputs);
 }
@@ -218,7 +256,7 @@ void bp_player_train_step(struct game g, int player_number,
 	numeric inputs[BP_N_INPUTS];
 	numeric outputs[BP_N_OUTPUTS];
 
-	_bp_player_load_inputs(g, player_number, inputs);
+	neural_bp_player_inputs(&g, player_number, inputs);
 	_bp_player_load_outputs(ctrl_out, outputs);
 
 	MLP_eval_update(brain, A_TO_VMATRIX(inputs), A_TO_VMATRIX(outputs),
@@ -30,13 +30,35 @@
 #include "nn.h"
 
 struct pcontrol greedy_player(struct game g, int player_number, bool aggressive);
+struct pcontrol greedy_player_r(struct game g, int player_number,
+					bool aggressive, unsigned int *seed);
+	/* Same as greedy_player, but the random numbers come from 'seed'
+	 * instead of rand(), so it can be used from several threads. */
+struct pcontrol greedy_player_p(const struct game *g, int player_number,
+					bool aggressive, unsigned int *seed);
+	/* Same as greedy_player_r, without copying the game. 'seed' can be
+	 * NULL to use rand(). */
 
 /* neural player */
 typedef struct MLP NeuralData;
 NeuralData neural_bp_player_fread(FILE *f);
+NeuralData neural_bp_player_create(int n_hidden, int *ret_code);
 #define neural_bp_player_valid_data(d) (MLP_valid(d))
 #define neural_bp_player_destroy_data(d) (MLP_destroy(d))
+#define neural_bp_player_mark_invalid(d) (MLP_mark_invalid(d))
+#define neural_bp_player_share_data(d, ret_code) (MLP_share(d, ret_code))
+#define neural_bp_player_unshare_data(d) (MLP_unshare(d))
 struct pcontrol neural_bp_player(struct game g, int player_number,
 							NeuralData);
+struct pcontrol neural_bp_player_p(const struct game *g, int player_number,
+							const NeuralData *);
+
+/* What the neural player sees of the game, also used as the observations of
+ * cslime_env.h */
+enum {BP_INPUT_PX, BP_INPUT_PY, BP_INPUT_BX, BP_INPUT_BY, BP_INPUT_BVX,
+	BP_INPUT_BVY, BP_N_INPUTS};
+
+void neural_bp_player_inputs(const struct game *g, int player_number,
+						numeric inputs[BP_N_INPUTS]);
 
 #endif /*__CSLIME_AI_H__*/
@@ -0,0 +1,367 @@
+/*
+ * cslime_batch.c
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "common.h"
+#include "cslime.h"
+#include "cslime_phys.h"
+#include "cslime_batch.h"
+#include "vector_wide.h"
+
+/* The lanes are moved with the 8 wide functions, see vector_wide.h */
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+/* The arrays are padded to a multiple of this many lanes, so that each of
+ * them starts at a nicely aligned address and the wide loops can go past the
+ * last lane. It must be a multiple of 8. */
+#define LANE_PAD 16
+
+/* Extra distance kept between the ball and every surface before we
+ * consider that a collision test can be skipped. */
+#define NEAR_MARGIN (BALL_R*2)
+
+struct game_batch game_batch_create(int n, int *ret_code)
+{
+	struct game_batch gb = {0};
+	int padded, n_float, n_int, i;
+
+	padded = ((n + LANE_PAD - 1) / LANE_PAD) * LANE_PAD;
+	n_float = (N_PLAYERS*5 + 8) * padded;
+	n_int = (N_PLAYERS*3 + 2) * padded;
+
+	gb.mem = calloc(1, n_float*sizeof(float) + n_int*sizeof(int)
+						+ n*sizeof(struct game));
+	if (gb.mem == NULL) {
+		if (ret_code != NULL)
+			*ret_code = -E_NOMEM;
+		return gb;
+	}
+
+	gb.n = n;
+	{
+		float *f;
+		int *k;
+
+		f = gb.mem;
+		k = (int*)(f + n_float);
+		gb.frozen = (struct game*)(k + n_int);
+
+		for (i = 0; i < N_PLAYERS; i++) {
+			gb.p[i].body.x = f; f += padded;
+			gb.p[i].body.y = f; f += padded;
+			gb.p[i].body.vx = f; f += padded;
+			gb.p[i].body.vy = f; f += padded;
+			gb.cmd_vx[i] = f; f += padded;
+			gb.p[i].points = k; k += padded;
+			gb.p[i].on_fire = k; k += padded;
+			gb.cmd_u[i] = k; k += padded;
+		}
+		gb.b.x = f; f += padded;
+		gb.b.y = f; f += padded;
+		gb.b.vx = f; f += padded;
+		gb.b.vy = f; f += padded;
+		gb.b_prev.x = f; f += padded;
+		gb.b_prev.y = f; f += padded;
+		gb.b_prev.vx = f; f += padded;
+		gb.b_prev.vy = f; f += padded;
+		gb.active = k; k += padded;
+		gb.near = k; k += padded;
+	}
+
+	if (ret_code != NULL)
+		*ret_code = -E_OK;
+
+	return gb;
+}
+
+void game_batch_destroy(struct game_batch gb)
+{
+	free(gb.mem);
+}
+
+static inline void _lane_set_body(struct body_lanes *bl, int lane,
+						const struct free_body *b)
+{
+	bl->x[lane] = b->pos.x;
+	bl->y[lane] = b->pos.y;
+	bl->vx[lane] = b->vel.x;
+	bl->vy[lane] = b->vel.y;
+}
+
+static inline void _lane_get_body(const struct body_lanes *bl, int lane,
+							struct free_body *b)
+{
+	b->pos.x = bl->x[lane];
+	b->pos.y = bl->y[lane];
+	b->vel.x = bl->vx[lane];
+	b->vel.y = bl->vy[lane];
+}
+
+void game_batch_set(struct game_batch *gb, int lane, const struct game *g)
+{
+	int i;
+
+	for (i = 0; i < N_PLAYERS; i++) {
+		_lane_set_body(&gb->p[i].body, lane, &g->p[i].body);
+		gb->p[i].points[lane] = g->p[i].points;
+		gb->p[i].on_fire[lane] = g->p[i].on_fire;
+	}
+	_lane_set_body(&gb->b, lane, &g->b.body);
+}
+
+struct game game_batch_get(const struct game_batch *gb, int lane)
+{
+	struct game g;
+	int i;
+
+	for (i = 0; i < N_PLAYERS; i++) {
+		g.p[i] = def_player;
+		_lane_get_body(&gb->p[i].body, lane, &g.p[i].body);
+		g.p[i].points = gb->p[i].points[lane];
+		g.p[i].on_fire = gb->p[i].on_fire[lane];
+	}
+	g.b = def_ball;
+	_lane_get_body(&gb->b, lane, &g.b.body);
+	g.phys = &PhysicsDefault;
+
+	return g;
+}
+
+void game_batch_reset(struct game_batch *gb, int lane, int turn)
+{
+	struct game g = game_batch_get(gb, lane);
+
+	game_reset(&g, turn);
+	game_batch_set(gb, lane, &g);
+}
+
+/* Same as apply_player_comm, kinetic_step and world_limit_collision (with
+ * rebound off) in cslime.c, written as a loop without data dependent
+ * branches, so that it can be vectorized. With an axis-aligned normal and no
+ * rebound, oblique_collision reduces to the expressions below.
+ * Lanes which are no longer active are stepped anyway, their state is
+ * restored at the end of the frame.
+ */
+static void _players_step(struct game_batch *gb, int pn)
+{
+	float *restrict x = gb->p[pn].body.x;
+	float *restrict y = gb->p[pn].body.y;
+	float *restrict vx = gb->p[pn].body.vx;
+	float *restrict vy = gb->p[pn].body.vy;
+	const float *restrict cmd_vx = gb->cmd_vx[pn];
+	const int *restrict cmd_u = gb->cmd_u[pn];
+	const struct free_body *pb = &def_player.body;
+	const float w = pb->box.x, h = pb->box.y;
+	const float ax = pb->acc.x, ay = pb->acc.y, drag = pb->drag;
+	const struct limit lx = ZoneLimX[pn], ly = LimY;
+	int i, n = gb->n;
+
+	for (i = 0; i < n; i++) {
+		float x0 = x[i], y0 = y[i], vx0, vy0;
+		float v2, nx, ny, nvx, nvy;
+		int over_x, over_y, hit_x, hit_y;
+
+		/* apply_player_comm */
+		vx0 = cmd_vx[i];
+		vy0 = (cmd_u[i] & (vy[i] == 0))? -AVATAR_VY : vy[i];
+
+		/* kinetic_step */
+		v2 = vx0*vx0 + vy0*vy0;
+		nx = x0 + vx0;
+		ny = y0 + vy0;
+		nvx = (vx0 + ax) - (vx0*v2)*drag;
+		nvy = (vy0 + ay) - (vy0*v2)*drag;
+
+		/* world_limit_collision: hit_x is (normal.x * vel.x < 0) */
+		over_x = nx + w > lx.max;
+		over_y = ny + h > ly.max;
+		hit_x = (over_x & (nvx > 0)) | (!over_x & (nx < lx.min) & (nvx < 0));
+		hit_y = (over_y & (nvy > 0)) | (!over_y & (ny < ly.min) & (nvy < 0));
+
+		nx = hit_x? x0 : nx;
+		ny = hit_x? y0 + nvy : ny;
+		nvx = hit_x? 0.0f : nvx;
+
+		nx = hit_y? x0 + nvx : nx;
+		ny = hit_y? y0 : ny;
+		nvy = hit_y? 0.0f : nvy;
+
+		x[i] = nx;
+		y[i] = ny;
+		vx[i] = nvx;
+		vy[i] = nvy;
+	}
+}
+
+/* kinetic_step for the ball, eight lanes at a time. The previous state is
+ * saved in 'prev', for the lanes which have to go through the narrow phase.
+ * The arrays are padded to LANE_PAD, so the last group can be a partial one.
+ */
+static void _ball_kinetic(int n, struct body_lanes *b, struct body_lanes *prev)
+{
+	const struct free_body *bb = &def_ball.body;
+	const struct r_vector8 acc = r8_splat(bb->acc);
+	const float drag = bb->drag;
+	int i;
+
+	for (i = 0; i < n; i += 8) {
+		struct r_vector8 pos = r8_load(b->x + i, b->y + i);
+		struct r_vector8 vel = r8_load(b->vx + i, b->vy + i);
+		v8f v2 = r8_abs2(vel);
+		struct r_vector8 dv = r8_make(vel.x*v2, vel.y*v2);
+
+		r8_store(pos, prev->x + i, prev->y + i);
+		r8_store(vel, prev->vx + i, prev->vy + i);
+		r8_store(r8_sum(pos, vel), b->x + i, b->y + i);
+		r8_store(r8_subs(r8_sum(vel, acc), r8_scale(dv, drag)),
+						b->vx + i, b->vy + i);
+	}
+}
+
+/* Conservative test of whether any of the collision routines could modify
+ * the proposed state of the ball, eight lanes at a time. Lanes marked in
+ * 'near' have to go through the scalar code in cslime.c.
+ */
+static void _ball_near(struct game_batch *gb)
+{
+	const struct r_vector pbox = def_player.body.box;
+	const float r = def_ball.body.box.y/2, reach = r + NEAR_MARGIN;
+	const v8f reach_v = r8_set1(reach);
+	const v8f w_max = r8_set1(GAME_AREA_W - reach);
+	const v8f h_max = r8_set1(GAME_AREA_H - reach);
+	const v8f net_min = r8_set1(PLAYER_AREA_W - reach);
+	const v8f net_max = r8_set1(PLAYER_AREA_W + NET_W + reach);
+	const v8f net_top = r8_set1(PLAYER_AREA_H - NET_H - reach);
+	const struct r_vector8 margin = r8_splat(r_make(reach, reach));
+	const struct r_vector8 box = r8_splat(pbox);
+	int i, j, n = gb->n;
+
+	for (i = 0; i < n; i += 8) {
+		struct r_vector8 c = r8_sum(r8_load(gb->b.x + i, gb->b.y + i),
+						r8_splat(r_make(r, r)));
+		v8i nr, active;
+
+		/* world_poly */
+		nr = rw_lt(c.x, reach_v) | rw_gt(c.x, w_max)
+			| rw_lt(c.y, reach_v) | rw_gt(c.y, h_max);
+		/* net_poly */
+		nr |= rw_gt(c.x, net_min) & rw_lt(c.x, net_max)
+						& rw_gt(c.y, net_top);
+		/* players: the half-disc lies inside its bounding box */
+		for (j = 0; j < N_PLAYERS; j++) {
+			struct r_vector8 p = r8_load(gb->p[j].body.x + i,
+							gb->p[j].body.y + i);
+			struct r_vector8 p_lo = r8_subs(p, margin);
+			struct r_vector8 p_hi = r8_sum(r8_sum(p, box), margin);
+
+			nr |= rw_gt(c.x, p_lo.x) & rw_lt(c.x, p_hi.x)
+				& rw_gt(c.y, p_lo.y) & rw_lt(c.y, p_hi.y);
+		}
+
+		/* the comparisons give -1 for true */
+		memcpy(&active, gb->active + i, sizeof(active));
+		nr = -nr & active;
+		memcpy(gb->near + i, &nr, sizeof(nr));
+	}
+}
+
+void run_game_batch(struct game_batch *gb, const struct commands *comm,
+						struct game_result *gr)
+{
+	const struct game_result no_result = {0};
+	const float ball_h = def_ball.body.box.y;
+	int i, j, s, n = gb->n, n_active;
+
+#ifdef CSLIME_FIXED_POINT
+	/* the lanes are float, so there is nothing to gain here */
+	for (i = 0; i < n; i++) {
+		struct game g = game_batch_get(gb, i);
+
+		gr[i] = run_game(&g, comm[i]);
+		game_batch_set(gb, i, &g);
+	}
+	return;
+#endif
+	for (i = 0; i < n; i++) {
+		gr[i] = no_result;
+		gb->active[i] = 1;
+		for (j = 0; j < N_PLAYERS; j++) {
+			const struct pcontrol *pc = comm[i].player + j;
+
+			gb->cmd_u[j][i] = pc->u != 0;
+			if (pc->l && !pc->r)
+				gb->cmd_vx[j][i] = -AVATAR_VX;
+			else if (!pc->l && pc->r)
+				gb->cmd_vx[j][i] = AVATAR_VX;
+			else
+				gb->cmd_vx[j][i] = 0;
+		}
+	}
+
+	for (s = 0, n_active = n; s < OVERSAMPLING && n_active > 0; s++) {
+		for (j = 0; j < N_PLAYERS; j++)
+			_players_step(gb, j);
+
+		_ball_kinetic(n, &gb->b, &gb->b_prev);
+		_ball_near(gb);
+
+		/* narrow phase, only for the lanes that need it */
+		for (i = 0; i < n; i++) {
+			if (gb->near[i]) {
+				struct game g = game_batch_get(gb, i);
+				struct kinetic kin;
+
+				_lane_get_body(&gb->b_prev, i, &g.b.body);
+				kin = kinetic_step(g.b.body);
+				kin = ball_collisions(&g, kin);
+				gb->b.x[i] = kin.pos.x;
+				gb->b.y[i] = kin.pos.y;
+				gb->b.vx[i] = kin.vel.x;
+				gb->b.vy[i] = kin.vel.y;
+			}
+		}
+
+		/* game_umpire */
+		for (i = 0; i < n; i++) {
+			if (gb->active[i]
+			    && fabsf((gb->b.y[i] + ball_h) - GAME_AREA_H)
+							< FLOOR_HIT_TOL) {
+				struct game *g = gb->frozen + i;
+
+				*g = game_batch_get(gb, i);
+				gr[i] = game_umpire(g);
+				gb->active[i] = 0;
+				n_active--;
+			}
+		}
+	}
+
+	/* lanes that ended the set stay as they were at that moment */
+	for (i = 0; i < n; i++) {
+		if (!gb->active[i])
+			game_batch_set(gb, i, gb->frozen + i);
+	}
+}
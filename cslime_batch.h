@@ -0,0 +1,78 @@
+/*
+ * cslime_batch.h
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Batched game stepper.
+ * Many games ("lanes") are stored as structure-of-arrays and are advanced in
+ * lockstep. The result for each lane is the same as calling run_game() on it.
+ * All the lanes use PhysicsDefault, the parameters of the games given to
+ * game_batch_set() are not kept.
+ */
+
+#ifndef _CSLIME_BATCH_H_
+#define _CSLIME_BATCH_H_
+
+#include "cslime.h"
+
+struct body_lanes {
+	float *x, *y, *vx, *vy;
+};
+
+struct game_batch {
+	int n; /* number of lanes */
+	struct {
+		struct body_lanes body;
+		int *points;
+		bool *on_fire;
+	} p[N_PLAYERS];
+	struct body_lanes b;
+
+	/* scratch space used by run_game_batch */
+	float *cmd_vx[N_PLAYERS];
+	int *cmd_u[N_PLAYERS];
+	int *active, *near;
+	struct body_lanes b_prev;
+	struct game *frozen;
+
+	void *mem;
+};
+
+#define game_batch_valid(gb) ((gb).mem != NULL)
+
+struct game_batch game_batch_create(int n, int *ret_code);
+void game_batch_destroy(struct game_batch gb);
+
+void game_batch_set(struct game_batch *gb, int lane, const struct game *g);
+struct game game_batch_get(const struct game_batch *gb, int lane);
+void game_batch_reset(struct game_batch *gb, int lane, int turn);
+
+void run_game_batch(struct game_batch *gb, const struct commands *comm,
+						struct game_result *gr);
+	/* Advance every lane by one frame. comm[i] and gr[i] are the commands
+	 * and the result for lane i. Lanes that reach the end of a set stop
+	 * being simulated for the rest of the frame, like run_game() does.
+	 * It is up to the caller to reset them (game_batch_reset) or reload
+	 * them (game_batch_set) according to gr[i].set_end and gr[i].game_end.
+	 */
+
+#endif /* _CSLIME_BATCH_H_ */
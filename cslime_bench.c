@@ -0,0 +1,2310 @@
+/*
+ * cslime_bench.c
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Headless benchmark of the physics and the AI.
+ *
+ * 	cslime-bench [-f frames] [-s seed] [-n player.net] [-t threads] [test ...]
+ *
+ * Without arguments all the tests are run. The physics-only tests replay the
+ * commands recorded from a greedy vs. greedy match, so that the cost of the
+ * AI is not included.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "common.h"
+#include "cslime.h"
+#include "cslime_phys.h"
+#include "cslime_ai.h"
+#include "cslime_batch.h"
+#include "cslime_env.h"
+#include "cslime_shm.h"
+#include "cslime_fixed.h"
+#include "cslime_ccd.h"
+#include "cslime_adaptive.h"
+#include "cslime_multi.h"
+#include "vector_wide.h"
+#include "fastmath.h"
+#include "cslime_snap.h"
+#include "cslime_rec.h"
+#include "cslime_traj.h"
+#include "cslime_rollout.h"
+
+/* For the wide kernels, see the note in vector_wide.h */
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+#define DEF_FRAMES 200000
+#define DEF_SEED 1
+#define N_HIDDEN 12
+#define N_SAMPLES 4096
+#define KERNEL_REPEAT 64
+#define BATCH_LANES 1024
+#define ENV_ACTION_TABLES 64
+#define SHM_ROUND_TRIPS 20000
+#define SHM_CHECK_STEPS 512
+#define SEEK_SAMPLES 1024
+#define SEEK_FILE "/tmp/cslime-bench-XXXXXX"
+#define AGREE_HORIZON 32
+#define AGREE_TOL (BALL_R/4)
+#define AGREE_MISMATCH_TOL .01
+#define UNTIL_HORIZON 256
+#define REPEAT_MAX 8
+#define SNAPSHOT_HORIZON 64
+#define ROLLOUT_JOBS 256
+#define STATE_BUFFER (1 << 18)
+#define STATE_ROLLOUT 8
+#define MULTI_MAX_BODIES 64
+#define WIDE_VECTORS 4096
+#define WIDE_REPEAT 256
+/* r_abs() uses hypotf(), the wide versions sqrt() */
+#define WIDE_ABS_TOL 4e-7f
+#define MATH_SAMPLES 4096
+#define MATH_REPEAT 256
+
+struct bench_ctx {
+	int frames;
+	unsigned int seed;
+	int threads;	/* most threads used by the rollout test */
+	NeuralData brain;
+
+	/* recorded greedy vs. greedy match */
+	struct commands *comm;
+	int *new_turn;	/* turn given to game_init after game_end */
+	struct game *samples; /* states spread along the match */
+	int n_samples, sample_every;
+
+	bool failed;
+};
+
+struct bench {
+	const char *name;
+	void (*run)(struct bench_ctx *ctx);
+	const char *help;
+};
+
+/* sink for results that must not be optimized away */
+volatile float bench_sink;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static void report(const char *test, const char *what, double value,
+							const char *unit)
+{
+	printf("%-10s %-28s %14.2f %s\n", test, what, value, unit);
+}
+
+/* FNV-1a of the state of the bodies, to compare trajectories between builds */
+static unsigned long hash_game(unsigned long h, const struct game *g)
+{
+	const struct r_vector v[] = {g->p[0].body.pos, g->p[0].body.vel,
+		g->p[1].body.pos, g->p[1].body.vel, g->b.body.pos, g->b.body.vel};
+	const unsigned char *c = (const unsigned char *)v;
+	int i;
+
+	for (i = 0; i < sizeof(v); i++)
+		h = ((h ^ c[i]) * 16777619UL) & 0xFFFFFFFFUL;
+
+	return h;
+}
+
+static bool _same_snapshot(const struct game_snapshot *a,
+					const struct game_snapshot *b)
+{
+	return !memcmp(a->body, b->body, sizeof(a->body))
+		&& !memcmp(a->points, b->points, sizeof(a->points))
+		&& a->on_fire == b->on_fire;
+}
+
+static bool _same_game(const struct game *a, const struct game *b)
+{
+	struct game_snapshot sa, sb;
+
+	game_snapshot(a, &sa);
+	game_snapshot(b, &sb);
+	return _same_snapshot(&sa, &sb);
+}
+
+static struct commands xorshift_commands(uint32_t *x)
+{
+	struct commands c = {{{0}}};
+	int i;
+
+	*x ^= *x << 13;
+	*x ^= *x >> 17;
+	*x ^= *x << 5;
+	for (i = 0; i < N_PLAYERS; i++) {
+		c.player[i].u = (*x >> (i*4)) & 1;
+		c.player[i].l = (*x >> (i*4 + 1)) & 1;
+		c.player[i].r = (*x >> (i*4 + 2)) & 1;
+	}
+
+	return c;
+}
+
+/* Advance the game like the main loop of the UI does */
+static void next_set(struct game *g, struct game_result gr, int new_turn)
+{
+	if (gr.game_end)
+		*g = game_init_params(DEF_START_POINTS, new_turn, g->phys);
+	else if (gr.set_end)
+		game_reset(g, gr.has_to_start);
+}
+
+static int record_match(struct bench_ctx *ctx)
+{
+	struct game g;
+	int f, every;
+
+	if (NMALLOC(ctx->comm, ctx->frames) == NULL
+	    || NMALLOC(ctx->new_turn, ctx->frames) == NULL
+	    || NMALLOC(ctx->samples, N_SAMPLES) == NULL)
+		return -E_NOMEM;
+
+	srand(ctx->seed);
+	g = game_init(DEF_START_POINTS, 0);
+	every = (ctx->frames > N_SAMPLES)? ctx->frames / N_SAMPLES : 1;
+	ctx->sample_every = every;
+	ctx->n_samples = 0;
+
+	for (f = 0; f < ctx->frames; f++) {
+		struct commands *c = ctx->comm + f;
+		struct game_result gr;
+
+		memset(c, 0, sizeof(*c));
+		c->player[0] = greedy_player(g, 0, 1);
+		c->player[1] = greedy_player(g, 1, 1);
+
+		if (f % every == 0 && ctx->n_samples < N_SAMPLES)
+			ctx->samples[ctx->n_samples++] = g;
+
+		gr = run_game(&g, *c);
+		ctx->new_turn[f] = rand()%2;
+		next_set(&g, gr, ctx->new_turn[f]);
+	}
+
+	return -E_OK;
+}
+
+static void _match(const char *test, struct bench_ctx *ctx, bool neural)
+{
+	struct game g;
+	struct commands comm = {{{0}}};
+	int f, sets = 0, won = 0;
+	double t0, t;
+
+	srand(ctx->seed);
+	g = game_init(DEF_START_POINTS, 0);
+
+	t0 = now();
+	for (f = 0; f < ctx->frames; f++) {
+		struct game_result gr;
+
+		comm.player[0] = greedy_player(g, 0, 1);
+		if (neural)
+			comm.player[1] = neural_bp_player(g, 1, ctx->brain);
+		else
+			comm.player[1] = greedy_player(g, 1, 1);
+
+		gr = run_game(&g, comm);
+		sets += gr.set_end;
+		won += gr.set_end && gr.scorer_player == 1;
+		next_set(&g, gr, rand()%2);
+	}
+	t = now() - t0;
+
+	report(test, "frames/s (physics + AI)", ctx->frames / t, "");
+	report(test, "sets played", sets, "");
+	report(test, "sets won by player 1", sets? 100.0 * won / sets : 0, "%");
+}
+
+static void bench_greedy(struct bench_ctx *ctx)
+{
+	_match("greedy", ctx, 0);
+}
+
+static void bench_neural(struct bench_ctx *ctx)
+{
+	_match("neural", ctx, 1);
+}
+
+static unsigned long _replay_params(const char *test, struct bench_ctx *ctx,
+		struct game_result (*engine)(struct game *, struct commands),
+		const struct physics_params *pp)
+{
+	struct game g;
+	int f;
+	long substeps;
+	unsigned long h = 2166136261UL;
+	uint32_t x;
+	struct commands comm;
+	double t0, t;
+
+	g = game_init_params(DEF_START_POINTS, 0, pp);
+
+	t0 = now();
+	for (f = 0; f < ctx->frames; f++) {
+		struct game_result gr = engine(&g, ctx->comm[f]);
+		next_set(&g, gr, ctx->new_turn[f]);
+	}
+	t = now() - t0;
+
+	/* run_game stops early at the end of a set, which is rare enough to
+	 * be ignored here */
+	substeps = (long)ctx->frames * pp->oversampling;
+
+	report(test, "frames/s", ctx->frames / t, "");
+	report(test, "substeps/s", substeps / t, "");
+	report(test, "ns/frame", t*1e9 / ctx->frames, "ns");
+
+	/* Second, untimed, pass for the trajectory hash. The recorded match
+	 * depends on the float engine and on rand(), so we use commands that
+	 * only depend on the seed. */
+	g = game_init_params(DEF_START_POINTS, 0, pp);
+	x = ctx->seed | 1;
+	for (f = 0; f < ctx->frames; f++) {
+		struct game_result gr;
+
+		if (f % 8 == 0)
+			comm = xorshift_commands(&x);
+		gr = engine(&g, comm);
+		next_set(&g, gr, f%2);
+		h = hash_game(h, &g);
+	}
+	printf("%-10s %-28s %14s %08lx\n", test, "trajectory hash", "", h);
+
+	return h;
+}
+
+static void _replay(const char *test, struct bench_ctx *ctx,
+		struct game_result (*engine)(struct game *, struct commands))
+{
+	_replay_params(test, ctx, engine, &PhysicsDefault);
+}
+
+static void bench_physics(struct bench_ctx *ctx)
+{
+	_replay("physics", ctx, run_game);
+}
+
+static void bench_fixed(struct bench_ctx *ctx)
+{
+	_replay("fixed", ctx, run_game_fixed);
+}
+
+static void bench_notrig(struct bench_ctx *ctx)
+{
+	_replay("notrig", ctx, run_game_notrig);
+}
+
+static void bench_broad(struct bench_ctx *ctx)
+{
+#ifdef CSLIME_STATS
+	static const char *names[N_NARROW_TESTS] = {"world_poly", "players",
+								"net_poly"};
+	struct narrow_stats zero = {0};
+	struct game g;
+	int f, t;
+
+	NarrowStats = zero;
+	g = game_init(DEF_START_POINTS, 0);
+	for (f = 0; f < ctx->frames; f++) {
+		struct game_result gr = run_game(&g, ctx->comm[f]);
+		next_set(&g, gr, ctx->new_turn[f]);
+	}
+
+	report("broad", "substeps", NarrowStats.substeps, "");
+	for (t = 0; t < N_NARROW_TESTS; t++) {
+		char what[40];
+
+		sprintf(what, "%s skipped", names[t]);
+		report("broad", what, 100.0 * NarrowStats.skipped[t]
+				/ NarrowStats.tested[t], "%");
+	}
+#else
+	printf("broad      build with -DCSLIME_STATS to get the counters\n");
+#endif /* CSLIME_STATS */
+}
+
+/* The engine reads the parameters from the game. Parameters built at run time
+ * with the default settings must give the same trajectories as
+ * PhysicsDefault, at the same speed. */
+static void bench_params(struct bench_ctx *ctx)
+{
+	struct physics_params pp = PhysicsDefault, coarse = PhysicsDefault;
+	unsigned long h_default, h_runtime;
+	bool same;
+
+	physics_params_init(&pp);
+	same = !memcmp(&pp, &PhysicsDefault, sizeof(pp));
+	report("params", "derived fields match", same, "");
+
+	h_default = _replay_params("params", ctx, run_game, &PhysicsDefault);
+	h_runtime = _replay_params("params/rt", ctx, run_game, &pp);
+#ifdef CSLIME_FIXED_POINT
+	/* only PhysicsDefault goes through the fixed point engine */
+	h_runtime = h_default;
+#else
+	report("params", "same trajectories", h_default == h_runtime, "");
+#endif
+
+	/* another engine in the same process */
+	coarse.oversampling = OVERSAMPLING/2;
+	physics_params_init(&coarse);
+	_replay_params("params/2", ctx, run_game, &coarse);
+
+	if (!same || h_default != h_runtime) {
+		printf("params     FAILED\n");
+		ctx->failed = 1;
+	}
+}
+
+/* The classic variant must give the trajectories of run_game(), both with its
+ * own oversampling and through the run-time fallback. */
+static void bench_variants(struct bench_ctx *ctx)
+{
+	struct physics_params pp, coarse = PhysicsDefault;
+	unsigned long h_ref, h_classic = 0, h_ref2, h_classic2;
+	int v;
+
+	h_ref = _replay_params("variants", ctx, run_game, &PhysicsDefault);
+	for (v = 0; v < N_ENGINE_VARIANTS; v++) {
+		char test[20];
+		unsigned long h;
+
+		engine_variant_params(EngineVariants + v, &pp);
+		sprintf(test, "var/%s", EngineVariants[v].name);
+		h = _replay_params(test, ctx, EngineVariants[v].run, &pp);
+		if (v == 0)
+			h_classic = h;
+	}
+
+	coarse.oversampling = OVERSAMPLING/2;
+	physics_params_init(&coarse);
+	h_ref2 = _replay_params("variants/2", ctx, run_game, &coarse);
+	h_classic2 = _replay_params("var/classic/2", ctx, run_game_classic,
+								&coarse);
+#ifdef CSLIME_FIXED_POINT
+	/* run_game() uses the fixed point engine for PhysicsDefault */
+	h_classic = h_ref;
+#endif
+
+	if (h_ref != h_classic || h_ref2 != h_classic2) {
+		printf("variants   FAILED\n");
+		ctx->failed = 1;
+	}
+}
+
+/* The CCD engine is not expected to give the same trajectories, we measure
+ * how far it gets from the substep engine in one frame. */
+static void bench_ccd(struct bench_ctx *ctx)
+{
+	int i, n = 0, set_mismatch = 0;
+	double dev_sum = 0, dev_max = 0;
+#ifdef CSLIME_STATS
+	struct ccd_stats zero = {0};
+
+	CcdStats = zero;
+#endif
+
+	_replay("ccd", ctx, run_game_ccd);
+
+	for (i = 0; i < ctx->n_samples; i++) {
+		struct game a = ctx->samples[i], b = a;
+		int f = i * ctx->sample_every;
+		struct game_result gra, grb;
+		double dev;
+
+		gra = run_game(&a, ctx->comm[f]);
+		grb = run_game_ccd(&b, ctx->comm[f]);
+		if (gra.set_end != grb.set_end) {
+			set_mismatch++;
+			continue;
+		}
+		dev = r_dist(a.b.body.pos, b.b.body.pos);
+		dev_sum += dev;
+		dev_max = fmax(dev_max, dev);
+		n++;
+	}
+
+	report("ccd", "mean deviation per frame", dev_sum / n / BALL_R * 1e6,
+							"ppm of BALL_R");
+	report("ccd", "max deviation per frame", dev_max / BALL_R * 1e6,
+							"ppm of BALL_R");
+	report("ccd", "set end mismatches", set_mismatch, "");
+#ifdef CSLIME_STATS
+	report("ccd", "steps/frame", (double)CcdStats.steps / CcdStats.frames, "");
+	report("ccd", "contacts/frame",
+			(double)CcdStats.contacts / CcdStats.frames, "");
+	report("ccd", "fallbacks/frame",
+			(double)CcdStats.fallbacks / CcdStats.frames, "");
+#endif
+}
+
+/* Like the CCD engine, the adaptive engine is compared one frame at a time */
+static void bench_adaptive(struct bench_ctx *ctx)
+{
+	int i, n = 0, set_mismatch = 0;
+	double dev_sum = 0, dev_max = 0, pdev_max = 0;
+#ifdef CSLIME_STATS
+	struct adaptive_stats zero = {0};
+
+	AdaptiveStats = zero;
+#endif
+
+	_replay("adaptive", ctx, run_game_adaptive);
+
+	for (i = 0; i < ctx->n_samples; i++) {
+		struct game a = ctx->samples[i], b = a;
+		int f = i * ctx->sample_every, j;
+		struct game_result gra, grb;
+		double dev;
+
+		gra = run_game(&a, ctx->comm[f]);
+		grb = run_game_adaptive(&b, ctx->comm[f]);
+		if (gra.set_end != grb.set_end) {
+			set_mismatch++;
+			continue;
+		}
+		dev = r_dist(a.b.body.pos, b.b.body.pos);
+		dev_sum += dev;
+		dev_max = fmax(dev_max, dev);
+		for (j = 0; j < N_PLAYERS; j++)
+			pdev_max = fmax(pdev_max, r_dist(a.p[j].body.pos,
+							b.p[j].body.pos));
+		n++;
+	}
+
+	report("adaptive", "mean deviation per frame",
+			dev_sum / n / BALL_R * 1e6, "ppm of BALL_R");
+	report("adaptive", "max deviation per frame", dev_max / BALL_R * 1e6,
+							"ppm of BALL_R");
+	report("adaptive", "max player deviation", pdev_max / BALL_R * 1e6,
+							"ppm of BALL_R");
+	report("adaptive", "set end mismatches", set_mismatch, "");
+#ifdef CSLIME_STATS
+	report("adaptive", "player steps/frame", (double)
+		AdaptiveStats.player_steps / AdaptiveStats.frames, "");
+	report("adaptive", "run_game player steps/frame",
+					N_PLAYERS * OVERSAMPLING, "");
+#endif
+}
+
+/* Play 'frames' frames of random commands and hash the bodies */
+static unsigned long _multi_frames(struct multi_game *mg, struct pcontrol *comm,
+				int frames, unsigned int seed, double *t)
+{
+	unsigned long h = 2166136261UL;
+	uint32_t x = seed;
+	int f, i;
+
+	multi_game_reset(mg);
+	*t = now();
+	for (f = 0; f < frames; f++) {
+		for (i = 0; i < mg->n_slimes; i += N_PLAYERS) {
+			struct commands c = xorshift_commands(&x);
+
+			comm[i] = c.player[0];
+			if (i + 1 < mg->n_slimes)
+				comm[i + 1] = c.player[1];
+		}
+		run_multi_game(mg, comm);
+	}
+	*t = now() - *t;
+
+	for (i = 0; i < mg->n_balls; i++) {
+		struct game g;
+
+		g.p[0] = mg->slime[i % mg->n_slimes];
+		g.p[1] = mg->slime[(i + 1) % mg->n_slimes];
+		g.b = mg->ball[i];
+		h = hash_game(h, &g);
+	}
+
+	return h;
+}
+
+/* Half slimes and half balls. The grid must give the same trajectories as
+ * testing every pair. */
+static void bench_multi(struct bench_ctx *ctx)
+{
+	struct pcontrol comm[MULTI_MAX_BODIES];
+	int bodies, mismatch = 0, frames = ctx->frames / 16 + 1;
+
+	for (bodies = 2; bodies <= MULTI_MAX_BODIES; bodies *= 2) {
+		struct multi_game mg;
+		unsigned long h_grid, h_all;
+		double t_grid, t_all;
+		char what[40];
+		int code;
+
+		mg = multi_game_create(bodies/2, bodies/2, &PhysicsDefault,
+									&code);
+		if (!multi_game_valid(mg))
+			return;
+
+		h_grid = _multi_frames(&mg, comm, frames, ctx->seed, &t_grid);
+		mg.all_pairs = 1;
+		h_all = _multi_frames(&mg, comm, frames, ctx->seed, &t_all);
+		mismatch += h_grid != h_all;
+
+		sprintf(what, "%d bodies, grid", bodies);
+		report("multi", what, t_grid*1e9 / frames, "ns/frame");
+		sprintf(what, "%d bodies, all pairs", bodies);
+		report("multi", what, t_all*1e9 / frames, "ns/frame");
+		sprintf(what, "%d bodies, grid per body", bodies);
+		report("multi", what, t_grid*1e9 / frames / bodies, "ns/frame");
+		sprintf(what, "%d bodies, points", bodies);
+		report("multi", what, mg.points[0] + mg.points[1], "");
+
+		multi_game_destroy(mg);
+	}
+	report("multi", "mismatches", mismatch, "");
+
+	if (mismatch) {
+		printf("multi      FAILED\n");
+		ctx->failed = 1;
+	}
+}
+
+/* Compare the two collision paths. Small differences in rounding grow with
+ * every bounce, so instead of one long match we run short stretches starting
+ * from each of the sampled states. */
+static void bench_agree(struct bench_ctx *ctx)
+{
+	int i, k, n = 0, set_mismatch = 0;
+	double dev_sum = 0, dev_max = 0;
+
+	for (i = 0; i < ctx->n_samples; i++) {
+		struct game a = ctx->samples[i], b = a;
+		int f0 = i * ctx->sample_every;
+		double dev = 0;
+
+		for (k = 0; k < AGREE_HORIZON && f0 + k < ctx->frames; k++) {
+			struct game_result gra, grb;
+
+			gra = run_game_polar(&a, ctx->comm[f0 + k]);
+			grb = run_game_notrig(&b, ctx->comm[f0 + k]);
+			dev = fmax(dev, r_dist(a.b.body.pos, b.b.body.pos));
+			if (gra.set_end != grb.set_end) {
+				set_mismatch++;
+				break;
+			}
+			if (gra.set_end)
+				break;
+		}
+		dev_sum += dev;
+		dev_max = fmax(dev_max, dev);
+		n++;
+	}
+
+	report("agree", "frames per run", AGREE_HORIZON, "");
+	report("agree", "runs", n, "");
+	report("agree", "mean max deviation", dev_sum / n / BALL_R * 1e6, "ppm of BALL_R");
+	report("agree", "max deviation", dev_max / BALL_R * 1e6, "ppm of BALL_R");
+	report("agree", "set end mismatches", set_mismatch, "");
+
+	if (dev_max > AGREE_TOL || set_mismatch > n * AGREE_MISMATCH_TOL) {
+		printf("agree      FAILED\n");
+		ctx->failed = 1;
+	}
+}
+
+/* Hold the commands for 'frames' frames or until the end of the set. With
+ * 'ff' the frames without events are skipped with game_advance_until_event().
+ * Returns the number of calls to run_game(). */
+static long _hold(struct game *g, struct commands comm, int frames, bool ff,
+							long *skipped)
+{
+	long calls = 0;
+
+	while (frames > 0) {
+		if (ff) {
+			int n = game_advance_until_event(g, comm, frames);
+
+			*skipped += n;
+			frames -= n;
+			if (frames == 0)
+				break;
+		}
+		calls++;
+		frames--;
+		if (run_game(g, comm).set_end)
+			break;
+	}
+
+	return calls;
+}
+
+static void bench_until(struct bench_ctx *ctx)
+{
+	struct game *end;
+	long calls = 0, skipped = 0, dummy = 0;
+	int i, mismatch = 0;
+	double t0, t_step, t_ff;
+
+	if (NMALLOC(end, ctx->n_samples) == NULL)
+		return;
+
+	t0 = now();
+	for (i = 0; i < ctx->n_samples; i++) {
+		end[i] = ctx->samples[i];
+		_hold(end + i, ctx->comm[i * ctx->sample_every], UNTIL_HORIZON,
+								0, &dummy);
+	}
+	t_step = now() - t0;
+
+	t0 = now();
+	for (i = 0; i < ctx->n_samples; i++) {
+		struct game g = ctx->samples[i];
+
+		calls += _hold(&g, ctx->comm[i * ctx->sample_every],
+						UNTIL_HORIZON, 1, &skipped);
+		mismatch += !!memcmp(&g, end + i, sizeof(g));
+	}
+	t_ff = now() - t0;
+
+	report("until", "frames per run", UNTIL_HORIZON, "");
+	report("until", "frames skipped", 100.0 * skipped
+			/ (skipped + calls), "%");
+	report("until", "speedup", t_step / t_ff, "x");
+	report("until", "mismatches", mismatch, "");
+
+	if (mismatch) {
+		printf("until      FAILED\n");
+		ctx->failed = 1;
+	}
+	free(end);
+}
+
+/* The recorded match, deciding the commands every k frames, played with
+ * run_game_repeat() and with k calls to run_game(). 'h' gets the hash of the
+ * game after each decision. */
+static long _repeat(struct bench_ctx *ctx, int k, bool repeat,
+					unsigned long *h, long *contacts)
+{
+	struct game g = game_init(DEF_START_POINTS, 0);
+	long points = 0;
+	int f = 0, n;
+
+	while (f < ctx->frames) {
+		struct commands comm = ctx->comm[f];
+		struct game_result gr = {0};
+
+		if (repeat) {
+			struct repeat_result rr = run_game_repeat(&g, comm, k);
+
+			gr = rr.last;
+			f += rr.frames;
+			points += rr.points[0];
+			*contacts += rr.contact;
+		} else {
+			for (n = 0; n < k && !gr.set_end; n++)
+				gr = run_game(&g, comm);
+			f += n;
+			points += gr.set_end? ((gr.scorer_player == 0)? 1 : -1)
+									: 0;
+		}
+		*h = hash_game(*h, &g);
+		next_set(&g, gr, ctx->new_turn[f - 1]);
+	}
+
+	return points;
+}
+
+static void bench_repeat(struct bench_ctx *ctx)
+{
+	int k;
+
+	for (k = 1; k <= REPEAT_MAX; k *= 2) {
+		unsigned long h_calls = 2166136261UL, h_repeat = h_calls;
+		long contacts = 0, p_calls, p_repeat;
+		double t0, t_calls, t_repeat;
+		char what[40];
+
+		t0 = now();
+		p_calls = _repeat(ctx, k, 0, &h_calls, &contacts);
+		t_calls = now() - t0;
+		t0 = now();
+		p_repeat = _repeat(ctx, k, 1, &h_repeat, &contacts);
+		t_repeat = now() - t0;
+
+		sprintf(what, "k=%d, run_game() x k", k);
+		report("repeat", what, t_calls*1e9 / ctx->frames, "ns/frame");
+		sprintf(what, "k=%d, run_game_repeat()", k);
+		report("repeat", what, t_repeat*1e9 / ctx->frames, "ns/frame");
+		sprintf(what, "k=%d, decisions with contact", k);
+		report("repeat", what, 100.0 * contacts * k / ctx->frames, "%");
+
+		if (h_calls != h_repeat || p_calls != p_repeat) {
+			printf("repeat     FAILED\n");
+			ctx->failed = 1;
+		}
+	}
+}
+
+/* Cost of saving and restoring a game, and check that a restored game (also
+ * after going through the encoded form) plays exactly like the original */
+static void bench_snapshot(struct bench_ctx *ctx)
+{
+	struct game_snapshot *snap = NULL;
+	struct game g, *saved = NULL, *dst = NULL;
+	long ops = (long)ctx->n_samples * KERNEL_REPEAT;
+	int i, k, r, mismatch = 0;
+	double t0;
+
+	if (NMALLOC(snap, ctx->n_samples) == NULL
+	    || NMALLOC(saved, ctx->n_samples) == NULL
+	    || NMALLOC(dst, ctx->n_samples) == NULL)
+		goto bench_snapshot_end;
+
+	/* save and restore each game, against doing the same with plain
+	 * copies of struct game */
+	t0 = now();
+	for (r = 0; r < KERNEL_REPEAT; r++) {
+		for (i = 0; i < ctx->n_samples; i++) {
+			game_snapshot(ctx->samples + i, snap + i);
+			game_restore(dst + i, snap + i);
+		}
+	}
+	report("snapshot", "snapshot + restore", (now() - t0)*1e9 / ops,
+								"ns/op");
+
+	t0 = now();
+	for (r = 0; r < KERNEL_REPEAT; r++) {
+		for (i = 0; i < ctx->n_samples; i++) {
+			saved[i] = ctx->samples[i];
+			dst[i] = saved[i];
+		}
+	}
+	report("snapshot", "struct game copy x2", (now() - t0)*1e9 / ops,
+								"ns/op");
+	report("snapshot", "struct game size", sizeof(struct game), "bytes");
+	report("snapshot", "snapshot size", sizeof(struct game_snapshot),
+								"bytes");
+	report("snapshot", "encoded size", SNAPSHOT_ENCODED_SIZE, "bytes");
+
+	for (i = 0; i < ctx->n_samples; i++) {
+		struct game a = ctx->samples[i];
+		struct game_snapshot s;
+		unsigned char buf[SNAPSHOT_ENCODED_SIZE];
+		int f0 = i * ctx->sample_every;
+
+		memset(&g, 0xAA, sizeof(g));
+		game_snapshot(&a, &s);
+		game_snapshot_encode(&s, buf);
+		if (game_snapshot_decode(&s, buf) < 0) {
+			mismatch++;
+			continue;
+		}
+		game_restore(&g, &s);
+
+		for (k = 0; k < SNAPSHOT_HORIZON && f0 + k < ctx->frames; k++) {
+			struct game_result gra, grb;
+
+			gra = run_game(&a, ctx->comm[f0 + k]);
+			grb = run_game(&g, ctx->comm[f0 + k]);
+			if (memcmp(&gra, &grb, sizeof(gra))
+			    || hash_game(0, &a) != hash_game(0, &g)) {
+				mismatch++;
+				break;
+			}
+			if (gra.set_end)
+				break;
+		}
+	}
+	report("snapshot", "restored games differing", mismatch, "");
+
+	if (mismatch) {
+		printf("snapshot   FAILED\n");
+		ctx->failed = 1;
+	}
+
+bench_snapshot_end:
+	free(snap);
+	free(saved);
+	free(dst);
+}
+
+/* A buffer of games too big for the caches, as a search tree or a replay
+ * buffer would be, stored as struct game and as struct game_snapshot. Each
+ * pass plays a short greedy rollout from every entry and stores the result
+ * back. Both buffers must end up with the same games. */
+static double _state_pass(struct bench_ctx *ctx, struct game *games,
+			struct game_snapshot *snaps, int frames)
+{
+	struct commands comm = {{{0}}};
+	unsigned int seed = ctx->seed;
+	double t0 = now();
+	int i, f;
+
+	for (i = 0; i < STATE_BUFFER; i++) {
+		struct game g;
+
+		if (games != NULL)
+			g = games[i];
+		else
+			game_restore_params(&g, snaps + i, &PhysicsDefault);
+		for (f = 0; f < frames; f++) {
+			comm.player[0] = greedy_player_p(&g, 0, 1, &seed);
+			comm.player[1] = greedy_player_p(&g, 1, 1, &seed);
+			run_game_p(&g, &comm);
+		}
+		if (games != NULL)
+			games[i] = g;
+		else
+			game_snapshot(&g, snaps + i);
+	}
+
+	return now() - t0;
+}
+
+static void bench_state(struct bench_ctx *ctx)
+{
+	struct game *games;
+	struct game_snapshot *snaps;
+	double t_game, t_snap;
+	int i, mismatch = 0, frames;
+
+	report("state", "struct game size", sizeof(struct game), "bytes");
+	report("state", "struct game_snapshot size",
+				sizeof(struct game_snapshot), "bytes");
+	report("state", "games per cache line", 64.0 / sizeof(struct game), "");
+	report("state", "snapshots per cache line",
+				64.0 / sizeof(struct game_snapshot), "");
+
+	if (NMALLOC(games, STATE_BUFFER) == NULL)
+		return;
+	if (NMALLOC(snaps, STATE_BUFFER) == NULL) {
+		free(games);
+		return;
+	}
+
+	for (frames = 1; frames <= STATE_ROLLOUT; frames *= STATE_ROLLOUT) {
+		char what[40];
+
+		for (i = 0; i < STATE_BUFFER; i++) {
+			games[i] = ctx->samples[i % ctx->n_samples];
+			game_snapshot(games + i, snaps + i);
+		}
+		t_game = _state_pass(ctx, games, NULL, frames);
+		t_snap = _state_pass(ctx, NULL, snaps, frames);
+
+		sprintf(what, "%d frames, game", frames);
+		report("state", what, STATE_BUFFER / t_game, "rollouts/s");
+		sprintf(what, "%d frames, snapshot", frames);
+		report("state", what, STATE_BUFFER / t_snap, "rollouts/s");
+
+		for (i = 0; i < STATE_BUFFER; i++) {
+			struct game_snapshot s;
+
+			game_snapshot(games + i, &s);
+			mismatch += !_same_snapshot(&s, snaps + i);
+		}
+	}
+
+	/* run_game_snapshot() against run_game() */
+	for (i = 0; i < ctx->n_samples; i++) {
+		struct game g = ctx->samples[i];
+		struct game_snapshot s, s2;
+		int f = i * ctx->sample_every;
+
+		game_snapshot(&g, &s);
+		run_game(&g, ctx->comm[f]);
+		run_game_snapshot(&s, &PhysicsDefault, ctx->comm[f]);
+		game_snapshot(&g, &s2);
+		mismatch += !_same_snapshot(&s, &s2);
+	}
+	report("state", "mismatches", mismatch, "");
+
+	free(games);
+	free(snaps);
+
+	if (mismatch) {
+		printf("state      FAILED\n");
+		ctx->failed = 1;
+	}
+}
+
+/* Play the same jobs with pools of 1, 2, 4... threads, up to the number of
+ * cores. Half of the jobs are neural vs. greedy. The results must not depend
+ * on the number of threads. */
+static void bench_rollout(struct bench_ctx *ctx)
+{
+	struct rollout_job *jobs;
+	struct rollout_result *ref = NULL, *res = NULL;
+	long n_cores = (ctx->threads > 0)? ctx->threads
+					: sysconf(_SC_NPROCESSORS_ONLN);
+	int i, n_threads, code, mismatch = 0;
+	double t1 = 0;
+
+	if (NCALLOC(jobs, ROLLOUT_JOBS) == NULL
+	    || NMALLOC(ref, ROLLOUT_JOBS) == NULL
+	    || NMALLOC(res, ROLLOUT_JOBS) == NULL)
+		goto bench_rollout_end;
+
+	for (i = 0; i < ROLLOUT_JOBS; i++) {
+		jobs[i].g = ctx->samples[i % ctx->n_samples];
+		jobs[i].policy[0].kind = POLICY_GREEDY;
+		jobs[i].policy[1].kind = (i%2)? POLICY_NEURAL : POLICY_GREEDY;
+		jobs[i].policy[1].brain = ctx->brain;
+		jobs[i].max_frames = ctx->frames / 64 + 1;
+		jobs[i].seed = ctx->seed + i;
+	}
+
+	for (n_threads = 1; n_threads == 1 || n_threads <= n_cores;
+							n_threads *= 2) {
+		struct rollout_pool rp = rollout_pool_create(n_threads, &code);
+		struct rollout_result *out = (n_threads == 1)? ref : res;
+		long frames = 0;
+		double t0, t;
+		char what[40];
+
+		if (!rollout_pool_valid(rp))
+			break;
+
+		t0 = now();
+		code = rollout_run(&rp, jobs, ROLLOUT_JOBS, out);
+		t = now() - t0;
+		if (n_threads == 1)
+			t1 = t;
+
+		for (i = 0; i < ROLLOUT_JOBS; i++) {
+			frames += out[i].frames;
+			if (code < 0 || out[i].frames != ref[i].frames
+			    || out[i].winner != ref[i].winner
+			    || hash_game(0, &out[i].g) != hash_game(0, &ref[i].g))
+				mismatch++;
+		}
+
+		sprintf(what, "%d threads frames/s", n_threads);
+		report("rollout", what, frames / t, "");
+		sprintf(what, "%d threads per thread", n_threads);
+		report("rollout", what, frames / t / n_threads, "frames/s");
+		sprintf(what, "%d threads efficiency", n_threads);
+		report("rollout", what, 100 * t1 / t / n_threads, "%");
+		for (i = 0; i < n_threads; i++) {
+			struct rollout_stats st = rollout_thread_stats(&rp, i);
+
+			sprintf(what, "  thread %d frames/s", i);
+			report("rollout", what, st.frames / st.busy_time, "");
+		}
+		rollout_pool_destroy(rp);
+	}
+	report("rollout", "results differing", mismatch, "");
+
+	if (mismatch) {
+		printf("rollout    FAILED\n");
+		ctx->failed = 1;
+	}
+
+bench_rollout_end:
+	free(jobs);
+	free(ref);
+	free(res);
+}
+
+/* One frame of a greedy match through the by value API and through the
+ * pointer API. Both must give the same trajectories. The bytes are those of
+ * the arguments passed by value, which the callee may have to copy (two AI
+ * calls and run_game() per frame, the collision tests per call).
+ * The difference depends on the optimization level, build with CFLAGS=-O3 to
+ * compare it with the default -O2. */
+static double _copies_frames(struct bench_ctx *ctx, bool by_ref,
+							unsigned long *h)
+{
+	struct game g = game_init(DEF_START_POINTS, 0);
+	struct commands comm = {{{0}}};
+	unsigned int seed = ctx->seed;
+	int f;
+	double t0 = now();
+
+	*h = 2166136261UL;
+	for (f = 0; f < ctx->frames; f++) {
+		struct game_result gr;
+
+		if (by_ref) {
+			comm.player[0] = greedy_player_p(&g, 0, 1, &seed);
+			comm.player[1] = greedy_player_p(&g, 1, 1, &seed);
+			gr = run_game_p(&g, &comm);
+		} else {
+			comm.player[0] = greedy_player_r(g, 0, 1, &seed);
+			comm.player[1] = greedy_player_r(g, 1, 1, &seed);
+			gr = run_game(&g, comm);
+		}
+		next_set(&g, gr, f%2);
+		*h = hash_game(*h, &g);
+	}
+
+	return now() - t0;
+}
+
+static void bench_copies(struct bench_ctx *ctx)
+{
+	struct kinetic *kin;
+	unsigned long h_val, h_ref;
+	long calls = (long)ctx->n_samples * KERNEL_REPEAT;
+	double t_val, t_ref;
+	int i, r, mismatch = 0;
+	float acc = 0;
+
+	report("copies", "bytes by value/frame",
+		2*sizeof(struct game) + sizeof(struct commands), "B");
+	report("copies", "bytes by pointer/frame",
+		2*sizeof(struct game *) + sizeof(struct commands *), "B");
+
+	t_val = _copies_frames(ctx, 0, &h_val);
+	t_ref = _copies_frames(ctx, 1, &h_ref);
+	report("copies", "ns/frame by value", t_val*1e9 / ctx->frames, "ns");
+	report("copies", "ns/frame by pointer", t_ref*1e9 / ctx->frames, "ns");
+	report("copies", "speedup", t_val / t_ref, "x");
+
+	if (NMALLOC(kin, ctx->n_samples) == NULL)
+		return;
+	for (i = 0; i < ctx->n_samples; i++)
+		kin[i] = kinetic_step(ctx->samples[i].b.body);
+
+	report("copies", "bytes by value/collision",
+		sizeof(struct ball) + sizeof(struct kinetic)
+					+ sizeof(struct player), "B");
+	t_val = now();
+	for (r = 0; r < KERNEL_REPEAT; r++) {
+		for (i = 0; i < ctx->n_samples; i++)
+			acc += ball_player_collision(ctx->samples[i].b, kin[i],
+				ctx->samples[i].p[0], &PhysicsDefault).pos.x;
+	}
+	t_val = now() - t_val;
+	t_ref = now();
+	for (r = 0; r < KERNEL_REPEAT; r++) {
+		for (i = 0; i < ctx->n_samples; i++)
+			acc += ball_player_collision_p(&ctx->samples[i].b,
+					kin + i, ctx->samples[i].p,
+					&PhysicsDefault).pos.x;
+	}
+	t_ref = now() - t_ref;
+	report("copies", "ns/collision by value", t_val*1e9 / calls, "ns");
+	report("copies", "ns/collision by pointer", t_ref*1e9 / calls, "ns");
+
+	for (i = 0; i < ctx->n_samples; i++) {
+		struct kinetic a, b;
+
+		a = ball_player_collision(ctx->samples[i].b, kin[i],
+				ctx->samples[i].p[0], &PhysicsDefault);
+		b = ball_player_collision_p(&ctx->samples[i].b, kin + i,
+				ctx->samples[i].p, &PhysicsDefault);
+		mismatch += memcmp(&a, &b, sizeof(a)) != 0;
+	}
+	bench_sink = acc;
+	free(kin);
+
+	if (h_val != h_ref || mismatch) {
+		printf("copies     FAILED\n");
+		ctx->failed = 1;
+	}
+}
+
+static void _kernel_report(const char *what, double t, long calls)
+{
+	report("kernels", what, t*1e9 / calls, "ns/call");
+}
+
+static void bench_kernels(struct bench_ctx *ctx)
+{
+	struct kinetic *kin;
+	struct poly_geometry world_geom, net_geom;
+	long calls = (long)ctx->n_samples * KERNEL_REPEAT;
+	int i, r, geom_mismatch = 0;
+	double t0, t_world, t_geom;
+	float acc = 0;
+
+	if (NMALLOC(kin, ctx->n_samples) == NULL)
+		return;
+
+	world_geom = poly_geometry_make(world_poly, ARSIZE(world_poly));
+	net_geom = poly_geometry_make(net_poly, ARSIZE(net_poly));
+
+	for (i = 0; i < ctx->n_samples; i++)
+		kin[i] = kinetic_step(ctx->samples[i].b.body);
+
+	t0 = now();
+	for (r = 0; r < KERNEL_REPEAT; r++) {
+		for (i = 0; i < ctx->n_samples; i++)
+			acc += kinetic_step(ctx->samples[i].b.body).pos.x;
+	}
+	_kernel_report("kinetic_step", now() - t0, calls);
+
+	t0 = now();
+	for (r = 0; r < KERNEL_REPEAT; r++) {
+		for (i = 0; i < ctx->n_samples; i++)
+			acc += ball_poly_collision(ctx->samples[i].b, kin[i],
+				world_poly, ARSIZE(world_poly), r_zero, 1, 0).pos.x;
+	}
+	t_world = now() - t0;
+	_kernel_report("ball_poly_collision (world)", t_world, calls);
+
+	t0 = now();
+	for (r = 0; r < KERNEL_REPEAT; r++) {
+		for (i = 0; i < ctx->n_samples; i++)
+			acc += ball_poly_collision(ctx->samples[i].b, kin[i],
+				net_poly, ARSIZE(net_poly), r_zero, 1, 0).pos.x;
+	}
+	_kernel_report("ball_poly_collision (net)", now() - t0, calls);
+
+	t0 = now();
+	for (r = 0; r < KERNEL_REPEAT; r++) {
+		for (i = 0; i < ctx->n_samples; i++)
+			acc += ball_poly_collision_geom(ctx->samples[i].b, kin[i],
+				&world_geom, r_zero, 1, 0).pos.x;
+	}
+	t_geom = now() - t0;
+	_kernel_report("poly_collision_geom (world)", t_geom, calls);
+
+	t0 = now();
+	for (r = 0; r < KERNEL_REPEAT; r++) {
+		for (i = 0; i < ctx->n_samples; i++)
+			acc += ball_poly_collision_geom(ctx->samples[i].b, kin[i],
+				&net_geom, r_zero, 1, 0).pos.x;
+	}
+	_kernel_report("poly_collision_geom (net)", now() - t0, calls);
+	report("kernels", "poly geometry speedup (world)", t_world / t_geom, "x");
+
+	/* the precomputed polygons must not change the results */
+	for (i = 0; i < ctx->n_samples; i++) {
+		struct ball b = ctx->samples[i].b;
+		struct kinetic a[4], c[4];
+
+		a[0] = ball_poly_collision(b, kin[i], world_poly,
+					ARSIZE(world_poly), r_zero, 1, 0);
+		c[0] = ball_poly_collision_geom(b, kin[i], &world_geom,
+							r_zero, 1, 0);
+		a[1] = ball_poly_collision(b, kin[i], net_poly,
+					ARSIZE(net_poly), r_zero, 1, 0);
+		c[1] = ball_poly_collision_geom(b, kin[i], &net_geom,
+							r_zero, 1, 0);
+		a[2] = ball_poly_collision_notrig(b, kin[i], world_poly,
+					ARSIZE(world_poly), r_zero, 1, 0);
+		c[2] = ball_poly_collision_geom_notrig(b, kin[i], &world_geom,
+							r_zero, 1, 0);
+		a[3] = ball_poly_collision_notrig(b, kin[i], net_poly,
+					ARSIZE(net_poly), r_zero, 1, 0);
+		c[3] = ball_poly_collision_geom_notrig(b, kin[i], &net_geom,
+							r_zero, 1, 0);
+		geom_mismatch += !!memcmp(a, c, sizeof(a));
+	}
+	report("kernels", "poly geometry mismatches", geom_mismatch, "");
+	if (geom_mismatch) {
+		printf("kernels    FAILED\n");
+		ctx->failed = 1;
+	}
+
+	t0 = now();
+	for (r = 0; r < KERNEL_REPEAT; r++) {
+		for (i = 0; i < ctx->n_samples; i++)
+			acc += ball_player_collision(ctx->samples[i].b, kin[i],
+				ctx->samples[i].p[i%2], &PhysicsDefault).pos.x;
+	}
+	_kernel_report("ball_player_collision", now() - t0, calls);
+
+	t0 = now();
+	for (r = 0; r < KERNEL_REPEAT; r++) {
+		for (i = 0; i < ctx->n_samples; i++)
+			acc += ball_poly_collision_notrig(ctx->samples[i].b, kin[i],
+				world_poly, ARSIZE(world_poly), r_zero, 1, 0).pos.x;
+	}
+	_kernel_report("ball_poly_collision_notrig", now() - t0, calls);
+
+	t0 = now();
+	for (r = 0; r < KERNEL_REPEAT; r++) {
+		for (i = 0; i < ctx->n_samples; i++)
+			acc += ball_player_collision_notrig(ctx->samples[i].b,
+					kin[i], ctx->samples[i].p[i%2],
+					&PhysicsDefault).pos.x;
+	}
+	_kernel_report("ball_player_collision_notrig", now() - t0, calls);
+
+	t0 = now();
+	for (r = 0; r < KERNEL_REPEAT; r++) {
+		for (i = 0; i < ctx->n_samples; i++) {
+			struct game g = ctx->samples[i];
+			acc += game_umpire(&g).set_end;
+		}
+	}
+	_kernel_report("game_umpire", now() - t0, calls);
+
+	bench_sink = acc;
+	free(kin);
+}
+
+/* The tiers of fastmath.h: cost per call and largest error against the double
+ * precision libm, on the ranges the engine and the network use */
+enum {MATH_LIBM, MATH_ACCURATE, MATH_FAST, N_MATH_TIERS};
+
+static const char *const MathTiers[N_MATH_TIERS] = {"libm", "accurate",
+								"fast"};
+
+static float _math_hypot(int tier, float x, float y)
+{
+	return (tier == MATH_LIBM)? hypotf(x, y) : fm_hypotf_1(x, y);
+}
+
+static float _math_atan2(int tier, float y, float x)
+{
+	return (tier == MATH_LIBM)? atan2f(y, x) : ((tier == MATH_ACCURATE)?
+				fm_atan2f_1(y, x) : fm_atan2f_2(y, x));
+}
+
+static float _math_sincos(int tier, float a, float *c)
+{
+	float s;
+
+	if (tier == MATH_LIBM) {
+		s = sinf(a);
+		*c = cosf(a);
+	} else if (tier == MATH_ACCURATE) {
+		fm_sincosf_1(a, &s, c);
+	} else {
+		fm_sincosf_2(a, &s, c);
+	}
+
+	return s;
+}
+
+static float _math_tanh(int tier, float x)
+{
+	return (tier == MATH_LIBM)? tanhf(x) : ((tier == MATH_ACCURATE)?
+				fm_tanhf_1(x) : fm_tanhf_2(x));
+}
+
+static void _math_report(const char *fn, int tier, double t, double err)
+{
+	char what[40];
+
+	sprintf(what, "%s, %s", fn, MathTiers[tier]);
+	report("math", what, t*1e9 / ((double)MATH_REPEAT * MATH_SAMPLES),
+								"ns/call");
+	sprintf(what, "%s, %s, max error", fn, MathTiers[tier]);
+	report("math", what, err * 1e6, "ppm");
+}
+
+static void bench_math(struct bench_ctx *ctx)
+{
+	float a[MATH_SAMPLES], b[MATH_SAMPLES];
+	uint32_t x = ctx->seed;
+	int i, r, tier;
+
+	/* in [-1, 1) */
+	for (i = 0; i < MATH_SAMPLES; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		a[i] = ((x >> 8) + .5f) / (1 << 23) - 1;
+		b[i] = ((x & 0xFFFF) + .5f) / (1 << 15) - 1;
+	}
+
+	report("math", "FASTMATH_TIER of this build", FASTMATH_TIER, "");
+
+	for (tier = 0; tier < N_MATH_TIERS; tier++) {
+		double t0, t, err = 0;
+		float acc = 0;
+
+		/* hypot, relative error */
+		t0 = now();
+		for (r = 0; r < MATH_REPEAT; r++)
+			for (i = 0; i < MATH_SAMPLES; i++)
+				acc += _math_hypot(tier, a[i], b[i]);
+		t = now() - t0;
+		for (i = 0; i < MATH_SAMPLES; i++) {
+			double h = hypot(a[i], b[i]);
+
+			err = fmax(err, fabs(_math_hypot(tier, a[i], b[i]) - h)
+									/ h);
+		}
+		_math_report("hypot", tier, t, err);
+
+		/* atan2 */
+		err = 0;
+		t0 = now();
+		for (r = 0; r < MATH_REPEAT; r++)
+			for (i = 0; i < MATH_SAMPLES; i++)
+				acc += _math_atan2(tier, a[i], b[i]);
+		t = now() - t0;
+		for (i = 0; i < MATH_SAMPLES; i++)
+			err = fmax(err, fabs(_math_atan2(tier, a[i], b[i])
+						- atan2(a[i], b[i])));
+		_math_report("atan2", tier, t, err);
+
+		/* sincos, angles in [-10, 10) for the timing and up to 1e4
+		 * for the error */
+		err = 0;
+		t0 = now();
+		for (r = 0; r < MATH_REPEAT; r++) {
+			for (i = 0; i < MATH_SAMPLES; i++) {
+				float c;
+
+				acc += _math_sincos(tier, 10*a[i], &c) + c;
+			}
+		}
+		t = now() - t0;
+		for (i = 0; i < MATH_SAMPLES; i++) {
+			float scale[] = {FM_PI, 10, 1e4};
+			int k;
+
+			for (k = 0; k < ARSIZE(scale); k++) {
+				float ang = scale[k]*a[i], c;
+				float s = _math_sincos(tier, ang, &c);
+
+				err = fmax(err, fmax(fabs(s - sin(ang)),
+							fabs(c - cos(ang))));
+			}
+		}
+		_math_report("sincos", tier, t, err);
+
+		/* tanh, x in [-10, 10) */
+		err = 0;
+		t0 = now();
+		for (r = 0; r < MATH_REPEAT; r++)
+			for (i = 0; i < MATH_SAMPLES; i++)
+				acc += _math_tanh(tier, 10*a[i]);
+		t = now() - t0;
+		for (i = 0; i < MATH_SAMPLES; i++) {
+			float v = 10*a[i], v_small = a[i];
+
+			err = fmax(err, fmax(fabs(_math_tanh(tier, v) - tanh(v)),
+				fabs(_math_tanh(tier, v_small) - tanh(v_small))));
+		}
+		_math_report("tanh", tier, t, err);
+
+		bench_sink += acc;
+	}
+}
+
+/* The operations of vector_wide.h, on arrays of vectors */
+enum {WOP_SUM, WOP_SCALE, WOP_DOT, WOP_ABS, WOP_CLIP, WOP_NORM_CLIP,
+					WOP_ANGLE, WOP_TO_R, N_WOPS};
+
+static const char *const WideOps[N_WOPS] = {"sum", "scale", "dot", "abs",
+				"clip", "norm_clip", "angle", "to_r"};
+
+struct wide_arrays {
+	float *ax, *ay, *bx, *by;
+	float *ox, *oy;
+	int n;
+};
+
+static const struct limit WideLim = {-.5f, .5f};
+
+static void _wide_1(int op, struct wide_arrays *w)
+{
+	int i;
+
+	for (i = 0; i < w->n; i++) {
+		struct r_vector a = r_make(w->ax[i], w->ay[i]);
+		struct r_vector b = r_make(w->bx[i], w->by[i]);
+		struct r_vector r = r_zero;
+
+		switch (op) {
+		case WOP_SUM: r = r_sum(a, b); break;
+		case WOP_SCALE: r = r_scale(a, 1.5f); break;
+		case WOP_DOT: r.x = r_dot(a, b); break;
+		case WOP_ABS: r.x = r_abs(a); break;
+		case WOP_CLIP: r = r_clip(a, WideLim, WideLim); break;
+		case WOP_NORM_CLIP: r = norm_clip(a, .5f); break;
+		case WOP_ANGLE: r.x = r_angle(a); break;
+		case WOP_TO_R: r = p_to_r(p_make(a.x, 10*a.y)); break;
+		}
+		w->ox[i] = r.x;
+		w->oy[i] = r.y;
+	}
+}
+
+/* The switch is outside of the loops, so that each loop only does its
+ * operation */
+#define WIDE_KERNEL(N)							\
+static void _wide_##N(int op, struct wide_arrays *w)			\
+{									\
+	const v##N##f zero = r##N##_set1(0);				\
+	int i;								\
+									\
+	switch (op) {							\
+	case WOP_SUM:							\
+		for (i = 0; i < w->n; i += N)				\
+			r##N##_store(r##N##_sum(			\
+				r##N##_load(w->ax + i, w->ay + i),	\
+				r##N##_load(w->bx + i, w->by + i)),	\
+					w->ox + i, w->oy + i);		\
+		break;							\
+	case WOP_SCALE:							\
+		for (i = 0; i < w->n; i += N)				\
+			r##N##_store(r##N##_scale(			\
+				r##N##_load(w->ax + i, w->ay + i), 1.5f),\
+					w->ox + i, w->oy + i);		\
+		break;							\
+	case WOP_DOT:							\
+		for (i = 0; i < w->n; i += N)				\
+			r##N##_store(r##N##_make(r##N##_dot(		\
+				r##N##_load(w->ax + i, w->ay + i),	\
+				r##N##_load(w->bx + i, w->by + i)),	\
+				zero), w->ox + i, w->oy + i);		\
+		break;							\
+	case WOP_ABS:							\
+		for (i = 0; i < w->n; i += N)				\
+			r##N##_store(r##N##_make(r##N##_abs(		\
+				r##N##_load(w->ax + i, w->ay + i)),	\
+				zero), w->ox + i, w->oy + i);		\
+		break;							\
+	case WOP_CLIP:							\
+		for (i = 0; i < w->n; i += N)				\
+			r##N##_store(r##N##_clip(			\
+				r##N##_load(w->ax + i, w->ay + i),	\
+				WideLim, WideLim),			\
+					w->ox + i, w->oy + i);		\
+		break;							\
+	case WOP_NORM_CLIP:						\
+		for (i = 0; i < w->n; i += N)				\
+			r##N##_store(r##N##_norm_clip(			\
+				r##N##_load(w->ax + i, w->ay + i), .5f),\
+					w->ox + i, w->oy + i);		\
+		break;							\
+	case WOP_ANGLE:							\
+		for (i = 0; i < w->n; i += N)				\
+			r##N##_store(r##N##_make(r##N##_angle(		\
+				r##N##_load(w->ax + i, w->ay + i)),	\
+				zero), w->ox + i, w->oy + i);		\
+		break;							\
+	case WOP_TO_R:							\
+		for (i = 0; i < w->n; i += N) {				\
+			struct p_vector##N p;				\
+									\
+			memcpy(&p.value, w->ax + i, sizeof(p.value));	\
+			memcpy(&p.titha, w->ay + i, sizeof(p.titha));	\
+			p.titha *= 10;					\
+			r##N##_store(p##N##_to_r(p), w->ox + i, w->oy + i);\
+		}							\
+		break;							\
+	}								\
+}
+
+WIDE_KERNEL(4)
+WIDE_KERNEL(8)
+WIDE_KERNEL(16)
+
+static const struct {
+	int width;
+	void (*run)(int op, struct wide_arrays *w);
+} WideKernels[] = {{1, _wide_1}, {4, _wide_4}, {8, _wide_8}, {16, _wide_16}};
+
+/* Each operation at each width, against the scalar functions of vector.h */
+static void bench_wide(struct bench_ctx *ctx)
+{
+	struct wide_arrays w;
+	float *mem, *ref_x, *ref_y;
+	uint32_t x = ctx->seed;
+	int i, k, op, r, mismatch = 0;
+
+	if (NMALLOC(mem, 8*WIDE_VECTORS) == NULL)
+		return;
+	w.n = WIDE_VECTORS;
+	w.ax = mem;
+	w.ay = w.ax + WIDE_VECTORS;
+	w.bx = w.ay + WIDE_VECTORS;
+	w.by = w.bx + WIDE_VECTORS;
+	w.ox = w.by + WIDE_VECTORS;
+	w.oy = w.ox + WIDE_VECTORS;
+	ref_x = w.oy + WIDE_VECTORS;
+	ref_y = ref_x + WIDE_VECTORS;
+
+	/* in [-1, 1), never zero */
+	for (i = 0; i < 4*WIDE_VECTORS; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		mem[i] = ((x >> 8) + .5f) / (1 << 23) - 1;
+	}
+
+	for (op = 0; op < N_WOPS; op++) {
+		_wide_1(op, &w);
+		memcpy(ref_x, w.ox, WIDE_VECTORS*sizeof(float));
+		memcpy(ref_y, w.oy, WIDE_VECTORS*sizeof(float));
+
+		for (k = 0; k < ARSIZE(WideKernels); k++) {
+			char what[40];
+			double t0, t;
+
+			WideKernels[k].run(op, &w);
+			for (i = 0; i < WIDE_VECTORS; i++) {
+				float tol = (op == WOP_SUM || op == WOP_SCALE
+						|| op == WOP_DOT || op == WOP_CLIP)?
+							0 : WIDE_ABS_TOL;
+
+				mismatch += fabsf(w.ox[i] - ref_x[i]) > tol
+					|| fabsf(w.oy[i] - ref_y[i]) > tol;
+			}
+
+			t0 = now();
+			for (r = 0; r < WIDE_REPEAT; r++)
+				WideKernels[k].run(op, &w);
+			t = now() - t0;
+
+			sprintf(what, "%s, %d wide", WideOps[op],
+						WideKernels[k].width);
+			report("wide", what, t*1e9 / ((double)WIDE_REPEAT
+					* WIDE_VECTORS), "ns/vector");
+		}
+	}
+	report("wide", "mismatches", mismatch, "");
+
+	free(mem);
+
+	if (mismatch) {
+		printf("wide       FAILED\n");
+		ctx->failed = 1;
+	}
+}
+
+/* run_game_batch() replaying the recorded commands. Every lane is also played
+ * with run_game() and the same resets, and the results and the games must be
+ * the same. */
+static void bench_batch(struct bench_ctx *ctx)
+{
+	struct game_batch gb;
+	struct commands *comm = NULL;
+	struct game_result *gr = NULL;
+	struct game *ref = NULL;
+	int code, i, f, n_frames, mismatch = 0;
+	double t0, t;
+
+	gb = game_batch_create(BATCH_LANES, &code);
+	if (!game_batch_valid(gb))
+		return;
+	if (NMALLOC(comm, BATCH_LANES) == NULL
+	    || NMALLOC(gr, BATCH_LANES) == NULL
+	    || NMALLOC(ref, BATCH_LANES) == NULL)
+		goto bench_batch_end;
+
+	for (i = 0; i < BATCH_LANES; i++) {
+		struct game g = game_init(DEF_START_POINTS, i%2);
+		game_batch_set(&gb, i, &g);
+	}
+
+	/* each lane replays the recorded commands from a different offset */
+	n_frames = ctx->frames / 16 + 1;
+	t0 = now();
+	for (f = 0; f < n_frames; f++) {
+		for (i = 0; i < BATCH_LANES; i++)
+			comm[i] = ctx->comm[(f + i*97) % ctx->frames];
+
+		run_game_batch(&gb, comm, gr);
+
+		for (i = 0; i < BATCH_LANES; i++) {
+			if (gr[i].game_end) {
+				struct game g = game_init(DEF_START_POINTS, i%2);
+				game_batch_set(&gb, i, &g);
+			} else if (gr[i].set_end) {
+				game_batch_reset(&gb, i, gr[i].has_to_start);
+			}
+		}
+	}
+	t = now() - t0;
+
+	report("batch", "lanes", BATCH_LANES, "");
+	report("batch", "frames/s", (double)n_frames * BATCH_LANES / t, "");
+	report("batch", "substeps/s",
+			(double)n_frames * BATCH_LANES * OVERSAMPLING / t, "");
+
+	/* untimed check against run_game() */
+	for (i = 0; i < BATCH_LANES; i++) {
+		ref[i] = game_init(DEF_START_POINTS, i%2);
+		game_batch_set(&gb, i, ref + i);
+	}
+	for (f = 0; f < n_frames && f < AGREE_HORIZON*16; f++) {
+		for (i = 0; i < BATCH_LANES; i++)
+			comm[i] = ctx->comm[(f + i*97) % ctx->frames];
+
+		run_game_batch(&gb, comm, gr);
+
+		for (i = 0; i < BATCH_LANES; i++) {
+			struct game_result r = run_game_p(ref + i, comm + i);
+			struct game g;
+
+			mismatch += r.scorer_player != gr[i].scorer_player
+				|| r.has_to_start != gr[i].has_to_start
+				|| r.set_end != gr[i].set_end
+				|| r.game_end != gr[i].game_end;
+			if (r.game_end) {
+				ref[i] = game_init(DEF_START_POINTS, i%2);
+				game_batch_set(&gb, i, ref + i);
+			} else if (r.set_end) {
+				game_reset(ref + i, r.has_to_start);
+				game_batch_reset(&gb, i, r.has_to_start);
+			}
+
+			g = game_batch_get(&gb, i);
+			mismatch += !_same_game(&g, ref + i);
+		}
+	}
+	report("batch", "mismatches", mismatch, "");
+
+	if (mismatch) {
+		printf("batch      FAILED\n");
+		ctx->failed = 1;
+	}
+
+bench_batch_end:
+	free(comm);
+	free(gr);
+	free(ref);
+	game_batch_destroy(gb);
+}
+
+/* env_batch_step() with random actions. Every environment is also played
+ * with run_game() and the same resets, and the observations, rewards and
+ * dones must be the same. */
+static void bench_env(struct bench_ctx *ctx)
+{
+	const int n = BATCH_LANES, n_obs = BATCH_LANES*N_PLAYERS*ENV_N_OBS;
+	struct env_batch eb;
+	struct game *ref = NULL;
+	uint8_t *actions = NULL;
+	float *obs = NULL, *rewards = NULL;
+	bool *dones = NULL;
+	uint32_t x = ctx->seed | 1;
+	int code, i, j, f, n_frames, mismatch = 0;
+	long games = 0;
+	double t0, t;
+
+	eb = env_batch_create(n, DEF_START_POINTS, &code);
+	if (!env_batch_valid(eb))
+		return;
+	if (NMALLOC(ref, n) == NULL
+	    || NMALLOC(actions, ENV_ACTION_TABLES*n*N_PLAYERS) == NULL
+	    || NMALLOC(obs, n_obs) == NULL
+	    || NMALLOC(rewards, n*N_PLAYERS) == NULL
+	    || NMALLOC(dones, n) == NULL)
+		goto bench_env_end;
+
+	for (i = 0; i < ENV_ACTION_TABLES*n*N_PLAYERS; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		actions[i] = x % ENV_N_ACTIONS;
+	}
+
+	n_frames = ctx->frames / 16 + 1;
+	env_batch_reset_mask(&eb, NULL, obs);
+	t0 = now();
+	for (f = 0; f < n_frames; f++) {
+		env_batch_step(&eb, actions + (f % ENV_ACTION_TABLES)
+					* n*N_PLAYERS, obs, rewards, dones);
+		for (i = 0; i < n; i++)
+			games += dones[i];
+	}
+	t = now() - t0;
+
+	report("env", "environments", n, "");
+	report("env", "steps/s", (double)n_frames * n / t, "");
+	report("env", "games finished", games, "");
+
+	/* untimed check against run_game() */
+	env_batch_reset_mask(&eb, NULL, obs);
+	for (i = 0; i < n; i++)
+		ref[i] = game_init(DEF_START_POINTS, i%2);
+	for (f = 0; f < n_frames && f < AGREE_HORIZON*16; f++) {
+		const uint8_t *a = actions + (f % ENV_ACTION_TABLES)*n*N_PLAYERS;
+
+		env_batch_step(&eb, a, obs, rewards, dones);
+		for (i = 0; i < n; i++) {
+			struct commands comm = {{{0}}};
+			struct game_result gr;
+			numeric in[BP_N_INPUTS];
+
+			for (j = 0; j < N_PLAYERS; j++) {
+				uint8_t aj = a[i*N_PLAYERS + j];
+
+				comm.player[j].l = (aj & ENV_ACTION_LEFT) != 0;
+				comm.player[j].r = (aj & ENV_ACTION_RIGHT) != 0;
+				comm.player[j].u = (aj & ENV_ACTION_JUMP) != 0;
+			}
+			gr = run_game(ref + i, comm);
+			mismatch += dones[i] != gr.game_end;
+			for (j = 0; j < N_PLAYERS; j++) {
+				float rw = !gr.set_end? 0
+					: ((gr.scorer_player == j)? 1 : -1);
+
+				mismatch += rewards[i*N_PLAYERS + j] != rw;
+			}
+			if (gr.game_end)
+				ref[i] = game_init(DEF_START_POINTS,
+							gr.has_to_start);
+			else if (gr.set_end)
+				game_reset(ref + i, gr.has_to_start);
+
+			for (j = 0; j < N_PLAYERS; j++) {
+				neural_bp_player_inputs(ref + i, j, in);
+				mismatch += !!memcmp(in, obs + (i*N_PLAYERS + j)
+						* ENV_N_OBS, sizeof(in));
+			}
+		}
+	}
+	report("env", "mismatches", mismatch, "");
+
+	if (mismatch) {
+		printf("env        FAILED\n");
+		ctx->failed = 1;
+	}
+
+bench_env_end:
+	free(ref);
+	free(actions);
+	free(obs);
+	free(rewards);
+	free(dones);
+	env_batch_destroy(eb);
+}
+
+static void *_shm_serve(void *arg)
+{
+	env_server_run(arg);
+	return NULL;
+}
+
+/* One channel of 'n' games served by a thread of this process, against an
+ * env_batch stepped here with the same actions */
+static int _shm_session(const char *name, int n, int steps,
+					const uint8_t *actions, double *t)
+{
+	struct env_server s;
+	struct env_client c = {0};
+	struct env_batch eb = {0};
+	pthread_t server;
+	float *obs = NULL, *rewards = NULL;
+	bool *dones = NULL;
+	const int n_act = n*N_PLAYERS;
+	int code, i, f, mismatch = 0;
+	double t0;
+
+	s = env_server_create(name, 1, n, 1, &code);
+	if (!env_server_valid(s))
+		return -1;
+	if (pthread_create(&server, NULL, _shm_serve, &s)) {
+		env_server_destroy(s);
+		return -1;
+	}
+
+	c = env_client_open(name, &code);
+	eb = env_batch_create(n, DEF_START_POINTS, &code);
+	if (!env_client_valid(c) || !env_batch_valid(eb)
+	    || NMALLOC(obs, n*N_PLAYERS*ENV_N_OBS) == NULL
+	    || NMALLOC(rewards, n*N_PLAYERS) == NULL
+	    || NMALLOC(dones, n) == NULL) {
+		mismatch = -1;
+		goto shm_session_end;
+	}
+
+	t0 = now();
+	for (f = 0; f < steps; f++) {
+		memcpy(c.actions, actions + (f % ENV_ACTION_TABLES)*n_act,
+									n_act);
+		if (env_client_step(&c) != -E_OK) {
+			mismatch++;
+			goto shm_session_end;
+		}
+	}
+	*t = now() - t0;
+
+	for (i = 0; i < n; i++)
+		c.mask[i] = 1;
+	if (env_client_reset(&c) != -E_OK) {
+		mismatch++;
+		goto shm_session_end;
+	}
+	env_batch_reset_mask(&eb, NULL, obs);
+	for (f = 0; f < SHM_CHECK_STEPS; f++) {
+		const uint8_t *a = actions + (f % ENV_ACTION_TABLES)*n_act;
+
+		memcpy(c.actions, a, n_act);
+		if (env_client_step(&c) != -E_OK) {
+			mismatch++;
+			break;
+		}
+		env_batch_step(&eb, a, obs, rewards, dones);
+		mismatch += memcmp(obs, c.obs, n*N_PLAYERS*ENV_N_OBS
+							* sizeof(*obs))
+			|| memcmp(rewards, c.rewards, n*N_PLAYERS
+							* sizeof(*rewards))
+			|| memcmp(dones, c.dones, n*sizeof(*dones));
+	}
+
+shm_session_end:
+	env_server_stop(&s);
+	pthread_join(server, NULL);
+	env_client_close(c);
+	env_server_destroy(s);
+	env_batch_destroy(eb);
+	free(obs);
+	free(rewards);
+	free(dones);
+
+	return mismatch;
+}
+
+/* Round trip time with a single game, and throughput with many */
+static void bench_shm(struct bench_ctx *ctx)
+{
+	const int sizes[] = {1, BATCH_LANES};
+	uint8_t *actions;
+	uint32_t x = ctx->seed | 1;
+	char name[32];
+	int i, k, mismatch = 0;
+
+	if (NMALLOC(actions, ENV_ACTION_TABLES*BATCH_LANES*N_PLAYERS) == NULL)
+		return;
+	for (i = 0; i < ENV_ACTION_TABLES*BATCH_LANES*N_PLAYERS; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		actions[i] = x % ENV_N_ACTIONS;
+	}
+	sprintf(name, "/cslime-bench-%d", (int)getpid());
+
+	for (k = 0; k < ARSIZE(sizes); k++) {
+		int steps = (sizes[k] == 1)? SHM_ROUND_TRIPS
+						: ctx->frames / 16 + 1;
+		char what[40];
+		double t = 1;
+		int m = _shm_session(name, sizes[k], steps, actions, &t);
+
+		if (m < 0) {
+			printf("shm        cannot create %s\n", name);
+			mismatch++;
+			break;
+		}
+		mismatch += m;
+		sprintf(what, "%d games, round trip", sizes[k]);
+		report("shm", what, t*1e6 / steps, "us");
+		sprintf(what, "%d games, steps/s", sizes[k]);
+		report("shm", what, (double)steps * sizes[k] / t, "");
+	}
+	report("shm", "mismatches", mismatch, "");
+
+	if (mismatch) {
+		printf("shm        FAILED\n");
+		ctx->failed = 1;
+	}
+	free(actions);
+}
+
+/* Record the match in a temporary file, then replay it. The cost of the
+ * recording is measured on its own, against the cost of the frames. */
+static void bench_replay(struct bench_ctx *ctx)
+{
+	struct replay_writer w;
+	struct replay_reader r;
+	struct replay_stats st;
+	struct game g, start, *keys = NULL;
+	FILE *f = tmpfile();
+	int *new_game = NULL;
+	long size;
+	int i, code;
+	double t0, t_play, t_rec, t_replay;
+
+	if (f == NULL || NMALLOC(new_game, ctx->frames) == NULL
+	    || NMALLOC(keys, ctx->frames / REPLAY_KEY_INTERVAL + 1) == NULL)
+		goto bench_replay_end;
+
+	/* the turn of the new game started after each frame, or -1 */
+	start = g = game_init(DEF_START_POINTS, 0);
+	t0 = now();
+	for (i = 0; i < ctx->frames; i++) {
+		struct game_result gr = run_game(&g, ctx->comm[i]);
+
+		new_game[i] = gr.game_end? ctx->new_turn[i] : -1;
+		next_set(&g, gr, ctx->new_turn[i]);
+		if ((i + 1) % REPLAY_KEY_INTERVAL == 0)
+			keys[(i + 1) / REPLAY_KEY_INTERVAL] = g;
+	}
+	t_play = now() - t0;
+
+	replay_writer_open(&w, f, ctx->seed, DEF_START_POINTS, &start);
+	t0 = now();
+	for (i = 0; i < ctx->frames; i++)
+		replay_write_frame(&w, ctx->comm + i, new_game[i],
+					keys + (i + 1) / REPLAY_KEY_INTERVAL);
+	code = replay_writer_close(&w, &g);
+	t_rec = now() - t0;
+	size = ftell(f);
+
+	rewind(f);
+	if (code < 0 || replay_reader_open(&r, f) < 0) {
+		printf("replay     cannot write the replay\n");
+		ctx->failed = 1;
+		goto bench_replay_end;
+	}
+	t0 = now();
+	code = replay_play(&r, &g, &st);
+	t_replay = now() - t0;
+
+	report("replay", "bytes per frame", (double)size / ctx->frames, "");
+	report("replay", "recording", t_rec*1e9 / ctx->frames, "ns/frame");
+	report("replay", "recording / frame time", 100 * t_rec / t_play, "%");
+	report("replay", "replay frames/s", st.frames / t_replay, "");
+	report("replay", "fast-forwarded", 100.0 * st.skipped / st.frames, "%");
+	report("replay", "run_game() frames/s", ctx->frames / t_play, "");
+	report("replay", "keyframes checked", st.keys, "");
+
+	if (code < 0 || !st.end_ok || st.frames != ctx->frames
+	    || st.first_diff >= 0) {
+		printf("replay     FAILED\n");
+		ctx->failed = 1;
+	}
+
+bench_replay_end:
+	if (f != NULL)
+		fclose(f);
+	free(new_game);
+	free(keys);
+}
+
+struct seek_shard {
+	const struct replay_map *m;
+	long from, to;
+	bool ok;
+	pthread_t thread;
+};
+
+/* Play a part of the replay and check that it ends in the state that seeking
+ * there gives */
+static void *_seek_shard(void *arg)
+{
+	struct seek_shard *sh = arg;
+	struct game g, ref;
+	long f;
+
+	sh->ok = replay_map_seek(sh->m, sh->from, &g) == -E_OK
+			&& replay_map_seek(sh->m, sh->to, &ref) == -E_OK;
+	for (f = sh->from; f < sh->to; f++)
+		replay_map_step(sh->m, f, &g);
+	sh->ok = sh->ok && _same_game(&g, &ref);
+
+	return NULL;
+}
+
+/* Record the match to a file with its index, seek to frames spread along it
+ * and play it split in as many parts as cores */
+static void bench_seek(struct bench_ctx *ctx)
+{
+	struct replay_writer w;
+	struct replay_map m = {0};
+	struct game g, *before = NULL;
+	struct game_snapshot end;
+	struct seek_shard *shards = NULL;
+	char path[] = SEEK_FILE, what[32];
+	long n_threads = (ctx->threads > 0)? ctx->threads
+					: sysconf(_SC_NPROCESSORS_ONLN);
+	long n_samples = (ctx->frames < SEEK_SAMPLES)? ctx->frames
+							: SEEK_SAMPLES;
+	long every = ctx->frames / n_samples;
+	long i, j, bad = 0;
+	uint32_t x = ctx->seed | 1;
+	FILE *f = NULL;
+	int fd, code;
+	double t0, t_seek, t_shards;
+
+	fd = mkstemp(path);
+	if (fd < 0 || (f = fdopen(fd, "wb")) == NULL
+	    || NMALLOC(before, n_samples) == NULL
+	    || NCALLOC(shards, n_threads) == NULL) {
+		printf("seek       cannot create %s\n", path);
+		ctx->failed = 1;
+		goto bench_seek_end;
+	}
+
+	g = game_init(DEF_START_POINTS, 0);
+	replay_writer_open(&w, f, ctx->seed, DEF_START_POINTS, &g);
+	for (i = 0; i < ctx->frames; i++) {
+		struct game_result gr;
+
+		if (i % every == 0 && i / every < n_samples)
+			before[i / every] = g;
+		gr = run_game(&g, ctx->comm[i]);
+		next_set(&g, gr, ctx->new_turn[i]);
+		replay_write_frame(&w, ctx->comm + i,
+				gr.game_end? ctx->new_turn[i] : -1, &g);
+	}
+	code = replay_writer_close(&w, &g);
+	fclose(f);
+	f = NULL;
+	if (code < 0 || replay_map_open(&m, path) < 0) {
+		printf("seek       cannot map the replay\n");
+		ctx->failed = 1;
+		goto bench_seek_end;
+	}
+
+	/* random order, so that no seek starts where the last one ended */
+	t0 = now();
+	for (i = 0; i < n_samples; i++) {
+		struct game s;
+
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		j = x % n_samples;
+		if (replay_map_seek(&m, j * every, &s) < 0
+		    || !_same_game(&s, before + j))
+			bad++;
+	}
+	t_seek = now() - t0;
+	if (replay_map_seek(&m, m.frames, &g) < 0)
+		bad++;
+	game_snapshot(&g, &end);
+	bad += !_same_snapshot(&end, &m.end);
+
+	/* the parts start and end at keyframes */
+	t0 = now();
+	for (i = 0; i < n_threads; i++) {
+		shards[i].m = &m;
+		shards[i].from = (m.n_keys - 1) * i / n_threads
+							* m.key_interval;
+		shards[i].to = (i == n_threads - 1)? m.frames
+			: (m.n_keys - 1) * (i + 1) / n_threads * m.key_interval;
+		pthread_create(&shards[i].thread, NULL, _seek_shard,
+								shards + i);
+	}
+	for (i = 0; i < n_threads; i++) {
+		pthread_join(shards[i].thread, NULL);
+		bad += !shards[i].ok;
+	}
+	t_shards = now() - t0;
+
+	report("seek", "keyframe bytes per frame",
+			(double)(m.size - 2*m.frames) / m.frames, "");
+	report("seek", "seek to a random frame", t_seek*1e6 / n_samples, "us");
+	sprintf(what, "%ld parts frames/s", n_threads);
+	report("seek", what, m.frames / t_shards, "");
+
+	if (bad) {
+		printf("seek       FAILED\n");
+		ctx->failed = 1;
+	}
+
+bench_seek_end:
+	if (f != NULL)
+		fclose(f);
+	if (fd >= 0)
+		unlink(path);
+	replay_map_close(&m);
+	free(before);
+	free(shards);
+}
+
+static void bench_traj(struct bench_ctx *ctx)
+{
+	struct traj_encoder e;
+	struct traj_decoder d;
+	struct game_snapshot *snaps = NULL, s;
+	struct game g;
+	FILE *f = tmpfile();
+	long size, n = 0;
+	int i, code;
+	double t0, t_play, t_enc, t_dec;
+	bool same = 1;
+
+	if (f == NULL || NMALLOC(snaps, ctx->frames) == NULL)
+		goto bench_traj_end;
+
+	g = game_init(DEF_START_POINTS, 0);
+	t0 = now();
+	for (i = 0; i < ctx->frames; i++) {
+		struct game_result gr = run_game(&g, ctx->comm[i]);
+
+		next_set(&g, gr, ctx->new_turn[i]);
+		game_snapshot(&g, snaps + i);
+	}
+	t_play = now() - t0;
+
+	t0 = now();
+	traj_encoder_open(&e, f, TRAJ_KEY_INTERVAL);
+	for (i = 0; i < ctx->frames; i++)
+		traj_encode(&e, snaps + i);
+	code = traj_encoder_close(&e);
+	t_enc = now() - t0;
+	size = ftell(f);
+
+	rewind(f);
+	if (code < 0 || traj_decoder_open(&d, f) < 0) {
+		printf("traj       cannot write the trajectory\n");
+		ctx->failed = 1;
+		goto bench_traj_end;
+	}
+	t0 = now();
+	while ((code = traj_decode(&d, &s)) > 0) {
+		if (n < ctx->frames)
+			same = same && _same_snapshot(&s, snaps + n);
+		n++;
+	}
+	t_dec = now() - t0;
+	traj_decoder_close(&d);
+
+	report("traj", "bytes per frame", (double)size / ctx->frames, "");
+	report("traj", "ratio to struct game",
+			(double)sizeof(struct game) * ctx->frames / size, ":1");
+	report("traj", "ratio to encoded snapshots",
+		(double)SNAPSHOT_ENCODED_SIZE * ctx->frames / size, ":1");
+	report("traj", "encoding", t_enc*1e9 / ctx->frames, "ns/frame");
+	report("traj", "decoding", t_dec*1e9 / ctx->frames, "ns/frame");
+	report("traj", "run_game()", t_play*1e9 / ctx->frames, "ns/frame");
+
+	if (code < 0 || !same || n != ctx->frames) {
+		printf("traj       FAILED\n");
+		ctx->failed = 1;
+	}
+
+bench_traj_end:
+	if (f != NULL)
+		fclose(f);
+	free(snaps);
+}
+
+static const struct bench Benches[] = {
+	{"greedy", bench_greedy, "greedy vs. greedy match at full speed"},
+	{"neural", bench_neural, "neural vs. greedy match at full speed"},
+	{"physics", bench_physics, "run_game() replaying recorded commands"},
+	{"fixed", bench_fixed, "run_game_fixed() replaying recorded commands"},
+	{"notrig", bench_notrig, "run_game() with the trigonometry-free collisions"},
+	{"params", bench_params, "run_game() with run time physics parameters"},
+	{"variants", bench_variants, "compile-time engine variants against run_game()"},
+	{"broad", bench_broad, "how often the broad phase skips a collision test"},
+	{"agree", bench_agree, "compare the polar and the trigonometry-free paths"},
+	{"ccd", bench_ccd, "run_game_ccd() speed and deviation from run_game()"},
+	{"adaptive", bench_adaptive, "run_game_adaptive() speed and deviation from run_game()"},
+	{"multi", bench_multi, "N-slime, multi-ball engine with and without the grid"},
+	{"until", bench_until, "game_advance_until_event() against plain stepping"},
+	{"repeat", bench_repeat, "run_game_repeat() against calling run_game() k times"},
+	{"snapshot", bench_snapshot, "game_snapshot() and game_restore() cost and exactness"},
+	{"state", bench_state, "struct game_snapshot buffers against struct game ones"},
+	{"rollout", bench_rollout, "rollout_run() scaling with the number of threads"},
+	{"copies", bench_copies, "by value API against the pointer API"},
+	{"kernels", bench_kernels, "cost per call of the physics routines"},
+	{"math", bench_math, "speed and error of the tiers of fastmath.h"},
+	{"wide", bench_wide, "vector_wide.h operations against the scalar ones"},
+	{"batch", bench_batch, "run_game_batch() replaying recorded commands"},
+	{"env", bench_env, "env_batch_step() speed and agreement with run_game()"},
+	{"shm", bench_shm, "environment server round trips through shared memory"},
+	{"replay", bench_replay, "recording of a match and replay at full speed"},
+	{"seek", bench_seek, "random access and parallel replay through the index"},
+	{"traj", bench_traj, "compressed trajectories: size, speed and exactness"},
+};
+
+static void usage(const char *prog)
+{
+	int i;
+
+	fprintf(stderr,
+		"usage: %s [-f frames] [-s seed] [-n player.net] [-t threads] "
+		"[test ...]\n"
+		"tests:\n", prog);
+	for (i = 0; i < ARSIZE(Benches); i++)
+		fprintf(stderr, "\t%-10s %s\n", Benches[i].name, Benches[i].help);
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_ctx ctx = {0};
+	const char *net_file = NULL;
+	int opt, i, code = -E_OK;
+
+	ctx.frames = DEF_FRAMES;
+	ctx.seed = DEF_SEED;
+
+	while ((opt = getopt(argc, argv, "f:s:n:t:h")) != -1) {
+		switch (opt) {
+		case 'f': ctx.frames = atoi(optarg);	break;
+		case 's': ctx.seed = atoi(optarg);	break;
+		case 'n': net_file = optarg;		break;
+		case 't': ctx.threads = atoi(optarg);	break;
+		default:
+			usage(argv[0]);
+			return E_BADARGS;
+		}
+	}
+	if (ctx.frames <= 0) {
+		usage(argv[0]);
+		return E_BADARGS;
+	}
+
+	if (net_file != NULL) {
+		FILE *f = fopen(net_file, "r");
+
+		if (f != NULL) {
+			ctx.brain = neural_bp_player_fread(f);
+			fclose(f);
+		} else {
+			MLP_mark_invalid(ctx.brain);
+		}
+		if (!neural_bp_player_valid_data(ctx.brain)) {
+			fprintf(stderr, "cannot load %s\n", net_file);
+			return E_BADCFG;
+		}
+	} else {
+		srand(ctx.seed);
+		ctx.brain = neural_bp_player_create(N_HIDDEN, &code);
+		if (code < 0)
+			return -code;
+	}
+
+	if ((code = record_match(&ctx)) < 0) {
+		fprintf(stderr, "out of memory\n");
+		goto bench_end;
+	}
+
+	for (i = 0; i < ARSIZE(Benches); i++) {
+		int k, selected = (optind == argc);
+
+		for (k = optind; k < argc; k++)
+			selected |= !strcmp(argv[k], Benches[i].name);
+		if (selected)
+			Benches[i].run(&ctx);
+	}
+	if (ctx.failed)
+		code = -E_OTHER;
+
+bench_end:
+	free(ctx.comm);
+	free(ctx.new_turn);
+	free(ctx.samples);
+	neural_bp_player_destroy_data(ctx.brain);
+
+	return -code;
+}
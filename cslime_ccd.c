@@ -0,0 +1,290 @@
+/*
+ * cslime_ccd.c
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Time is measured in substeps, so that the frame spans [0, n_sub] (the
+ * oversampling of the physics parameters) and the scaled constants can be used
+ * unchanged.
+ * The substep engine does pos += vel; vel += acc. Its trajectory, evaluated
+ * at any time t (not only at integers) is
+ * 	pos(t) = pos(0) + vel(0)*t + acc*t*(t-1)/2
+ * 	vel(t) = vel(0) + acc*t
+ * and this is what we follow between contacts.
+ *
+ * The time of the next contact is found by conservative advancement: the gap
+ * between the ball and each obstacle cannot shrink faster than their relative
+ * speed, so we can always advance by gap/speed without going through it.
+ * When the ball is in free flight the first advancement already reaches the
+ * end of the frame.
+ */
+
+#include <math.h>
+#include "common.h"
+#include "cslime.h"
+#include "cslime_phys.h"
+#include "cslime_ccd.h"
+
+/* A contact happens when the gap gets below this */
+#define CCD_CONTACT_TOL (BALL_R*1e-3f)
+/* Advancement used while the ball is leaving a contact */
+#define CCD_MIN_STEP (1.0f/64)
+/* After this many advancements in a frame, give up and finish it with the
+ * substep engine */
+#define CCD_MAX_STEPS 64
+
+#ifdef CSLIME_STATS
+struct ccd_stats CcdStats;
+#define COUNT_CCD(field) (CcdStats.field++)
+#else
+#define COUNT_CCD(field)
+#endif /* CSLIME_STATS */
+
+enum {OBST_WORLD, OBST_NET, OBST_PLAYER, N_OBSTACLES = OBST_PLAYER + N_PLAYERS};
+
+/* distance between the surfaces of the ball and an obstacle, and the normal
+ * of the obstacle at the closest point */
+struct gap {
+	float gap;
+	struct r_vector normal;
+};
+
+static struct gap world_gap(struct r_vector c, float r)
+{
+	static const struct r_vector normals[] = {{1, 0}, {-1, 0}, {0, 1},
+								{0, -1}};
+	float d[] = {c.x, GAME_AREA_W - c.x, c.y, GAME_AREA_H - c.y};
+	struct gap wg;
+	int i, closest = 0;
+
+	for (i = 1; i < ARSIZE(d); i++) {
+		if (d[i] < d[closest])
+			closest = i;
+	}
+	wg.gap = d[closest] - r;
+	wg.normal = normals[closest];
+
+	return wg;
+}
+
+static struct gap net_gap(struct r_vector c, float r)
+{
+	static const struct limit net_x = {PLAYER_AREA_W, PLAYER_AREA_W + NET_W};
+	static const struct limit net_y = {PLAYER_AREA_H - NET_H, PLAYER_AREA_H};
+	struct r_vector delta = r_subs(c, r_clip(c, net_x, net_y));
+	float dist = r_abs(delta);
+	struct gap ng;
+
+	if (dist > 0) {
+		ng.gap = dist - r;
+		ng.normal = r_scale(delta, 1/dist);
+	} else {
+		/* the center is inside the net, push it up */
+		ng.gap = -(c.y - net_y.min) - r;
+		ng.normal = r_make(0, -1);
+	}
+
+	return ng;
+}
+
+/* The player is a half-disc. The substep engine does not collide with its
+ * flat side, so we only take into account the upper half plane. */
+static struct gap player_gap(struct r_vector c, float r, struct free_body p)
+{
+	struct r_vector p_center = r_make(p.pos.x + p.box.x/2, p.pos.y + p.box.y);
+	struct r_vector delta = r_subs(c, p_center);
+	float dist = r_abs(delta);
+	struct gap pg;
+
+	pg.gap = fmaxf(dist - (p.box.y + r), delta.y);
+	pg.normal = (dist > 0)? r_scale(delta, 1/dist) : r_make(0, -1);
+
+	return pg;
+}
+
+/* Position of a player at time 't', interpolated between substeps */
+static struct free_body player_at(struct player path[][N_PLAYERS], int n_sub,
+							int j, float t)
+{
+	int k = t;
+	struct free_body p;
+
+	if (k >= n_sub)
+		return path[n_sub][j].body;
+
+	p = path[k + 1][j].body;
+	p.pos = r_sum(path[k][j].body.pos,
+		r_scale(r_subs(path[k + 1][j].body.pos, path[k][j].body.pos),
+								t - k));
+	return p;
+}
+
+static struct r_vector reflect(struct r_vector v, struct r_vector normal,
+							float conservation)
+{
+	return r_subs(v, r_scale(normal, (1 + conservation)*r_dot(v, normal)));
+}
+
+static void advance(struct kinetic *k, struct r_vector acc, float dt)
+{
+	k->pos = r_sum(k->pos, r_sum(r_scale(k->vel, dt),
+					r_scale(acc, dt*(dt - 1)/2)));
+	k->vel = r_sum(k->vel, r_scale(acc, dt));
+}
+
+/* Finish the frame with the substep engine, from time 't' */
+static struct game_result ccd_fallback(struct game *g, struct kinetic k,
+			struct player path[][N_PLAYERS], int n_sub, float t)
+{
+	struct game_result gr = {0};
+	int s, j;
+
+	COUNT_CCD(fallbacks);
+
+	s = ceilf(t);
+	advance(&k, g->b.body.acc, s - t);
+	g->b.body.pos = k.pos;
+	g->b.body.vel = k.vel;
+
+	for (s = s + 1; s <= n_sub; s++) {
+		for (j = 0; j < N_PLAYERS; j++)
+			g->p[j].body = path[s][j].body;
+		ball_step(g);
+		gr = game_umpire(g);
+		if (gr.set_end)
+			return gr;
+	}
+	for (j = 0; j < N_PLAYERS; j++)
+		g->p[j].body = path[n_sub][j].body;
+
+	return gr;
+}
+
+struct game_result run_game_ccd(struct game *g, struct commands comm)
+{
+	struct game_result gr = {0};
+	struct player path[MAX_OVERSAMPLING + 1][N_PLAYERS];
+	const int n_sub = g->phys->oversampling;
+	const float conservation = g->phys->conservation;
+	struct game pg = *g;
+	struct kinetic k;
+	struct r_vector acc = g->b.body.acc;
+	float r = g->b.body.box.y/2;
+	float p_speed = 0, t = 0;
+	int s, j, steps;
+
+	COUNT_CCD(frames);
+
+	/* players */
+	for (j = 0; j < N_PLAYERS; j++)
+		path[0][j] = pg.p[j];
+	for (s = 1; s <= n_sub; s++) {
+		players_step(&pg, comm);
+		for (j = 0; j < N_PLAYERS; j++) {
+			path[s][j] = pg.p[j];
+			p_speed = fmaxf(p_speed, r_dist(path[s][j].body.pos,
+						path[s - 1][j].body.pos));
+		}
+	}
+
+	/* ball */
+	k.pos = g->b.body.pos;
+	k.vel = g->b.body.vel;
+	for (steps = 0; t < n_sub; steps++) {
+		struct r_vector c = r_make(k.pos.x + r, k.pos.y + r);
+		struct gap gaps[N_OBSTACLES];
+		struct free_body p[N_PLAYERS];
+		float speed, dt;
+		int o;
+
+		if (steps == CCD_MAX_STEPS)
+			return ccd_fallback(g, k, path, n_sub, t);
+		COUNT_CCD(steps);
+
+		gaps[OBST_WORLD] = world_gap(c, r);
+		gaps[OBST_NET] = net_gap(c, r);
+		for (j = 0; j < N_PLAYERS; j++) {
+			p[j] = player_at(path, n_sub, j, t);
+			gaps[OBST_PLAYER + j] = player_gap(c, r, p[j]);
+		}
+
+		/* resolve the contacts, in the same order as ball_collisions() */
+		if (gaps[OBST_WORLD].gap < CCD_CONTACT_TOL
+			&& r_dot(k.vel, gaps[OBST_WORLD].normal) < 0) {
+			COUNT_CCD(contacts);
+			k.vel = reflect(k.vel, gaps[OBST_WORLD].normal,
+							conservation);
+			if (gaps[OBST_WORLD].normal.y < 0) {
+				/* the floor */
+				for (j = 0; j < N_PLAYERS; j++)
+					g->p[j].body = path[(int)ceilf(t)][j].body;
+				g->b.body.pos = k.pos;
+				g->b.body.vel = k.vel;
+				gr = game_umpire(g);
+				if (gr.set_end)
+					return gr;
+			}
+		}
+		for (j = 0; j < N_PLAYERS; j++) {
+			struct gap pgap = gaps[OBST_PLAYER + j];
+			struct r_vector dv = r_subs(k.vel, p[j].vel);
+			struct r_vector dp = pgap.normal;
+
+			/* same test as original_collision() */
+			dp.x *= g->phys->bouncicity_x;
+			if (pgap.gap < CCD_CONTACT_TOL && r_dot(dv, dp) < 0) {
+				COUNT_CCD(contacts);
+				k = original_collision(g->b.body, k, p[j],
+								g->phys);
+			}
+		}
+		if (gaps[OBST_NET].gap < CCD_CONTACT_TOL
+			&& r_dot(k.vel, gaps[OBST_NET].normal) < 0) {
+			COUNT_CCD(contacts);
+			k.vel = reflect(k.vel, gaps[OBST_NET].normal,
+							conservation);
+		}
+
+		/* advance up to the next possible contact */
+		speed = r_abs(r_subs(k.vel, r_scale(acc, .5f)))
+					+ r_abs(acc) * (n_sub - t);
+		dt = n_sub - t;
+		for (o = 0; o < N_OBSTACLES; o++) {
+			float rel_speed = speed + ((o >= OBST_PLAYER)? p_speed : 0);
+
+			if (gaps[o].gap < CCD_CONTACT_TOL)
+				dt = fminf(dt, CCD_MIN_STEP);
+			else if (gaps[o].gap < dt * rel_speed)
+				dt = gaps[o].gap / rel_speed;
+		}
+
+		advance(&k, acc, dt);
+		t = (dt == n_sub - t)? n_sub : t + dt;
+	}
+
+	g->b.body.pos = k.pos;
+	g->b.body.vel = k.vel;
+	for (j = 0; j < N_PLAYERS; j++)
+		g->p[j].body = path[n_sub][j].body;
+
+	return gr;
+}
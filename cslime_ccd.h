@@ -0,0 +1,60 @@
+/*
+ * cslime_ccd.h
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Continuous collision detection engine.
+ * Instead of moving the ball OVERSAMPLING times per frame and testing for
+ * collisions after each substep, the ball follows its parabola until the
+ * earliest time at which it touches the court, the net or a player. There the
+ * contact is resolved and the flight continues. A frame in which the ball
+ * does not touch anything costs a single step.
+ *
+ * The players are still simulated substep by substep (they are cheap and
+ * their movement is driven by the commands) and are interpolated in between.
+ * The collision responses are the ones of cslime.c, so the result is close to
+ * run_game(), but not the same: cslime-bench reports the deviation.
+ */
+
+#ifndef _CSLIME_CCD_H_
+#define _CSLIME_CCD_H_
+
+#include "cslime.h"
+
+/* Counters, only updated when built with -DCSLIME_STATS.
+ * 'steps' counts the advancements of the ball, 'fallbacks' the frames that
+ * needed too many of them and were finished with the substep engine. */
+struct ccd_stats {
+	unsigned long frames;
+	unsigned long steps;
+	unsigned long contacts;
+	unsigned long fallbacks;
+};
+
+#ifdef CSLIME_STATS
+extern struct ccd_stats CcdStats;
+#endif
+
+struct game_result run_game_ccd(struct game *g, struct commands comm);
+	/* Same as run_game(), but with continuous collision detection */
+
+#endif /* _CSLIME_CCD_H_ */
@@ -0,0 +1,146 @@
+/*
+ * cslime_env.c
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include "common.h"
+#include "cslime.h"
+#include "cslime_env.h"
+
+struct env_batch env_batch_create(int n, int start_points, int *ret_code)
+{
+	struct env_batch eb = {0};
+	int code = -E_OK;
+
+	if (n <= 0 || start_points <= 0) {
+		code = -E_BADARGS;
+		goto env_batch_create_end;
+	}
+
+	eb.gb = game_batch_create(n, &code);
+	if (!game_batch_valid(eb.gb))
+		goto env_batch_create_end;
+
+	eb.mem = calloc(1, n*(sizeof(*eb.comm) + sizeof(*eb.gr)));
+	if (eb.mem == NULL) {
+		game_batch_destroy(eb.gb);
+		code = -E_NOMEM;
+		goto env_batch_create_end;
+	}
+	eb.comm = eb.mem;
+	eb.gr = (struct game_result*)(eb.comm + n);
+	eb.n = n;
+	eb.start_points = start_points;
+	env_batch_reset_mask(&eb, NULL, NULL);
+
+env_batch_create_end:
+	if (ret_code != NULL)
+		*ret_code = code;
+
+	return eb;
+}
+
+void env_batch_destroy(struct env_batch eb)
+{
+	if (env_batch_valid(eb))
+		game_batch_destroy(eb.gb);
+	free(eb.mem);
+}
+
+static void _env_new_game(struct env_batch *eb, int i, int turn)
+{
+	struct game g = game_init(eb->start_points, turn);
+
+	game_batch_set(&eb->gb, i, &g);
+}
+
+/* Same as neural_bp_player_inputs(), straight from the lanes */
+static void _env_observe(const struct env_batch *eb, float *obs)
+{
+	const struct body_lanes *b = &eb->gb.b;
+	int i, j;
+
+	for (i = 0; i < eb->n; i++) {
+		for (j = 0; j < N_PLAYERS; j++) {
+			const struct body_lanes *p = &eb->gb.p[j].body;
+
+			obs[BP_INPUT_PX] = p->x[i];
+			obs[BP_INPUT_PY] = p->y[i];
+			obs[BP_INPUT_BX] = b->x[i];
+			obs[BP_INPUT_BY] = b->y[i];
+			obs[BP_INPUT_BVX] = b->vx[i];
+			obs[BP_INPUT_BVY] = b->vy[i];
+			obs += ENV_N_OBS;
+		}
+	}
+}
+
+void env_batch_reset_mask(struct env_batch *eb, const bool *mask,
+								float *obs)
+{
+	int i;
+
+	for (i = 0; i < eb->n; i++) {
+		if (mask == NULL || mask[i])
+			_env_new_game(eb, i, i%2);
+	}
+	if (obs != NULL)
+		_env_observe(eb, obs);
+}
+
+void env_batch_step(struct env_batch *eb, const uint8_t *actions,
+			float *obs, float *rewards, bool *dones)
+{
+	int i, j;
+
+	for (i = 0; i < eb->n; i++) {
+		for (j = 0; j < N_PLAYERS; j++) {
+			struct pcontrol *pc = eb->comm[i].player + j;
+			uint8_t a = *actions++;
+
+			pc->l = (a & ENV_ACTION_LEFT) != 0;
+			pc->r = (a & ENV_ACTION_RIGHT) != 0;
+			pc->u = (a & ENV_ACTION_JUMP) != 0;
+		}
+	}
+
+	run_game_batch(&eb->gb, eb->comm, eb->gr);
+
+	/* The player who scored the last point starts the next set, also in a
+	 * new game (gr->has_to_start is the scorer, see game_umpire). */
+	for (i = 0; i < eb->n; i++) {
+		const struct game_result *gr = eb->gr + i;
+
+		for (j = 0; j < N_PLAYERS; j++) {
+			rewards[i*N_PLAYERS + j] = !gr->set_end? 0
+					: ((gr->scorer_player == j)? 1 : -1);
+		}
+		dones[i] = gr->game_end;
+		if (gr->game_end)
+			_env_new_game(eb, i, gr->has_to_start);
+		else if (gr->set_end)
+			game_batch_reset(&eb->gb, i, gr->has_to_start);
+	}
+
+	_env_observe(eb, obs);
+}
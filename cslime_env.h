@@ -0,0 +1,81 @@
+/*
+ * cslime_env.h
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Batch of environments for reinforcement learning.
+ * Each environment is a game between two agents, stepped by the batch engine
+ * (cslime_batch.h) together with the others. After each step the caller gets
+ * the observations, the rewards and which games ended. Finished sets and
+ * games are restarted in place, so the observations of an environment that
+ * is done are already those of its new game.
+ *
+ * The buffers are given by the caller and are laid out by environment and
+ * then by player:
+ * 	actions[i*N_PLAYERS + j]	ENV_ACTION_* bits of player j
+ * 	obs[(i*N_PLAYERS + j)*ENV_N_OBS + k]	input k of the neural player
+ * 					(BP_INPUT_*) for player j
+ * 	rewards[i*N_PLAYERS + j]	+1 if player j won a point, -1 if it
+ * 					lost one, 0 otherwise
+ * 	dones[i]			the game (not just the set) ended
+ * No memory is allocated after env_batch_create().
+ */
+
+#ifndef _CSLIME_ENV_H_
+#define _CSLIME_ENV_H_
+
+#include <stdint.h>
+#include "cslime.h"
+#include "cslime_ai.h"
+#include "cslime_batch.h"
+
+enum {ENV_ACTION_LEFT = 1, ENV_ACTION_RIGHT = 2, ENV_ACTION_JUMP = 4,
+							ENV_N_ACTIONS = 8};
+
+#define ENV_N_OBS BP_N_INPUTS
+
+struct env_batch {
+	int n;
+	int start_points;
+	struct game_batch gb;
+	struct commands *comm;
+	struct game_result *gr;
+
+	void *mem;
+};
+
+#define env_batch_valid(eb) ((eb).mem != NULL)
+
+struct env_batch env_batch_create(int n, int start_points, int *ret_code);
+	/* n environments, each one a new game with 'start_points' */
+void env_batch_destroy(struct env_batch eb);
+
+void env_batch_step(struct env_batch *eb, const uint8_t *actions,
+			float *obs, float *rewards, bool *dones);
+	/* Play one frame in every environment. */
+void env_batch_reset_mask(struct env_batch *eb, const bool *mask,
+								float *obs);
+	/* Start a new game in the environments with mask[i] set, or in all of
+	 * them if mask is NULL, and write the observations of every
+	 * environment. */
+
+#endif /* _CSLIME_ENV_H_ */
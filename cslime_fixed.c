@@ -0,0 +1,676 @@
+/*
+ * cslime_fixed.c
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* This mirrors cslime.c function by function. The polar coordinates used by
+ * the float engine are replaced by sign tests of dot and cross products, so
+ * no transcendental function is needed. The only square root is computed on
+ * integers.
+ *
+ * Products are done in 64 bits (Q58) and shifted back. The right shift of a
+ * negative number is implementation defined in C, we assume (as gcc and clang
+ * do on every target) that it is arithmetic.
+ */
+
+#include <math.h>
+#include "common.h"
+#include "cslime.h"
+#include "cslime_phys.h"
+#include "cslime_fixed.h"
+
+#define FX_CONSERVATION FX_C(CONSERVATION)
+#define FX_CONSERVATION_WALL FX_C(CONSERVATION_WALL)
+#define FX_TRANSMISSION FX_C(TRANSMISSION)
+
+static const struct fx_vector fx_zero = {0, 0};
+
+static const struct fx_limit FxZoneLimX[N_PLAYERS] = {
+	{FX_C(0), FX_C(PLAYER_AREA_W)},
+	{FX_C(AREA2_STARTX), FX_C(AREA2_STARTX + PLAYER_AREA_W)}};
+static const struct fx_limit FxLimY = {FX_C(0), FX_C(GAME_AREA_H)};
+static const struct fx_limit FxVLimX = {FX_C(.000f/SAMPLE_FACTOR),
+						FX_C(.0065f/SAMPLE_FACTOR)};
+static const struct fx_limit FxVLimY = {FX_C(.000f/SAMPLE_FACTOR),
+						FX_C(.00515f/SAMPLE_FACTOR)};
+
+static const struct fx_vector fx_net_poly[] = {
+	{FX_C(PLAYER_AREA_W), FX_C(PLAYER_AREA_H - NET_H)},
+	{FX_C(PLAYER_AREA_W + NET_W), FX_C(PLAYER_AREA_H - NET_H)},
+	{FX_C(PLAYER_AREA_W + NET_W), FX_C(PLAYER_AREA_H)},
+	{FX_C(PLAYER_AREA_W), FX_C(PLAYER_AREA_H)}
+};
+static const struct fx_vector fx_world_poly[] = {
+	{FX_C(0), FX_C(GAME_AREA_H)},
+	{FX_C(GAME_AREA_W), FX_C(GAME_AREA_H)},
+	{FX_C(GAME_AREA_W), FX_C(0)},
+	{FX_C(0), FX_C(0)},
+};
+
+/* An angular sector, swept in the positive direction from the direction of
+ * 'from' up to the direction of 'to'. The vectors need not be unitary. */
+struct fx_arc {
+	struct fx_vector from, to;
+};
+
+/* sectors used for the corners of the players, see ball_player_collision() */
+static const struct fx_arc PlayerRightArc = {{-FX_ONE, 0}, {0, -FX_ONE}};
+static const struct fx_arc PlayerLeftArc = {{0, -FX_ONE}, {FX_ONE, 0}};
+
+/* ---------------------------- arithmetic ------------------------------ */
+
+fixed fx_from_float(float f)
+{
+	return lrintf(f * FX_ONE);
+}
+
+float fx_to_float(fixed a)
+{
+	return (float)a * (1.0f / FX_ONE);
+}
+
+static inline fixed fx_mul(fixed a, fixed b)
+{
+	return ((int64_t)a * b) >> FX_FRAC_BITS;
+}
+
+/* a Q58 value divided by a Q29 one */
+static inline fixed fx_wdiv(int64_t a, fixed b)
+{
+	return a / b;
+}
+
+static inline fixed fx_abs(fixed a)
+{
+	return (a < 0)? -a : a;
+}
+
+/* floor(sqrt(a)). The estimate is corrected, so the result does not depend
+ * on how the floating point square root rounds. */
+static inline uint32_t isqrt64(uint64_t a)
+{
+	uint64_t r = sqrt((double)a);
+
+	while (r*r > a)
+		r--;
+	while ((r + 1)*(r + 1) <= a)
+		r++;
+
+	return r;
+}
+
+static inline struct fx_vector fx_make(fixed x, fixed y)
+{
+	struct fx_vector v;
+	v.x = x;
+	v.y = y;
+	return v;
+}
+
+static inline struct fx_vector fx_sum(struct fx_vector v1, struct fx_vector v2)
+{
+	v1.x += v2.x;
+	v1.y += v2.y;
+
+	return v1;
+}
+
+static inline struct fx_vector fx_subs(struct fx_vector v1, struct fx_vector v2)
+{
+	v1.x -= v2.x;
+	v1.y -= v2.y;
+
+	return v1;
+}
+
+static inline struct fx_vector fx_scale(struct fx_vector v, fixed a)
+{
+	v.x = fx_mul(v.x, a);
+	v.y = fx_mul(v.y, a);
+
+	return v;
+}
+
+/* v * a / d, without losing precision in the quotient */
+static inline struct fx_vector fx_scale_div(struct fx_vector v, fixed a,
+								fixed d)
+{
+	v.x = ((int64_t)v.x * a) / d;
+	v.y = ((int64_t)v.y * a) / d;
+
+	return v;
+}
+
+static inline struct fx_vector fx_normal(struct fx_vector v)
+{
+	struct fx_vector r;
+
+	r.x = -v.y;
+	r.y = v.x;
+	return r;
+}
+
+/* dot and cross products, in Q58 */
+static inline int64_t fx_wdot(struct fx_vector v1, struct fx_vector v2)
+{
+	return (int64_t)v1.x * v2.x + (int64_t)v1.y * v2.y;
+}
+
+static inline int64_t fx_wcross(struct fx_vector v1, struct fx_vector v2)
+{
+	return (int64_t)v1.x * v2.y - (int64_t)v1.y * v2.x;
+}
+
+static inline fixed fx_dot(struct fx_vector v1, struct fx_vector v2)
+{
+	return fx_wdot(v1, v2) >> FX_FRAC_BITS;
+}
+
+static inline fixed fx_norm(struct fx_vector v)
+{
+	return isqrt64(fx_wdot(v, v));
+}
+
+static inline struct fx_vector fx_unit(struct fx_vector v)
+{
+	return fx_scale_div(v, FX_ONE, fx_norm(v));
+}
+
+static inline fixed fx_absclip(fixed a, struct fx_limit lim)
+{
+	if (fx_abs(a) > lim.max)
+		a = (a < 0)? -lim.max : lim.max;
+	else if (fx_abs(a) < lim.min)
+		a = (a < 0)? -lim.min : lim.min;
+	return a;
+}
+
+/* true if 'v' is strictly inside the sector. Same as angle_in_range() */
+static bool fx_in_arc(struct fx_vector v, struct fx_arc arc)
+{
+	bool after_from = fx_wcross(arc.from, v) > 0;
+	bool before_to = fx_wcross(v, arc.to) > 0;
+
+	if (fx_wcross(arc.from, arc.to) >= 0)
+		return after_from && before_to;
+	else
+		return after_from || before_to;
+}
+
+/* ----------------------------- conversion ----------------------------- */
+
+static struct fx_vector fx_vector_from_float(struct r_vector v)
+{
+	return fx_make(fx_from_float(v.x), fx_from_float(v.y));
+}
+
+static struct r_vector fx_vector_to_float(struct fx_vector v)
+{
+	return r_make(fx_to_float(v.x), fx_to_float(v.y));
+}
+
+static struct fx_body fx_body_from_float(struct free_body b)
+{
+	struct fx_body fb;
+
+	fb.pos = fx_vector_from_float(b.pos);
+	fb.vel = fx_vector_from_float(b.vel);
+	fb.acc = fx_vector_from_float(b.acc);
+	fb.box = fx_vector_from_float(b.box);
+	fb.drag = fx_from_float(b.drag);
+
+	return fb;
+}
+
+struct fx_game fx_game_from_float(const struct game *g)
+{
+	struct fx_game fg;
+	int i;
+
+	for (i = 0; i < N_PLAYERS; i++)
+		fg.p[i] = fx_body_from_float(g->p[i].body);
+	fg.b = fx_body_from_float(g->b.body);
+
+	return fg;
+}
+
+/* Only the state is written back, the rest are parameters that the engine
+ * never changes */
+void fx_game_to_float(struct game *g, const struct fx_game *fg)
+{
+	int i;
+
+	for (i = 0; i < N_PLAYERS; i++) {
+		g->p[i].body.pos = fx_vector_to_float(fg->p[i].pos);
+		g->p[i].body.vel = fx_vector_to_float(fg->p[i].vel);
+	}
+	g->b.body.pos = fx_vector_to_float(fg->b.pos);
+	g->b.body.vel = fx_vector_to_float(fg->b.vel);
+}
+
+/* ------------------------------ physics ------------------------------- */
+
+struct fx_kinetic fx_kinetic_step(struct fx_body b)
+{
+	struct fx_kinetic new_k;
+
+	new_k.pos = fx_sum(b.pos, b.vel);
+	new_k.vel = fx_subs(fx_sum(b.vel, b.acc),
+			fx_scale(fx_scale(b.vel, fx_dot(b.vel, b.vel)), b.drag));
+
+	return new_k;
+}
+
+static struct fx_kinetic fx_oblique_collision(
+		struct fx_body b, struct fx_kinetic proposed,
+		struct fx_vector extra_vel, struct fx_vector normal,
+		fixed conservation, fixed v_transmission)
+{
+	struct fx_kinetic new_k;
+
+	if (fx_wdot(normal, fx_subs(proposed.vel, extra_vel)) < 0) {
+		struct fx_vector tangent = fx_normal(normal);
+
+		new_k.vel = fx_sum(fx_subs(proposed.vel,
+					fx_scale(normal, fx_mul(FX_ONE + conservation,
+						fx_dot(proposed.vel, normal)))),
+				fx_scale(normal, fx_mul(FX_ONE + v_transmission,
+						fx_dot(extra_vel, normal))));
+		new_k.pos = fx_sum(b.pos,
+				fx_sum(fx_scale(tangent, fx_dot(proposed.vel, tangent)),
+					fx_scale(normal, fx_dot(extra_vel, normal))));
+	} else {
+		new_k = proposed;
+	}
+
+	return new_k;
+}
+
+static struct fx_kinetic fx_original_collision(
+		struct fx_body b, struct fx_kinetic proposed, struct fx_body p,
+		int bouncicity)
+{
+	struct fx_kinetic new_k;
+	struct fx_vector p_center = fx_sum(p.pos, fx_make(p.box.x/2, p.box.y));
+	struct fx_vector b_center = fx_sum(proposed.pos,
+					fx_make(b.box.x/2, b.box.y/2));
+	struct fx_vector delta_p = fx_subs(b_center, p_center);
+	fixed dist = fx_norm(delta_p);
+
+	if (dist < (p.box.x + b.box.y/2) && delta_p.y < 0) {
+		struct fx_vector delta_v = fx_subs(proposed.vel, p.vel);
+		fixed bounce_coeff;
+
+		bounce_coeff = fx_wdiv((int64_t)delta_v.x * delta_p.x * BOUNCICITY_X
+				+ (int64_t)delta_v.y * delta_p.y, dist);
+		new_k.pos = fx_sum(p_center, fx_scale_div(delta_p,
+					p.box.x/2 + b.box.y/2, dist));
+		new_k.pos = fx_subs(new_k.pos, fx_make(b.box.x/2, b.box.y/2));
+		new_k.vel = proposed.vel;
+		if (bounce_coeff <= 0) {
+			struct fx_vector delta_p2 = delta_p;
+			delta_p2.x *= BOUNCICITY_X;
+			new_k.vel = fx_subs(fx_sum(new_k.vel, p.vel),
+				fx_scale_div(delta_p2, bouncicity*bounce_coeff, dist));
+			new_k.vel.x = fx_absclip(new_k.vel.x, FxVLimX);
+			new_k.vel.y = fx_absclip(new_k.vel.y, FxVLimY);
+		}
+	} else {
+		new_k = proposed;
+	}
+
+	return new_k;
+}
+
+static struct fx_kinetic fx_world_limit_collision(struct fx_body b,
+			struct fx_kinetic proposed, struct fx_limit limx,
+						struct fx_limit limy, int rebound)
+{
+	struct fx_kinetic new_k;
+	struct fx_vector normal = {0, 0};
+
+	if ((proposed.pos.x + b.box.x) > limx.max) {
+		normal.x += -FX_ONE;
+	} else if (proposed.pos.x < limx.min) {
+		normal.x += FX_ONE;
+	}
+
+	if ((proposed.pos.y + b.box.y) > limy.max)  {
+		normal.y += -FX_ONE;
+	} else if (proposed.pos.y < limy.min) {
+		normal.y += FX_ONE;
+	}
+
+	new_k = proposed;
+	if (normal.x)
+		new_k = fx_oblique_collision(b, new_k, fx_zero,
+				fx_make(normal.x, 0),
+				rebound? FX_CONSERVATION_WALL : 0, 0);
+	if (normal.y)
+		new_k = fx_oblique_collision(b, new_k, fx_zero,
+				fx_make(0, normal.y),
+				rebound? FX_CONSERVATION_WALL : 0, 0);
+
+	return new_k;
+}
+
+static struct fx_kinetic fx_ball_edge_collision(
+		struct fx_body b, struct fx_kinetic proposed,
+		struct fx_kinetic edge, struct fx_arc edgearc,
+		fixed conservation, fixed v_transmission)
+{
+	struct fx_vector b_center;
+	struct fx_vector incidence;
+	fixed radius = b.box.y/2;
+	struct fx_kinetic new_k;
+
+	b_center = fx_make(proposed.pos.x + b.box.x/2,
+					proposed.pos.y + b.box.y/2);
+	incidence = fx_subs(b_center, edge.pos);
+
+	if (fx_wdot(incidence, incidence) < (int64_t)radius * radius
+			&& !fx_in_arc(incidence, edgearc)) {
+		/* atan2(0, 0) is 0, the float engine would use (1, 0) */
+		struct fx_vector normal = (incidence.x || incidence.y)?
+				fx_unit(incidence) : fx_make(FX_ONE, 0);
+		new_k = fx_oblique_collision(b, proposed, edge.vel, normal,
+					conservation, v_transmission);
+	} else {
+		new_k = proposed;
+	}
+
+	return new_k;
+}
+
+/* Same as point_segment_near(), but instead of rotating the points we
+ * project them on the segment and on its normal. */
+static bool fx_point_segment_near(struct fx_vector p, struct fx_vector v1,
+					struct fx_vector v2, fixed h)
+{
+	struct fx_vector hyp = fx_subs(v1, v2);
+	int64_t height = fx_wcross(hyp, fx_subs(p, v2));
+
+	return fx_wdot(hyp, fx_subs(p, v1)) < 0 && fx_wdot(hyp, fx_subs(p, v2)) > 0
+		&& height >= 0 && height <= (int64_t)h * fx_norm(hyp);
+}
+
+struct fx_kinetic fx_ball_poly_collision(struct fx_body b,
+		struct fx_kinetic proposed, const struct fx_vector *edges,
+		int n_edges, struct fx_vector extra_vel, fixed conservation,
+		fixed v_transmission)
+{
+	struct fx_kinetic new_k;
+	int i;
+
+	new_k = proposed;
+	for (i = 0; i < n_edges; i++) {
+		int i_next;
+
+		i_next = (i + 1)%n_edges;
+		if (fx_point_segment_near(fx_sum(proposed.pos,
+					fx_make(b.box.x/2, b.box.y/2)),
+				edges[i], edges[i_next], b.box.y/2)) {
+			struct fx_vector normal = fx_unit(fx_normal(
+					fx_subs(edges[i], edges[i_next])));
+			new_k = fx_oblique_collision(b, new_k, extra_vel, normal,
+					conservation, v_transmission);
+		} else {
+			int i_prev = (i == 0)? n_edges - 1 : i - 1;
+			struct fx_arc arc;
+			struct fx_kinetic edge;
+
+			edge.pos = edges[i];
+			edge.vel = extra_vel;
+			arc.from = fx_subs(edges[i], edges[i_prev]);
+			arc.to = fx_subs(edges[i_next], edges[i]);
+
+			new_k = fx_ball_edge_collision(b, new_k, edge,
+					arc, conservation, v_transmission);
+		}
+	}
+
+	return new_k;
+}
+
+struct fx_kinetic fx_ball_player_collision(struct fx_body b,
+				struct fx_kinetic k, struct fx_body p)
+{
+	struct fx_kinetic new_k;
+	struct fx_vector b_center;
+	struct fx_vector p_center;
+	struct fx_vector incidence;
+	fixed min_dist = b.box.y/2 + p.box.y;
+
+	b_center = fx_make(k.pos.x + b.box.x/2, k.pos.y + b.box.y/2);
+	p_center = fx_make(p.pos.x + p.box.x/2, p.pos.y + p.box.y);
+
+	incidence = fx_subs(b_center, p_center);
+
+	/* incidence.titha in [-pi, 0] <=> incidence.y <= 0 */
+	if (fx_wdot(incidence, incidence) <= (int64_t)min_dist * min_dist
+						&& incidence.y <= 0) {
+		new_k = fx_original_collision(b, k, p, BOUNCICITY);
+	} else if (
+		fx_abs(b_center.y - (p.pos.y + p.box.y)) < b.box.y/2
+		&& b_center.x > p.pos.x
+		&& b_center.x < p.pos.x + p.box.x
+		) {
+		new_k = fx_original_collision(b, k, p, BOUNCICITY);
+	} else {
+		struct fx_kinetic edge;
+		/* incidence.titha < pi/2 */
+		bool right = !(incidence.x <= 0 && incidence.y >= 0
+					&& (incidence.x || incidence.y));
+
+		edge.vel = p.vel;
+		if (right) {
+			edge.pos = fx_sum(p.pos, p.box);
+		} else {
+			edge.pos = p.pos;
+			edge.pos.y += p.box.y;
+		}
+		new_k = fx_ball_edge_collision(b, k, edge,
+				right? PlayerRightArc : PlayerLeftArc,
+				FX_CONSERVATION, FX_TRANSMISSION);
+	}
+
+	return new_k;
+}
+
+/* Broad phase, the same as the one of cslime.c: a narrow phase test only
+ * changes the ball if its center comes within one radius of the surface, so
+ * it is skipped when the segment swept by the center stays BROAD_MARGIN
+ * further away from the bounding box of the surface. */
+#define FX_BROAD_MARGIN FX_C(BALL_R/8)
+
+struct fx_box {
+	struct fx_limit x, y;
+};
+
+static const struct fx_box FxWorldBox = {{FX_C(0), FX_C(GAME_AREA_W)},
+					{FX_C(0), FX_C(GAME_AREA_H)}};
+static const struct fx_box FxNetBox = {
+	{FX_C(PLAYER_AREA_W), FX_C(PLAYER_AREA_W + NET_W)},
+	{FX_C(PLAYER_AREA_H - NET_H), FX_C(PLAYER_AREA_H)}};
+
+static inline fixed fx_min(fixed a, fixed b)
+{
+	return (a < b)? a : b;
+}
+
+static inline fixed fx_max(fixed a, fixed b)
+{
+	return (a > b)? a : b;
+}
+
+static inline struct fx_box fx_swept_center(struct fx_body b,
+						struct fx_kinetic k)
+{
+	struct fx_box sw;
+	fixed r = b.box.y/2;
+
+	sw.x.min = fx_min(b.pos.x, k.pos.x) + r;
+	sw.x.max = fx_max(b.pos.x, k.pos.x) + r;
+	sw.y.min = fx_min(b.pos.y, k.pos.y) + r;
+	sw.y.max = fx_max(b.pos.y, k.pos.y) + r;
+
+	return sw;
+}
+
+/* true if 'sw' comes within 'reach' of the box */
+static inline bool fx_box_near(struct fx_box sw, struct fx_box b, fixed reach)
+{
+	return sw.x.max > b.x.min - reach && sw.x.min < b.x.max + reach
+		&& sw.y.max > b.y.min - reach && sw.y.min < b.y.max + reach;
+}
+
+/* true if 'sw' comes within 'reach' of the border of the box, from inside */
+static inline bool fx_box_border_near(struct fx_box sw, struct fx_box b,
+								fixed reach)
+{
+	return sw.x.min < b.x.min + reach || sw.x.max > b.x.max - reach
+		|| sw.y.min < b.y.min + reach || sw.y.max > b.y.max - reach;
+}
+
+static inline struct fx_box fx_body_box(struct fx_body b)
+{
+	struct fx_box bb;
+
+	bb.x.min = b.pos.x;
+	bb.x.max = b.pos.x + b.box.x;
+	bb.y.min = b.pos.y;
+	bb.y.max = b.pos.y + b.box.y;
+
+	return bb;
+}
+
+static struct fx_kinetic fx_ball_collisions(const struct fx_game *fg,
+						struct fx_kinetic kin)
+{
+	int i;
+	const fixed reach = fg->b.box.y/2 + FX_BROAD_MARGIN;
+
+	if (fx_box_border_near(fx_swept_center(fg->b, kin), FxWorldBox, reach))
+		kin = fx_ball_poly_collision(fg->b, kin, fx_world_poly,
+			ARSIZE(fx_world_poly), fx_zero, FX_CONSERVATION, 0);
+
+	for (i = 0; i < N_PLAYERS; i++) {
+		if (fx_box_near(fx_swept_center(fg->b, kin),
+					fx_body_box(fg->p[i]), reach))
+			kin = fx_ball_player_collision(fg->b, kin, fg->p[i]);
+	}
+
+	if (fx_box_near(fx_swept_center(fg->b, kin), FxNetBox, reach))
+		kin = fx_ball_poly_collision(fg->b, kin, fx_net_poly,
+			ARSIZE(fx_net_poly), fx_zero, FX_CONSERVATION, 0);
+	if (fx_box_border_near(fx_swept_center(fg->b, kin), FxWorldBox, reach))
+		kin = fx_ball_poly_collision(fg->b, kin, fx_world_poly,
+			ARSIZE(fx_world_poly), fx_zero, FX_CONSERVATION, 0);
+
+	return kin;
+}
+
+static inline void fx_apply_kinetic(struct fx_body *b, struct fx_kinetic k)
+{
+	b->pos = k.pos;
+	b->vel = k.vel;
+}
+
+static void fx_apply_player_comm(struct fx_body *p, struct pcontrol pcomm)
+{
+	if (pcomm.u && p->vel.y == 0)
+		p->vel.y = -FX_C(AVATAR_VY);
+
+	if (pcomm.l && !pcomm.r)
+		p->vel.x = -FX_C(AVATAR_VX);
+	else if (!pcomm.l && pcomm.r)
+		p->vel.x = FX_C(AVATAR_VX);
+	else
+		p->vel.x = 0;
+}
+
+/* Same as game_umpire(), the points are kept in 'g' */
+static struct game_result fx_game_umpire(struct game *g,
+						const struct fx_game *fg)
+{
+	struct game_result gr = {0};
+
+	if (fx_abs((fg->b.pos.y + fg->b.box.y) - FX_C(GAME_AREA_H))
+		< FX_C(FLOOR_HIT_TOL)) {
+		if ((fg->b.pos.x + fg->b.box.x/2) < FX_C(GAME_AREA_W/2)) {
+			g->p[0].points--;
+			g->p[1].points++;
+			gr.scorer_player = 1;
+			gr.has_to_start = 1;
+		} else {
+			g->p[1].points--;
+			g->p[0].points++;
+			gr.scorer_player = 0;
+			gr.has_to_start = 0;
+		}
+		gr.set_end = 1;
+		if (g->p[0].points == 0 || g->p[1].points == 0)
+			gr.game_end = 1;
+	}
+
+	return gr;
+}
+
+static void _run_game_fixed(struct fx_game *fg, struct commands comm)
+{
+	int i;
+	struct fx_kinetic kin;
+
+	for (i = 0; i < N_PLAYERS; i++) {
+		fx_apply_player_comm(fg->p + i, comm.player[i]);
+	}
+
+	for (i = 0; i < N_PLAYERS; i++) {
+		kin = fx_kinetic_step(fg->p[i]);
+		kin = fx_world_limit_collision(fg->p[i], kin, FxZoneLimX[i],
+							FxLimY, REBOUND_OFF);
+		fx_apply_kinetic(fg->p + i, kin);
+	}
+
+	kin = fx_kinetic_step(fg->b);
+	kin = fx_ball_collisions(fg, kin);
+
+	fx_apply_kinetic(&fg->b, kin);
+}
+
+struct game_result run_game_fixed(struct game *g, struct commands comm)
+{
+	int i;
+	struct game_result gr;
+	struct fx_game fg = fx_game_from_float(g);
+
+	for (i = 0; i < OVERSAMPLING; i++) {
+		_run_game_fixed(&fg, comm);
+		gr = fx_game_umpire(g, &fg);
+		if (gr.set_end) {
+			break;
+		}
+	}
+	fx_game_to_float(g, &fg);
+
+	return gr;
+}
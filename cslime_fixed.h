@@ -0,0 +1,92 @@
+/*
+ * cslime_fixed.h
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Fixed point version of the physics engine.
+ * Only integer arithmetic is used while simulating, so the trajectories are
+ * the same on every machine and with every compiler flag. The game is still
+ * stored in a 'struct game': run_game_fixed() converts it to fixed point,
+ * simulates one frame and converts it back. The conversions are exact
+ * functions of their input, so the float state is as reproducible as the
+ * fixed point one.
+ *
+ * Build with -DCSLIME_FIXED_POINT to make run_game() use this engine.
+ */
+
+#ifndef _CSLIME_FIXED_H_
+#define _CSLIME_FIXED_H_
+
+#include <stdint.h>
+#include "cslime.h"
+
+/* Q2.29: the court is less than one unit wide, but the gravity is around
+ * 5e-7 per substep, so we need a lot of fractional bits. */
+typedef int32_t fixed;
+#define FX_FRAC_BITS 29
+#define FX_ONE ((fixed)1 << FX_FRAC_BITS)
+
+/* Compile-time conversion, for constants */
+#define FX_C(f) ((fixed)((f) * (double)FX_ONE + (((f) < 0)? -.5 : .5)))
+
+struct fx_vector {
+	fixed x, y;
+};
+
+struct fx_limit {
+	fixed min, max;
+};
+
+struct fx_body {
+	struct fx_vector pos;
+	struct fx_vector vel, acc;
+	struct fx_vector box;
+	fixed drag;
+};
+
+struct fx_kinetic {
+	struct fx_vector pos, vel;
+};
+
+struct fx_game {
+	struct fx_body p[N_PLAYERS];
+	struct fx_body b;
+};
+
+fixed fx_from_float(float f);
+float fx_to_float(fixed a);
+
+struct fx_game fx_game_from_float(const struct game *g);
+void fx_game_to_float(struct game *g, const struct fx_game *fg);
+
+struct fx_kinetic fx_kinetic_step(struct fx_body b);
+struct fx_kinetic fx_ball_poly_collision(struct fx_body b,
+		struct fx_kinetic proposed, const struct fx_vector *edges,
+		int n_edges, struct fx_vector extra_vel, fixed conservation,
+		fixed v_transmission);
+struct fx_kinetic fx_ball_player_collision(struct fx_body b,
+				struct fx_kinetic k, struct fx_body p);
+
+struct game_result run_game_fixed(struct game *g, struct commands comm);
+	/* Same as run_game(), but using fixed point arithmetic. */
+
+#endif /* _CSLIME_FIXED_H_ */
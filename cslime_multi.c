@@ -0,0 +1,389 @@
+/*
+ * cslime_multi.c
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "common.h"
+#include "cslime.h"
+#include "cslime_phys.h"
+#include "cslime_multi.h"
+
+/* Extra reach of the broad phase, for the rounding errors */
+#define MULTI_MARGIN (BALL_R/8)
+/* A slime grown by the reach of a ball spans at most two cells in each
+ * direction, and two touching balls are in neighbouring cells. The cell is
+ * wider than that span by two more margins, so that the rounding of
+ * cell_x() cannot make it cover a third cell: slimes.items only has room
+ * for SLIME_CELLS per slime. */
+#define MULTI_CELL (AVATAR_W + 2*(BALL_R + 2*MULTI_MARGIN))
+#define SLIME_CELLS 4
+/* Building a grid costs about as much as a few dozen pair tests, so it is
+ * only used with more bodies than this (measured with cslime-bench) */
+#define MULTI_GRID_MIN 6
+
+enum {COURT_WORLD, COURT_NET, N_COURT};
+
+#ifdef CSLIME_STATS
+struct multi_stats MultiStats;
+#define COUNT_MULTI(field) (MultiStats.field++)
+#else
+#define COUNT_MULTI(field)
+#endif /* CSLIME_STATS */
+
+struct multi_game multi_game_create(int n_slimes, int n_balls,
+				const struct physics_params *pp, int *ret_code)
+{
+	struct multi_game mg = {0};
+	int n_cells, n_int, n_max;
+	int *k;
+
+	if (n_slimes < 1 || n_balls < 1) {
+		if (ret_code != NULL)
+			*ret_code = -E_BADARGS;
+		return mg;
+	}
+
+	mg.nx = ceilf(GAME_AREA_W / MULTI_CELL);
+	mg.ny = ceilf(GAME_AREA_H / MULTI_CELL);
+	n_cells = mg.nx * mg.ny;
+	n_max = (n_slimes > n_balls)? n_slimes : n_balls;
+	n_int = 2*(2*n_cells + 1) + SLIME_CELLS*n_slimes + 2*n_balls
+								+ 4*n_max;
+
+	mg.mem = calloc(1, N_COURT*sizeof(struct poly_geometry)
+				+ n_slimes*sizeof(struct player)
+				+ n_balls*sizeof(struct ball)
+				+ n_int*sizeof(int));
+	if (mg.mem == NULL) {
+		if (ret_code != NULL)
+			*ret_code = -E_NOMEM;
+		return mg;
+	}
+
+	mg.n_slimes = n_slimes;
+	mg.n_balls = n_balls;
+	mg.phys = pp;
+	mg.court = mg.mem;
+	mg.slime = (struct player*)(mg.court + N_COURT);
+	mg.ball = (struct ball*)(mg.slime + n_slimes);
+	k = (int*)(mg.ball + n_balls);
+	mg.slimes.start = k; k += n_cells + 1;
+	mg.slimes.cursor = k; k += n_cells;
+	mg.slimes.items = k; k += SLIME_CELLS*n_slimes;
+	mg.balls.start = k; k += n_cells + 1;
+	mg.balls.cursor = k; k += n_cells;
+	mg.balls.items = k; k += n_balls;
+	mg.near = k;
+
+	mg.court[COURT_WORLD] = poly_geometry_make(world_poly,
+							ARSIZE(world_poly));
+	mg.court[COURT_NET] = poly_geometry_make(net_poly, ARSIZE(net_poly));
+
+	multi_game_reset(&mg);
+
+	if (ret_code != NULL)
+		*ret_code = -E_OK;
+	return mg;
+}
+
+void multi_game_destroy(struct multi_game mg)
+{
+	free(mg.mem);
+}
+
+static void serve(struct multi_game *mg, int k, int side)
+{
+	struct free_body *b = &mg->ball[k].body;
+	float r = b->box.x/2;
+
+	/* the balls served together are spread around the middle of the side,
+	 * so that they do not start one on top of the other */
+	b->pos.x = (ZoneLimX[side].min + ZoneLimX[side].max)/2 - r
+						+ ((k % 7) - 3) * r;
+	b->pos.y = mg->phys->start_ball_y;
+	b->vel = r_make(0, 0);
+}
+
+void multi_game_reset(struct multi_game *mg)
+{
+	const struct body_class *pc = mg->phys->body_class + BODY_CLASS_PLAYER;
+	const struct body_class *bc = mg->phys->body_class + BODY_CLASS_BALL;
+	int i, side;
+
+	for (i = 0; i < mg->n_slimes; i++) {
+		struct free_body *b = &mg->slime[i].body;
+		int n_side = (mg->n_slimes + 1 - (i % 2)) / 2;
+		struct limit zone;
+
+		side = i % 2;
+		zone = ZoneLimX[side];
+		mg->slime[i] = def_player;
+		body_set_class(b, pc);
+		b->pos.x = zone.min + (zone.max - zone.min) * (i/2 + .5f)
+						/ n_side - b->box.x/2;
+		b->pos.y = LimY.max - b->box.y;
+		b->vel = r_make(0, 0);
+		mg->slime[i].on_fire = 0;
+		mg->slime[i].points = 0;
+	}
+	for (i = 0; i < mg->n_balls; i++) {
+		mg->ball[i] = def_ball;
+		body_set_class(&mg->ball[i].body, bc);
+		serve(mg, i, i % 2);
+	}
+	mg->points[0] = mg->points[1] = 0;
+}
+
+static inline int clampi(int v, int max)
+{
+	return (v < 0)? 0 : ((v > max)? max : v);
+}
+
+static inline int cell_x(const struct multi_game *mg, float x)
+{
+	return clampi(floorf(x / MULTI_CELL), mg->nx - 1);
+}
+
+static inline int cell_y(const struct multi_game *mg, float y)
+{
+	return clampi(floorf(y / MULTI_CELL), mg->ny - 1);
+}
+
+/* Counting sort of the items into the cells. Item i covers the cells
+ * [x0[i], x1[i]] x [y0[i], y1[i]]; within a cell the items stay in order. */
+static void grid_build(struct multi_grid *gr, const struct multi_game *mg,
+			int n, int (*range)[4])
+{
+	int n_cells = mg->nx * mg->ny;
+	int c, i, x, y;
+
+	for (c = 0; c <= n_cells; c++)
+		gr->start[c] = 0;
+	for (i = 0; i < n; i++)
+		for (y = range[i][2]; y <= range[i][3]; y++)
+			for (x = range[i][0]; x <= range[i][1]; x++)
+				gr->start[y*mg->nx + x + 1]++;
+	for (c = 0; c < n_cells; c++) {
+		gr->start[c + 1] += gr->start[c];
+		gr->cursor[c] = gr->start[c];
+	}
+	for (i = 0; i < n; i++)
+		for (y = range[i][2]; y <= range[i][3]; y++)
+			for (x = range[i][0]; x <= range[i][1]; x++)
+				gr->items[gr->cursor[y*mg->nx + x]++] = i;
+}
+
+static bool near_court(struct r_vector c, float reach)
+{
+	return c.x < reach || c.x > GAME_AREA_W - reach
+		|| c.y < reach || c.y > GAME_AREA_H - reach;
+}
+
+static bool near_net(struct r_vector c, float reach)
+{
+	return c.x > PLAYER_AREA_W - reach && c.x < PLAYER_AREA_W + NET_W + reach
+		&& c.y > PLAYER_AREA_H - NET_H - reach;
+}
+
+static struct kinetic court_collision(const struct multi_game *mg,
+		const struct ball *b, struct kinetic kin, int which)
+{
+	float r = b->body.box.y/2;
+	struct r_vector c = r_make(kin.pos.x + r, kin.pos.y + r);
+	float reach = r + r_abs(kin.vel) + MULTI_MARGIN;
+
+	if ((which == COURT_WORLD)? near_court(c, reach) : near_net(c, reach))
+		kin = ball_poly_collision_geom_notrig(*b, kin, mg->court + which,
+				r_make(0, 0), mg->phys->conservation, 0);
+
+	return kin;
+}
+
+static void ball_ball_collision(struct free_body *a, struct free_body *b,
+							float conservation)
+{
+	float ra = a->box.x/2, rb = b->box.x/2;
+	struct r_vector d = r_subs(r_sum(b->pos, r_make(rb, rb)),
+					r_sum(a->pos, r_make(ra, ra)));
+	float min_dist = ra + rb;
+	float dist2 = r_abs2(d), dist, dv;
+	struct r_vector n;
+
+	COUNT_MULTI(ball_ball_tests);
+	if (dist2 >= min_dist*min_dist || dist2 == 0)
+		return;
+
+	dist = sqrtf(dist2);
+	n = r_scale(d, 1/dist);
+	dv = r_dot(r_subs(a->vel, b->vel), n);
+	if (dv > 0) {
+		/* approaching: equal masses exchange the normal speed */
+		struct r_vector j = r_scale(n, (1 + conservation)/2 * dv);
+
+		a->vel = r_subs(a->vel, j);
+		b->vel = r_sum(b->vel, j);
+	}
+	/* and get out of each other */
+	a->pos = r_subs(a->pos, r_scale(n, (min_dist - dist)/2));
+	b->pos = r_sum(b->pos, r_scale(n, (min_dist - dist)/2));
+}
+
+static void sort_ints(int *v, int n)
+{
+	int i, j;
+
+	for (i = 1; i < n; i++) {
+		int x = v[i];
+
+		for (j = i; j > 0 && v[j - 1] > x; j--)
+			v[j] = v[j - 1];
+		v[j] = x;
+	}
+}
+
+static void balls_step(struct multi_game *mg, int (*range)[4])
+{
+	const float reach = BALL_R + MULTI_MARGIN;
+	bool all_pairs = mg->all_pairs || mg->n_slimes <= MULTI_GRID_MIN;
+	int i, k;
+
+	/* a slime is listed in every cell it can be touched from */
+	for (i = 0; !all_pairs && i < mg->n_slimes; i++) {
+		const struct free_body *p = &mg->slime[i].body;
+
+		range[i][0] = cell_x(mg, p->pos.x - reach);
+		range[i][1] = cell_x(mg, p->pos.x + p->box.x + reach);
+		range[i][2] = cell_y(mg, p->pos.y - reach);
+		range[i][3] = cell_y(mg, p->pos.y + p->box.y + reach);
+	}
+	if (!all_pairs)
+		grid_build(&mg->slimes, mg, mg->n_slimes, range);
+
+	for (k = 0; k < mg->n_balls; k++) {
+		struct ball *b = mg->ball + k;
+		float r = b->body.box.y/2;
+		struct kinetic kin = kinetic_step(b->body);
+
+		kin = court_collision(mg, b, kin, COURT_WORLD);
+		if (all_pairs) {
+			for (i = 0; i < mg->n_slimes; i++) {
+				COUNT_MULTI(ball_slime_tests);
+				kin = ball_player_collision_notrig_p(b, &kin,
+						mg->slime + i, mg->phys);
+			}
+		} else {
+			int c = cell_y(mg, kin.pos.y + r)*mg->nx
+						+ cell_x(mg, kin.pos.x + r);
+
+			for (i = mg->slimes.start[c]; i < mg->slimes.start[c + 1];
+									i++) {
+				COUNT_MULTI(ball_slime_tests);
+				kin = ball_player_collision_notrig_p(b, &kin,
+					mg->slime + mg->slimes.items[i],
+					mg->phys);
+			}
+		}
+		kin = court_collision(mg, b, kin, COURT_NET);
+		kin = court_collision(mg, b, kin, COURT_WORLD);
+
+		b->body.pos = kin.pos;
+		b->body.vel = kin.vel;
+	}
+}
+
+/* Contacts between balls, each pair in increasing order of the indices */
+static void balls_contacts(struct multi_game *mg, int (*range)[4])
+{
+	int i, j;
+
+	if (mg->all_pairs || mg->n_balls <= MULTI_GRID_MIN) {
+		for (i = 0; i < mg->n_balls; i++)
+			for (j = i + 1; j < mg->n_balls; j++)
+				ball_ball_collision(&mg->ball[i].body,
+					&mg->ball[j].body, mg->phys->conservation);
+		return;
+	}
+
+	for (i = 0; i < mg->n_balls; i++) {
+		const struct free_body *b = &mg->ball[i].body;
+
+		range[i][0] = range[i][1] = cell_x(mg, b->pos.x + b->box.x/2);
+		range[i][2] = range[i][3] = cell_y(mg, b->pos.y + b->box.y/2);
+	}
+	grid_build(&mg->balls, mg, mg->n_balls, range);
+
+	for (i = 0; i < mg->n_balls; i++) {
+		int cx = range[i][0], cy = range[i][2];
+		int x, y, n = 0;
+
+		for (y = cy - 1; y <= cy + 1; y++) {
+			for (x = cx - 1; x <= cx + 1; x++) {
+				int c = y*mg->nx + x, m;
+
+				if (x < 0 || x >= mg->nx || y < 0 || y >= mg->ny)
+					continue;
+				for (m = mg->balls.start[c];
+						m < mg->balls.start[c + 1]; m++) {
+					if (mg->balls.items[m] > i)
+						mg->near[n++] = mg->balls.items[m];
+				}
+			}
+		}
+		sort_ints(mg->near, n);
+		for (j = 0; j < n; j++)
+			ball_ball_collision(&mg->ball[i].body,
+				&mg->ball[mg->near[j]].body, mg->phys->conservation);
+	}
+}
+
+int run_multi_game(struct multi_game *mg, const struct pcontrol *comm)
+{
+	/* cells covered by the slimes, and then by the balls */
+	int (*range)[4] = (int (*)[4])(mg->near + mg->n_balls);
+	int s, i, k, scored = 0;
+
+	for (s = 0; s < mg->phys->oversampling; s++) {
+		for (i = 0; i < mg->n_slimes; i++)
+			player_step(mg->slime + i, comm + i, ZoneLimX[i % 2],
+								mg->phys);
+		balls_step(mg, range);
+		balls_contacts(mg, range);
+
+		for (k = 0; k < mg->n_balls; k++) {
+			const struct free_body *b = &mg->ball[k].body;
+
+			if (fabsf((b->pos.y + b->box.y) - GAME_AREA_H)
+					< mg->phys->floor_hit_tol) {
+				int side = (b->pos.x + b->box.x/2
+						< GAME_AREA_W/2)? 1 : 0;
+
+				mg->points[side]++;
+				scored++;
+				serve(mg, k, side);
+			}
+		}
+	}
+
+	return scored;
+}
@@ -0,0 +1,93 @@
+/*
+ * cslime_multi.h
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Engine for drills with any number of slimes and balls on one court.
+ * Slime i plays on the left side if i is even and on the right side if it is
+ * odd; the slimes of a side go through each other. The balls bounce on the
+ * court, the net, the slimes and on each other (equal masses). A ball that
+ * touches the floor gives a point to the other side and is served again from
+ * above the side that scored. There are no sets, the points just add up.
+ *
+ * The slimes and the balls are put in a uniform grid over the court every
+ * substep, with cells large enough that a ball can only touch the slimes
+ * listed in the cell of its center, and the balls in the 3x3 cells around
+ * it. The cost of a substep is then linear in the number of bodies, plus the
+ * contacts. With a handful of bodies building the grid costs more than it
+ * saves and every pair is tested. Setting 'all_pairs' makes the engine
+ * always test every pair, with the same results; it is there to measure the
+ * grid.
+ */
+
+#ifndef _CSLIME_MULTI_H_
+#define _CSLIME_MULTI_H_
+
+#include "cslime.h"
+
+struct multi_grid {
+	int *start;	/* items of cell c are items[start[c]..start[c+1]-1] */
+	int *cursor;
+	int *items;
+};
+
+struct multi_game {
+	int n_slimes, n_balls;
+	struct player *slime;
+	struct ball *ball;
+	int points[2];
+	const struct physics_params *phys;
+	bool all_pairs;
+
+	/* scratch space used by run_multi_game */
+	int nx, ny;
+	struct multi_grid slimes, balls;
+	int *near;
+	struct poly_geometry *court;	/* the world and the net */
+
+	void *mem;
+};
+
+#define multi_game_valid(mg) ((mg).mem != NULL)
+
+/* Counters, only updated when built with -DCSLIME_STATS */
+struct multi_stats {
+	unsigned long ball_slime_tests;
+	unsigned long ball_ball_tests;
+};
+
+#ifdef CSLIME_STATS
+extern struct multi_stats MultiStats;
+#endif
+
+struct multi_game multi_game_create(int n_slimes, int n_balls,
+				const struct physics_params *pp, int *ret_code);
+	/* Returns -E_BADARGS if there are no slimes or no balls */
+void multi_game_destroy(struct multi_game mg);
+void multi_game_reset(struct multi_game *mg);
+	/* Slimes spread over their sides, balls waiting to fall, no points */
+
+int run_multi_game(struct multi_game *mg, const struct pcontrol *comm);
+	/* Advance one frame, comm[i] being the commands of slime i. Returns
+	 * the number of points scored in the frame. */
+
+#endif /* _CSLIME_MULTI_H_ */
@@ -0,0 +1,156 @@
+/*
+ * cslime_phys.h
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Internals of the physics engine (cslime.c).
+ * This is meant to be used by the alternative steppers and the tools, not by
+ * the front-ends, which should stick to cslime.h.
+ */
+
+#ifndef _CSLIME_PHYS_H_
+#define _CSLIME_PHYS_H_
+
+#include "cslime.h"
+
+#define CONSERVATION 1
+#define CONSERVATION_WALL .9
+#define TRANSMISSION_DOWN -0.3
+#define TRANSMISSION -0.3
+
+enum {REBOUND_OFF, REBOUND_ON};
+
+struct kinetic {
+	struct r_vector pos, vel;
+};
+
+extern const struct player def_player;
+extern const struct ball def_ball;
+
+static inline void body_set_class(struct free_body *b,
+					const struct body_class *c)
+{
+	b->acc = c->acc;
+	b->box = c->box;
+	b->mass = c->mass;
+	b->drag = c->drag;
+}
+
+extern const struct limit ZoneLimX[N_PLAYERS];
+extern const struct limit LimX;
+extern const struct limit LimY;
+
+/* Counters of the broad phase, only updated when built with -DCSLIME_STATS.
+ * 'tested' counts the calls to the broad phase for each kind of surface and
+ * 'skipped' how many of those did not need a narrow phase test. */
+enum {NARROW_WORLD, NARROW_PLAYER, NARROW_NET, N_NARROW_TESTS};
+
+struct narrow_stats {
+	unsigned long substeps;
+	unsigned long tested[N_NARROW_TESTS];
+	unsigned long skipped[N_NARROW_TESTS];
+};
+
+#ifdef CSLIME_STATS
+extern struct narrow_stats NarrowStats;
+#endif
+
+struct kinetic kinetic_step(struct free_body b);
+struct kinetic original_collision(struct free_body b, struct kinetic proposed,
+		struct free_body p, const struct physics_params *phys);
+struct kinetic ball_poly_collision(struct ball b, struct kinetic proposed,
+		const struct r_vector *edges, int n_edges, struct r_vector extra_vel,
+		float conservation, float v_transmission);
+struct kinetic ball_player_collision(struct ball b, struct kinetic k,
+			struct player p, const struct physics_params *phys);
+struct kinetic ball_poly_collision_notrig(struct ball b,
+		struct kinetic proposed, const struct r_vector *edges,
+		int n_edges, struct r_vector extra_vel, float conservation,
+		float v_transmission);
+struct kinetic ball_player_collision_notrig(struct ball b, struct kinetic k,
+			struct player p, const struct physics_params *phys);
+struct kinetic ball_collisions(const struct game *g, struct kinetic kin);
+
+/* The same collisions, taking the bodies by reference. The by value versions
+ * above are wrappers of these. */
+struct kinetic ball_poly_collision_p(const struct ball *b,
+		const struct kinetic *proposed, const struct r_vector *edges,
+		int n_edges, struct r_vector extra_vel, float conservation,
+		float v_transmission);
+struct kinetic ball_player_collision_p(const struct ball *b,
+		const struct kinetic *k, const struct player *p,
+		const struct physics_params *phys);
+struct kinetic ball_poly_collision_notrig_p(const struct ball *b,
+		const struct kinetic *proposed, const struct r_vector *edges,
+		int n_edges, struct r_vector extra_vel, float conservation,
+		float v_transmission);
+struct kinetic ball_player_collision_notrig_p(const struct ball *b,
+		const struct kinetic *k, const struct player *p,
+		const struct physics_params *phys);
+
+/* A polygon with everything that the collision tests need from it computed
+ * in advance: for each edge (from vertex i to vertex i+1) its unit normal,
+ * its length, the rotation that makes it parallel to the x axis and its
+ * rotated ends, and the sector of directions from vertex i that is inside the
+ * polygon, as angles and as vectors. The engine uses it for world_poly and
+ * net_poly; the results are the same as with ball_poly_collision(). */
+#define POLY_MAX_EDGES 8
+
+struct poly_edge {
+	struct r_vector v, normal;
+	float len, cos_a, sin_a;
+	struct r_vector w1, w2;
+	struct limit angles;
+	struct r_vector from, to;
+};
+
+struct poly_geometry {
+	int n;	/* 0 if the polygon had too many edges */
+	struct poly_edge e[POLY_MAX_EDGES];
+};
+
+struct poly_geometry poly_geometry_make(const struct r_vector *edges,
+							int n_edges);
+struct kinetic ball_poly_collision_geom(struct ball b, struct kinetic proposed,
+		const struct poly_geometry *pg, struct r_vector extra_vel,
+		float conservation, float v_transmission);
+struct kinetic ball_poly_collision_geom_notrig(struct ball b,
+		struct kinetic proposed, const struct poly_geometry *pg,
+		struct r_vector extra_vel, float conservation,
+		float v_transmission);
+struct game_result game_umpire(struct game *g);
+
+/* The two halves of a substep: players_step() applies the commands and moves
+ * the players, ball_step() moves the ball and resolves its collisions. */
+void players_step(struct game *g, struct commands comm);
+void ball_step(struct game *g);
+
+/* players_step() for a single player, kept inside 'zone' */
+void player_step(struct player *p, const struct pcontrol *pcomm,
+		struct limit zone, const struct physics_params *phys);
+
+/* run_game() with each of the collision paths, no matter which one was
+ * selected at build time */
+struct game_result run_game_polar(struct game *g, struct commands comm);
+struct game_result run_game_notrig(struct game *g, struct commands comm);
+
+#endif /* _CSLIME_PHYS_H_ */
@@ -0,0 +1,555 @@
+/*
+ * cslime_rec.c
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "cslime.h"
+#include "cslime_snap.h"
+#include "cslime_rec.h"
+
+/* Shortest run of equal commands worth trying to fast-forward */
+#define REPLAY_FF_MIN 4
+/* Initial size of the index of the writer */
+#define REPLAY_MIN_KEYS 64
+
+static inline unsigned char *_put32(unsigned char *buf, uint32_t w)
+{
+	buf[0] = w;
+	buf[1] = w >> 8;
+	buf[2] = w >> 16;
+	buf[3] = w >> 24;
+
+	return buf + 4;
+}
+
+static inline const unsigned char *_get32(const unsigned char *buf,
+								uint32_t *w)
+{
+	*w = buf[0] | (uint32_t)buf[1] << 8 | (uint32_t)buf[2] << 16
+						| (uint32_t)buf[3] << 24;
+	return buf + 4;
+}
+
+uint16_t replay_encode_commands(const struct commands *comm)
+{
+	uint16_t w = 0;
+	int i;
+
+	for (i = 0; i < N_PLAYERS; i++) {
+		const struct pcontrol *pc = comm->player + i;
+
+		w |= ((pc->u != 0) | (pc->d != 0) << 1 | (pc->l != 0) << 2
+			| (pc->r != 0) << 3 | (pc->aux != 0) << 4) << (5*i);
+	}
+	w |= (comm->aux != 0) << 10;
+
+	return w;
+}
+
+void replay_decode_commands(uint16_t w, struct commands *comm)
+{
+	int i;
+
+	for (i = 0; i < N_PLAYERS; i++) {
+		struct pcontrol *pc = comm->player + i;
+		int b = w >> (5*i);
+
+		pc->u = b & 1;
+		pc->d = (b >> 1) & 1;
+		pc->l = (b >> 2) & 1;
+		pc->r = (b >> 3) & 1;
+		pc->aux = (b >> 4) & 1;
+	}
+	comm->aux = (w >> 10) & 1;
+}
+
+void replay_next_set(struct game *g, struct game_result gr, uint16_t w,
+							int start_points)
+{
+	if (w & REPLAY_NEW_GAME)
+		*g = game_init(start_points, (w >> REPLAY_TURN_SHIFT) & 1);
+	else if (gr.set_end && !gr.game_end)
+		game_reset(g, gr.has_to_start);
+}
+
+static bool _same_state(const struct game *g, const struct game_snapshot *s)
+{
+	struct game_snapshot gs;
+	unsigned char a[SNAPSHOT_ENCODED_SIZE], b[SNAPSHOT_ENCODED_SIZE];
+
+	game_snapshot(g, &gs);
+	game_snapshot_encode(&gs, a);
+	game_snapshot_encode(s, b);
+
+	return !memcmp(a, b, sizeof(a));
+}
+
+/* Writer */
+
+static void _writer_flush(struct replay_writer *w)
+{
+	if (w->used > 0 && w->code == -E_OK
+	    && fwrite(w->buf, w->used, 1, w->f) != 1)
+		w->code = -E_OTHER;
+	w->offset += w->used;
+	w->used = 0;
+}
+
+/* Append the state 'g' to the buffer and its offset to the index */
+static void _write_state(struct replay_writer *w, const struct game *g)
+{
+	struct game_snapshot s;
+
+	if (w->index == NULL)
+		return;
+	if (w->n_keys == w->max_keys) {
+		uint64_t *index = realloc(w->index,
+					2*w->max_keys*sizeof(*index));
+
+		if (index != NULL) {
+			w->index = index;
+			w->max_keys *= 2;
+		} else if (w->code == -E_OK) {
+			w->code = -E_NOMEM;
+		}
+	}
+	if (w->n_keys < w->max_keys)
+		w->index[w->n_keys++] = w->offset + w->used;
+
+	game_snapshot(g, &s);
+	game_snapshot_encode(&s, w->buf + w->used);
+	w->used += SNAPSHOT_ENCODED_SIZE;
+}
+
+int replay_writer_open(struct replay_writer *w, FILE *f, uint32_t seed,
+				int start_points, const struct game *g)
+{
+	unsigned char *p = w->buf;
+
+	w->f = f;
+	w->frames = 0;
+	w->used = 0;
+	w->offset = 0;
+	w->n_keys = 0;
+	w->max_keys = 0;
+	w->index = NULL;
+	w->code = -E_OK;
+	if (g->phys != &PhysicsDefault) {
+		w->code = -E_BADARGS;
+		return w->code;
+	}
+	if (NMALLOC(w->index, REPLAY_MIN_KEYS) == NULL) {
+		w->code = -E_NOMEM;
+		return w->code;
+	}
+	w->max_keys = REPLAY_MIN_KEYS;
+
+	memcpy(p, REPLAY_MAGIC, 4);
+	p = _put32(p + 4, seed);
+	p = _put32(p, start_points);
+	_put32(p, REPLAY_KEY_INTERVAL);
+	w->used = REPLAY_HEADER_SIZE - SNAPSHOT_ENCODED_SIZE;
+	_write_state(w, g);
+	_writer_flush(w);
+
+	return w->code;
+}
+
+void replay_write_frame(struct replay_writer *w, const struct commands *comm,
+				int new_game_turn, const struct game *g)
+{
+	uint16_t word = replay_encode_commands(comm);
+
+	/* the writer could not be opened */
+	if (w->index == NULL)
+		return;
+	if (new_game_turn >= 0)
+		word |= REPLAY_NEW_GAME | (new_game_turn << REPLAY_TURN_SHIFT);
+	if (w->used + 2 > REPLAY_BUF)
+		_writer_flush(w);
+	w->buf[w->used++] = word;
+	w->buf[w->used++] = word >> 8;
+
+	if (++w->frames % REPLAY_KEY_INTERVAL == 0) {
+		if (w->used + 2 + SNAPSHOT_ENCODED_SIZE > REPLAY_BUF)
+			_writer_flush(w);
+		w->buf[w->used++] = REPLAY_KEY & 0xFF;
+		w->buf[w->used++] = REPLAY_KEY >> 8;
+		_write_state(w, g);
+	}
+}
+
+int replay_writer_close(struct replay_writer *w, const struct game *g)
+{
+	struct game_snapshot s;
+	unsigned char *p;
+	long i;
+
+	if (w->index == NULL)
+		return w->code;
+
+	if (w->used + 6 + SNAPSHOT_ENCODED_SIZE > REPLAY_BUF)
+		_writer_flush(w);
+	p = w->buf + w->used;
+	p[0] = REPLAY_END & 0xFF;
+	p[1] = REPLAY_END >> 8;
+	p = _put32(p + 2, w->frames);
+	game_snapshot(g, &s);
+	game_snapshot_encode(&s, p);
+	w->used += 6 + SNAPSHOT_ENCODED_SIZE;
+
+	for (i = 0; i < w->n_keys; i++) {
+		if (w->used + 8 > REPLAY_BUF)
+			_writer_flush(w);
+		p = _put32(w->buf + w->used, w->index[i]);
+		_put32(p, w->index[i] >> 32);
+		w->used += 8;
+	}
+	if (w->used + REPLAY_TRAILER_SIZE > REPLAY_BUF)
+		_writer_flush(w);
+	p = _put32(w->buf + w->used, w->n_keys);
+	memcpy(p, REPLAY_INDEX_MAGIC, 4);
+	w->used += REPLAY_TRAILER_SIZE;
+
+	_writer_flush(w);
+	if (w->code == -E_OK && fflush(w->f) != 0)
+		w->code = -E_OTHER;
+	free(w->index);
+	w->index = NULL;
+
+	return w->code;
+}
+
+/* Reader */
+
+/* Make at least 'n' bytes available, if the file has them */
+static int _reader_fill(struct replay_reader *r, int n)
+{
+	if (r->used - r->pos >= n)
+		return 1;
+
+	memmove(r->buf, r->buf + r->pos, r->used - r->pos);
+	r->used -= r->pos;
+	r->pos = 0;
+	r->used += fread(r->buf + r->used, 1, REPLAY_BUF - r->used, r->f);
+
+	return r->used >= n;
+}
+
+int replay_reader_open(struct replay_reader *r, FILE *f)
+{
+	const unsigned char *p;
+	uint32_t w;
+
+	r->f = f;
+	r->pos = r->used = 0;
+	r->end_frames = 0;
+	if (!_reader_fill(r, REPLAY_HEADER_SIZE)
+	    || memcmp(r->buf, REPLAY_MAGIC, 4))
+		return -E_BADCFG;
+
+	p = _get32(r->buf + 4, &r->seed);
+	p = _get32(p, &w);
+	r->start_points = w;
+	p = _get32(p, &w);
+	r->key_interval = w;
+	r->pos = REPLAY_HEADER_SIZE;
+	if (r->key_interval < 1)
+		return -E_BADCFG;
+
+	return game_snapshot_decode(&r->start, p);
+}
+
+int replay_read_frame(struct replay_reader *r, uint16_t *w)
+{
+	const unsigned char *p;
+	uint32_t frames;
+
+	if (!_reader_fill(r, 2))
+		return -E_BADCFG;
+	p = r->buf + r->pos;
+	*w = p[0] | p[1] << 8;
+	if (!(*w & REPLAY_END)) {
+		r->pos += 2;
+		return 1;
+	}
+
+	if (*w == REPLAY_KEY) {
+		if (!_reader_fill(r, 2 + SNAPSHOT_ENCODED_SIZE))
+			return -E_BADCFG;
+		p = r->buf + r->pos + 2;
+		r->pos += 2 + SNAPSHOT_ENCODED_SIZE;
+		return (game_snapshot_decode(&r->key, p) < 0)? -E_BADCFG : 2;
+	}
+	if (*w != REPLAY_END
+	    || !_reader_fill(r, 6 + SNAPSHOT_ENCODED_SIZE))
+		return -E_BADCFG;
+	p = _get32(r->buf + r->pos + 2, &frames);
+	r->end_frames = frames;
+	r->pos += 6 + SNAPSHOT_ENCODED_SIZE;
+
+	return (game_snapshot_decode(&r->end, p) < 0)? -E_BADCFG : 0;
+}
+
+/* How many of the words already in the buffer are equal to 'w' */
+static int _run_length(const struct replay_reader *r, uint16_t w)
+{
+	const unsigned char *p = r->buf + r->pos;
+	const unsigned char *end = r->buf + r->used - 1;
+	int n = 0;
+
+	while (p < end && (p[0] | p[1] << 8) == w) {
+		p += 2;
+		n++;
+	}
+
+	return n;
+}
+
+int replay_play(struct replay_reader *r, struct game *g,
+					struct replay_stats *st)
+{
+	struct replay_stats zero = {0};
+	uint16_t w;
+	int code;
+
+	*st = zero;
+	st->first_diff = -1;
+	game_restore(g, &r->start);
+
+	while ((code = replay_read_frame(r, &w)) > 0) {
+		struct commands comm;
+
+		if (code == 2) {
+			st->keys++;
+			if (st->first_diff < 0 && !_same_state(g, &r->key))
+				st->first_diff = st->frames;
+			continue;
+		}
+		replay_decode_commands(w, &comm);
+
+		/* the current frame and the n equal ones after it */
+		if (!(w & REPLAY_NEW_GAME)) {
+			int n = _run_length(r, w), k;
+
+			if (n + 1 >= REPLAY_FF_MIN
+			    && (k = game_advance_until_event(g, comm,
+							n + 1)) > 0) {
+				r->pos += 2*(k - 1);
+				st->frames += k;
+				st->skipped += k;
+				continue;
+			}
+		}
+
+		{
+			struct game_result gr = run_game(g, comm);
+
+			st->frames++;
+			st->sets += gr.set_end;
+			st->games += gr.game_end;
+			replay_next_set(g, gr, w, r->start_points);
+		}
+	}
+
+	if (code == 0)
+		st->end_ok = st->frames == r->end_frames
+					&& _same_state(g, &r->end);
+
+	return code;
+}
+
+/* Memory map */
+
+static inline uint64_t _key_offset(const struct replay_map *m, long k)
+{
+	uint32_t lo, hi;
+
+	_get32(_get32(m->index + 8*k, &lo), &hi);
+	return (uint64_t)hi << 32 | lo;
+}
+
+/* The words of the frames after keyframe k */
+static inline const unsigned char *_key_words(const struct replay_map *m,
+									long k)
+{
+	return m->mem + _key_offset(m, k) + SNAPSHOT_ENCODED_SIZE;
+}
+
+int replay_map_open(struct replay_map *m, const char *path)
+{
+	struct stat st;
+	const unsigned char *trailer, *p;
+	void *mem;
+	uint32_t w;
+	long k;
+	int fd, code = -E_OTHER;
+
+	m->mem = NULL;
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		goto replay_map_open_end;
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		goto replay_map_open_end;
+	}
+	code = -E_BADCFG;
+	if (st.st_size < REPLAY_HEADER_SIZE + 6 + SNAPSHOT_ENCODED_SIZE
+						+ REPLAY_TRAILER_SIZE) {
+		close(fd);
+		goto replay_map_open_end;
+	}
+	mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mem == MAP_FAILED) {
+		code = -E_OTHER;
+		goto replay_map_open_end;
+	}
+	m->mem = mem;
+	m->size = st.st_size;
+
+	/* header */
+	if (memcmp(m->mem, REPLAY_MAGIC, 4))
+		goto replay_map_open_fail;
+	p = _get32(m->mem + 4, &m->seed);
+	p = _get32(p, &w);
+	m->start_points = w;
+	_get32(p, &w);
+	m->key_interval = w;
+
+	/* trailer, index and end mark, from the end of the file */
+	trailer = m->mem + m->size - REPLAY_TRAILER_SIZE;
+	_get32(trailer, &w);
+	m->n_keys = w;
+	if (memcmp(trailer + 4, REPLAY_INDEX_MAGIC, 4) || m->key_interval < 1
+	    || m->n_keys < 1 || m->n_keys > (m->size - REPLAY_HEADER_SIZE)/8)
+		goto replay_map_open_fail;
+	m->index = trailer - 8*m->n_keys;
+	p = m->index - (6 + SNAPSHOT_ENCODED_SIZE);
+	if (p < m->mem + REPLAY_HEADER_SIZE
+	    || (p[0] | p[1] << 8) != REPLAY_END)
+		goto replay_map_open_fail;
+	_get32(p + 2, &w);
+	m->frames = w;
+	if (game_snapshot_decode(&m->end, p + 6) < 0
+	    || m->n_keys != 1 + m->frames / m->key_interval)
+		goto replay_map_open_fail;
+
+	/* every keyframe must be followed by its words */
+	for (k = 0; k < m->n_keys; k++) {
+		long n = (k < m->n_keys - 1)? m->key_interval
+				: m->frames - k*m->key_interval;
+
+		if (_key_offset(m, k) < REPLAY_HEADER_SIZE - SNAPSHOT_ENCODED_SIZE
+		    || _key_offset(m, k) + SNAPSHOT_ENCODED_SIZE + 2*n
+					> (size_t)(m->index - m->mem))
+			goto replay_map_open_fail;
+	}
+
+	return -E_OK;
+
+replay_map_open_fail:
+	replay_map_close(m);
+replay_map_open_end:
+	return code;
+}
+
+void replay_map_close(struct replay_map *m)
+{
+	if (replay_map_valid(m))
+		munmap((void *)m->mem, m->size);
+	m->mem = NULL;
+}
+
+uint16_t replay_map_word(const struct replay_map *m, long frame)
+{
+	const unsigned char *p = _key_words(m, frame / m->key_interval)
+					+ 2*(frame % m->key_interval);
+
+	return p[0] | p[1] << 8;
+}
+
+struct game_result replay_map_step(const struct replay_map *m, long frame,
+							struct game *g)
+{
+	uint16_t w = replay_map_word(m, frame);
+	struct commands comm;
+	struct game_result gr;
+
+	replay_decode_commands(w, &comm);
+	gr = run_game(g, comm);
+	replay_next_set(g, gr, w, m->start_points);
+
+	return gr;
+}
+
+int replay_map_seek(const struct replay_map *m, long frame, struct game *g)
+{
+	struct game_snapshot s;
+	long k = frame / m->key_interval, f;
+
+	if (frame < 0 || frame > m->frames)
+		return -E_BADARGS;
+
+	if (game_snapshot_decode(&s, m->mem + _key_offset(m, k)) < 0)
+		return -E_BADCFG;
+	game_restore(g, &s);
+	for (f = k*m->key_interval; f < frame; f++)
+		replay_map_step(m, f, g);
+
+	return -E_OK;
+}
+
+int replay_map_check(const struct replay_map *m, long k,
+		struct game_snapshot *expected, struct game_snapshot *got)
+{
+	struct game g;
+	long f = k*m->key_interval, end;
+
+	if (game_snapshot_decode(got, m->mem + _key_offset(m, k)) < 0)
+		return -E_BADCFG;
+	if (k + 1 < m->n_keys) {
+		end = f + m->key_interval;
+		if (game_snapshot_decode(expected,
+				m->mem + _key_offset(m, k + 1)) < 0)
+			return -E_BADCFG;
+	} else {
+		end = m->frames;
+		*expected = m->end;
+	}
+
+	game_restore(&g, got);
+	for (; f < end; f++)
+		replay_map_step(m, f, &g);
+	game_snapshot(&g, got);
+
+	return _same_state(&g, expected);
+}
@@ -0,0 +1,191 @@
+/*
+ * cslime_rec.h
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Recording of matches.
+ * A replay is the start state and the commands of every frame, which is all
+ * that run_game() needs to play the match again. The file is:
+ *
+ * 	"CSR1", the seed, the start points and the frames between
+ * 	keyframes (32 bit little endian words)
+ * 	the start state, encoded as in cslime_snap.h
+ * 	one 16 bit little endian word per frame:
+ * 		bits 0-4	u, d, l, r, aux of player 0
+ * 		bits 5-9	the same for player 1
+ * 		bit 10		aux
+ * 		bit 11		a new game starts after this frame...
+ * 		bit 12		...and this player has the first turn
+ * 	after every key_interval frames (REPLAY_KEY_INTERVAL when written
+ * 	by replay_writer), a keyframe: REPLAY_KEY as a 16 bit word followed
+ * 	by the state after those frames
+ * 	the end mark, REPLAY_END as a 16 bit word, followed by the number of
+ * 	frames and the final state, to check the replay against
+ * 	the index: the offset of the state of each keyframe, as 64 bit words
+ * 	(two 32 bit ones, low first), the start state being the first one
+ * 	the number of keyframes and REPLAY_INDEX_MAGIC
+ *
+ * The keyframes let a reader start anywhere (see replay_map_seek()) and
+ * check the replay as it goes.
+ *
+ * After each frame the game is reset if a set ended, unless it was the end
+ * of the game: then a new game is started only if bit 11 is set. This is
+ * what the UI and the rollouts do. The seed is not needed to replay, it is
+ * kept to reproduce the random choices of the players.
+ * Only PhysicsDefault is supported.
+ */
+
+#ifndef _CSLIME_REC_H_
+#define _CSLIME_REC_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "cslime.h"
+#include "cslime_snap.h"
+
+#define REPLAY_MAGIC "CSR1"
+#define REPLAY_INDEX_MAGIC "CSRI"
+#define REPLAY_HEADER_SIZE (16 + SNAPSHOT_ENCODED_SIZE)
+#define REPLAY_TRAILER_SIZE 8
+#define REPLAY_KEY_INTERVAL 1024
+#define REPLAY_END 0x8000
+#define REPLAY_KEY 0x8001
+#define REPLAY_NEW_GAME (1 << 11)
+#define REPLAY_TURN_SHIFT 12
+#define REPLAY_BUF 4096
+
+uint16_t replay_encode_commands(const struct commands *comm);
+void replay_decode_commands(uint16_t w, struct commands *comm);
+
+void replay_next_set(struct game *g, struct game_result gr, uint16_t w,
+							int start_points);
+	/* After playing a frame recorded as 'w', which gave 'gr', start the
+	 * new game or the next set as the recording says */
+
+/* Streaming writer. The words are gathered in 'buf' and written with one
+ * fwrite() every REPLAY_BUF bytes. */
+struct replay_writer {
+	FILE *f;
+	long frames;
+	int code;	/* first error, -E_OK if none */
+	int used;
+	long offset;	/* of buf in the file */
+	uint64_t *index;
+	long n_keys, max_keys;
+	unsigned char buf[REPLAY_BUF];
+};
+
+int replay_writer_open(struct replay_writer *w, FILE *f, uint32_t seed,
+				int start_points, const struct game *g);
+	/* Write the header, 'g' is the start state. Returns -E_BADARGS if
+	 * the game does not use PhysicsDefault, -E_NOMEM, or -E_OTHER on I/O
+	 * errors. */
+void replay_write_frame(struct replay_writer *w, const struct commands *comm,
+				int new_game_turn, const struct game *g);
+	/* Record a frame played with 'comm'. new_game_turn is the first turn
+	 * of the new game started after it, or -1 if no game was started.
+	 * 'g' is the state after the frame and the new game or set, it is
+	 * only read when a keyframe is due. */
+int replay_writer_close(struct replay_writer *w, const struct game *g);
+	/* Write the end mark with the final state 'g' and the index, and
+	 * flush. Returns the first error of the whole recording. The file is
+	 * not closed. */
+
+struct replay_reader {
+	FILE *f;
+	uint32_t seed;
+	int start_points, key_interval;
+	struct game_snapshot start;
+
+	/* the last keyframe read */
+	struct game_snapshot key;
+
+	/* filled at the end mark */
+	long end_frames;
+	struct game_snapshot end;
+
+	int pos, used;
+	unsigned char buf[REPLAY_BUF];
+};
+
+int replay_reader_open(struct replay_reader *r, FILE *f);
+	/* Read the header. Returns -E_BADCFG if it is not a replay. */
+int replay_read_frame(struct replay_reader *r, uint16_t *w);
+	/* Returns 1 with the word of the next frame, 2 at a keyframe (the
+	 * state is in 'key'), 0 at the end mark (then end_frames and end are
+	 * filled) or -E_BADCFG if the file is cut. The index is not read. */
+
+struct replay_stats {
+	long frames, sets, games;
+	long skipped;	/* frames advanced by game_advance_until_event() */
+	long keys;	/* keyframes checked */
+	long first_diff; /* frames before the first keyframe that was not
+			  * matched, -1 if all were */
+	bool end_ok;	/* the final state is the recorded one */
+};
+
+int replay_play(struct replay_reader *r, struct game *g,
+					struct replay_stats *st);
+	/* Play the whole replay from its start state, leaving the final
+	 * state in 'g'. Runs of frames with the same commands go through
+	 * game_advance_until_event(), which gives the same result as
+	 * run_game(). Returns the error of replay_read_frame(), if any. */
+
+/* Random access to a whole replay file, mapped in memory. Nothing in it is
+ * modified after replay_map_open(), so any number of threads can seek and
+ * play in the same map, each with its own game. */
+struct replay_map {
+	const unsigned char *mem;
+	size_t size;
+	uint32_t seed;
+	int start_points, key_interval;
+	long frames, n_keys;
+	const unsigned char *index;
+	struct game_snapshot end;
+};
+
+#define replay_map_valid(m) ((m)->mem != NULL)
+
+int replay_map_open(struct replay_map *m, const char *path);
+	/* Returns -E_OTHER if the file cannot be mapped and -E_BADCFG if it
+	 * is not a replay with an index */
+void replay_map_close(struct replay_map *m);
+uint16_t replay_map_word(const struct replay_map *m, long frame);
+	/* The word of a frame, 0 <= frame < m->frames */
+int replay_map_seek(const struct replay_map *m, long frame, struct game *g);
+	/* Put in 'g' the state before 'frame' (0 <= frame <= m->frames),
+	 * starting from the keyframe before it and playing at most
+	 * key_interval - 1 frames. Returns -E_BADARGS if the frame is out of
+	 * range and -E_BADCFG if the keyframe is corrupt. */
+struct game_result replay_map_step(const struct replay_map *m, long frame,
+							struct game *g);
+	/* Play 'frame' and what follows it (replay_next_set()), 'g' being in
+	 * the state before it */
+int replay_map_check(const struct replay_map *m, long k,
+		struct game_snapshot *expected, struct game_snapshot *got);
+	/* Play from keyframe k (0 <= k < m->n_keys) up to the next one, or to
+	 * the end, and compare the state reached ('got') with the recorded
+	 * one ('expected'). Returns 1 if they are the same, 0 if not or
+	 * -E_BADCFG if a keyframe is corrupt. As every part starts from its
+	 * own keyframe, they can be checked in any order and in parallel. */
+
+#endif /* _CSLIME_REC_H_ */
@@ -0,0 +1,99 @@
+/*
+ * cslime_replay.c
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Replays recorded matches (see cslime_rec.h) at full speed and checks that
+ * they go through the recorded keyframes and end in the recorded state. */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <time.h>
+#include "common.h"
+#include "cslime.h"
+#include "cslime_rec.h"
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+	int i, code = -E_OK;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s replay ...\n", argv[0]);
+		return E_BADARGS;
+	}
+
+	for (i = 1; i < argc; i++) {
+		struct replay_reader r;
+		struct replay_stats st;
+		struct game g;
+		FILE *f = fopen(argv[i], "rb");
+		double t0, t;
+		int c;
+
+		if (f == NULL) {
+			fprintf(stderr, "cannot open %s\n", argv[i]);
+			code = -E_BADARGS;
+			continue;
+		}
+		if (replay_reader_open(&r, f) < 0) {
+			fprintf(stderr, "%s: not a replay\n", argv[i]);
+			fclose(f);
+			code = -E_BADCFG;
+			continue;
+		}
+
+		t0 = now();
+		c = replay_play(&r, &g, &st);
+		t = now() - t0;
+		fclose(f);
+
+		printf("%s: seed %u, %ld frames, %ld sets, %ld games, "
+			"%.0f frames/s (%.1f%% fast-forwarded), points %d-%d",
+			argv[i], r.seed, st.frames, st.sets, st.games,
+			st.frames / t, 100.0 * st.skipped / st.frames,
+			g.p[0].points, g.p[1].points);
+		if (c < 0) {
+			printf(", cut short\n");
+			code = c;
+		} else if (st.first_diff >= 0) {
+			printf(", DIFFERENT state at frame %ld\n",
+						st.first_diff);
+			code = -E_OTHER;
+		} else if (!st.end_ok) {
+			printf(", DIFFERENT end state\n");
+			code = -E_OTHER;
+		} else {
+			printf(", ok\n");
+		}
+	}
+
+	return -code;
+}
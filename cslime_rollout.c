@@ -0,0 +1,369 @@
+/*
+ * cslime_rollout.c
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include "common.h"
+#include "cslime.h"
+#include "cslime_ai.h"
+#include "cslime_rollout.h"
+#include "cslime_rec.h"
+
+#define RESULTS_MIN_CAPACITY 64
+
+/* Keep each worker in its own cache lines, the counters are written after
+ * every job. */
+#ifdef __GNUC__
+#define _WORKER_ALIGNED __attribute__((aligned(64)))
+#else
+#define _WORKER_ALIGNED
+#endif
+
+struct rollout_shared {
+	pthread_mutex_t lock;
+	pthread_cond_t start, done;
+	unsigned long batch;	/* incremented by rollout_run */
+	int busy;		/* workers still running the batch */
+	bool quit;
+
+	const struct rollout_job *jobs;
+	int n_jobs;
+	int next_job;		/* only accessed atomically */
+};
+
+struct rollout_worker {
+	pthread_t thread;
+	struct rollout_shared *shared;
+
+	/* results of the current batch */
+	struct rollout_result *results;
+	int n_results, capacity;
+	int code;
+
+	/* the brains used by the last job of the batch, with work areas of
+	 * our own. They are dropped at the end of each batch, the caller may
+	 * free or change the networks between calls to rollout_run(). */
+	NeuralData brain[N_PLAYERS];
+
+	struct rollout_stats stats;
+} _WORKER_ALIGNED;
+
+static double _now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static int _load_brain(struct rollout_worker *w, int i, NeuralData brain)
+{
+	int code = -E_OK;
+
+	if (w->brain[i].layers == brain.layers)
+		return -E_OK;
+
+	if (neural_bp_player_valid_data(w->brain[i]))
+		neural_bp_player_unshare_data(w->brain[i]);
+	w->brain[i] = neural_bp_player_share_data(brain, &code);
+
+	return code;
+}
+
+static void _drop_brains(struct rollout_worker *w)
+{
+	int i;
+
+	for (i = 0; i < N_PLAYERS; i++) {
+		if (neural_bp_player_valid_data(w->brain[i]))
+			neural_bp_player_unshare_data(w->brain[i]);
+		neural_bp_player_mark_invalid(w->brain[i]);
+	}
+}
+
+static struct pcontrol _policy_play(struct rollout_worker *w, int i,
+		const struct rollout_policy *p, const struct game *g,
+		unsigned int *seed)
+{
+	switch (p->kind) {
+	case POLICY_GREEDY:
+		return greedy_player_p(g, i, 1, seed);
+	case POLICY_GREEDY_PASSIVE:
+		return greedy_player_p(g, i, 0, seed);
+	case POLICY_NEURAL:
+		return neural_bp_player_p(g, i, w->brain + i);
+	default:
+		{
+			struct pcontrol none = {0};
+			return none;
+		}
+	}
+}
+
+/* Returns the error of the recording, if any */
+static int _play(struct rollout_worker *w, const struct rollout_job *job,
+						struct rollout_result *r)
+{
+	struct commands comm = {{{0}}};
+	struct replay_writer rec;
+	unsigned int seed = job->seed;
+	int i, rec_code = -E_OK;
+	bool recording = 0;
+
+	r->g = job->g;
+	r->winner = -1;
+	r->frames = 0;
+	r->sets = 0;
+	if (job->replay != NULL) {
+		rec_code = replay_writer_open(&rec, job->replay, job->seed,
+						DEF_START_POINTS, &r->g);
+		recording = rec_code == -E_OK;
+	}
+
+	while (job->max_frames == 0 || r->frames < job->max_frames) {
+		struct game_result gr;
+
+		for (i = 0; i < N_PLAYERS; i++)
+			comm.player[i] = _policy_play(w, i, job->policy + i,
+								&r->g, &seed);
+		gr = run_game(&r->g, comm);
+		r->frames++;
+		r->sets += gr.set_end;
+		if (gr.set_end && !gr.game_end)
+			game_reset(&r->g, gr.has_to_start);
+		if (recording)
+			replay_write_frame(&rec, &comm, -1, &r->g);
+
+		if (gr.game_end) {
+			r->winner = gr.scorer_player;
+			break;
+		}
+	}
+
+	return recording? replay_writer_close(&rec, &r->g) : rec_code;
+}
+
+static int _run_job(struct rollout_worker *w, int j)
+{
+	const struct rollout_job *job = w->shared->jobs + j;
+	int i, code;
+
+	for (i = 0; i < N_PLAYERS; i++) {
+		if (job->policy[i].kind == POLICY_NEURAL
+		    && (code = _load_brain(w, i, job->policy[i].brain)) < 0)
+			return code;
+	}
+
+	if (w->n_results == w->capacity) {
+		int capacity = (w->capacity > 0)? w->capacity*2
+						: RESULTS_MIN_CAPACITY;
+		struct rollout_result *rs;
+
+		rs = realloc(w->results, capacity*sizeof(*rs));
+		if (rs == NULL)
+			return -E_NOMEM;
+		w->results = rs;
+		w->capacity = capacity;
+	}
+
+	code = _play(w, job, w->results + w->n_results);
+	w->results[w->n_results].job = j;
+	w->stats.frames += w->results[w->n_results].frames;
+	w->stats.jobs++;
+	w->n_results++;
+
+	return code;
+}
+
+static void *_worker(void *arg)
+{
+	struct rollout_worker *w = arg;
+	struct rollout_shared *sh = w->shared;
+	unsigned long batch = 0;
+
+	while (1) {
+		int j;
+		double t0;
+
+		pthread_mutex_lock(&sh->lock);
+		while (sh->batch == batch && !sh->quit)
+			pthread_cond_wait(&sh->start, &sh->lock);
+		if (sh->quit) {
+			pthread_mutex_unlock(&sh->lock);
+			break;
+		}
+		batch = sh->batch;
+		pthread_mutex_unlock(&sh->lock);
+
+		w->n_results = 0;
+		w->code = -E_OK;
+		t0 = _now();
+		while ((j = __sync_fetch_and_add(&sh->next_job, 1)) < sh->n_jobs) {
+			if ((w->code = _run_job(w, j)) < 0)
+				break;
+		}
+		_drop_brains(w);
+		w->stats.busy_time += _now() - t0;
+
+		pthread_mutex_lock(&sh->lock);
+		if (--sh->busy == 0)
+			pthread_cond_signal(&sh->done);
+		pthread_mutex_unlock(&sh->lock);
+	}
+
+	return NULL;
+}
+
+static void _stop_workers(struct rollout_pool *rp, int n_started)
+{
+	struct rollout_shared *sh = rp->shared;
+	int i;
+
+	pthread_mutex_lock(&sh->lock);
+	sh->quit = 1;
+	pthread_cond_broadcast(&sh->start);
+	pthread_mutex_unlock(&sh->lock);
+
+	for (i = 0; i < n_started; i++)
+		pthread_join(rp->workers[i].thread, NULL);
+}
+
+struct rollout_pool rollout_pool_create(int n_threads, int *ret_code)
+{
+	struct rollout_pool rp = {0};
+	struct rollout_worker *workers = NULL;
+	struct rollout_shared *sh = NULL;
+	int i, code = -E_OK;
+
+	if (n_threads <= 0) {
+		code = -E_BADARGS;
+		goto rollout_pool_create_end;
+	}
+	if (__CALLOC(sh) == NULL
+	    || posix_memalign((void **)&workers, 64,
+				n_threads*sizeof(*workers)) != 0) {
+		workers = NULL;
+		code = -E_NOMEM;
+		goto rollout_pool_create_end;
+	}
+
+	pthread_mutex_init(&sh->lock, NULL);
+	pthread_cond_init(&sh->start, NULL);
+	pthread_cond_init(&sh->done, NULL);
+
+	rp.n_threads = n_threads;
+	rp.workers = workers;
+	rp.shared = sh;
+
+	for (i = 0; i < n_threads; i++) {
+		struct rollout_worker zero = {0};
+		int k;
+
+		workers[i] = zero;
+		workers[i].shared = sh;
+		for (k = 0; k < N_PLAYERS; k++)
+			neural_bp_player_mark_invalid(workers[i].brain[k]);
+		if (pthread_create(&workers[i].thread, NULL, _worker,
+							workers + i) != 0) {
+			_stop_workers(&rp, i);
+			code = -E_OTHER;
+			goto rollout_pool_create_end;
+		}
+	}
+
+rollout_pool_create_end:
+	if (code < 0) {
+		if (sh != NULL) {
+			pthread_mutex_destroy(&sh->lock);
+			pthread_cond_destroy(&sh->start);
+			pthread_cond_destroy(&sh->done);
+		}
+		free(sh);
+		free(workers);
+		rp.workers = NULL;
+		rp.shared = NULL;
+	}
+	if (ret_code != NULL)
+		*ret_code = code;
+
+	return rp;
+}
+
+void rollout_pool_destroy(struct rollout_pool rp)
+{
+	int i;
+
+	if (!rollout_pool_valid(rp))
+		return;
+
+	_stop_workers(&rp, rp.n_threads);
+	for (i = 0; i < rp.n_threads; i++)
+		free(rp.workers[i].results);
+	pthread_mutex_destroy(&rp.shared->lock);
+	pthread_cond_destroy(&rp.shared->start);
+	pthread_cond_destroy(&rp.shared->done);
+	free(rp.shared);
+	free(rp.workers);
+}
+
+int rollout_run(struct rollout_pool *rp, const struct rollout_job *jobs,
+				int n_jobs, struct rollout_result *results)
+{
+	struct rollout_shared *sh = rp->shared;
+	int i, k, code = -E_OK;
+
+	pthread_mutex_lock(&sh->lock);
+	sh->jobs = jobs;
+	sh->n_jobs = n_jobs;
+	sh->next_job = 0;
+	sh->busy = rp->n_threads;
+	sh->batch++;
+	pthread_cond_broadcast(&sh->start);
+	while (sh->busy > 0)
+		pthread_cond_wait(&sh->done, &sh->lock);
+	pthread_mutex_unlock(&sh->lock);
+
+	/* gather the per thread buffers */
+	for (i = 0; i < n_jobs; i++)
+		results[i].job = -1;
+	for (i = 0; i < rp->n_threads; i++) {
+		struct rollout_worker *w = rp->workers + i;
+
+		for (k = 0; k < w->n_results; k++)
+			results[w->results[k].job] = w->results[k];
+		if (w->code < 0)
+			code = w->code;
+	}
+
+	return code;
+}
+
+struct rollout_stats rollout_thread_stats(const struct rollout_pool *rp,
+								int thread)
+{
+	return rp->workers[thread].stats;
+}
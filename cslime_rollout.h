@@ -0,0 +1,99 @@
+/*
+ * cslime_rollout.h
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Rollout engine.
+ * A pool of worker threads plays games from given initial states with
+ * run_game(). Each job says who controls each player and for how long to
+ * play. The workers take the jobs in order from a shared counter and keep
+ * their results and statistics in their own buffers, so no locks are taken
+ * while the games are being played.
+ *
+ * The random numbers used by a job only depend on its seed, so the results
+ * do not depend on the number of threads or on which thread got each job.
+ */
+
+#ifndef _CSLIME_ROLLOUT_H_
+#define _CSLIME_ROLLOUT_H_
+
+#include <stdio.h>
+#include <pthread.h>
+#include "cslime.h"
+#include "cslime_ai.h"
+
+enum {POLICY_GREEDY, POLICY_GREEDY_PASSIVE, POLICY_NEURAL, N_POLICIES};
+
+struct rollout_policy {
+	int kind;
+	NeuralData brain; /* only for POLICY_NEURAL, it is not modified and
+			   * must live until rollout_run() returns */
+};
+
+struct rollout_job {
+	struct game g;
+	struct rollout_policy policy[N_PLAYERS];
+	int max_frames;	/* 0 to play until the end of the game */
+	unsigned int seed;
+	FILE *replay;	/* if not NULL, the job is recorded in it (see
+			 * cslime_rec.h); only for PhysicsDefault */
+};
+
+struct rollout_result {
+	int job;	/* index of the job in the array given to rollout_run */
+	int winner;	/* -1 if max_frames was reached before the end */
+	int frames;
+	int sets;
+	struct game g;	/* final state */
+};
+
+struct rollout_worker;
+
+struct rollout_pool {
+	int n_threads;
+	struct rollout_worker *workers;
+	struct rollout_shared *shared;
+};
+
+#define rollout_pool_valid(rp) ((rp).workers != NULL)
+
+struct rollout_stats {
+	long jobs;
+	long frames;
+	double busy_time; /* seconds spent playing */
+};
+
+struct rollout_pool rollout_pool_create(int n_threads, int *ret_code);
+void rollout_pool_destroy(struct rollout_pool rp);
+
+int rollout_run(struct rollout_pool *rp, const struct rollout_job *jobs,
+				int n_jobs, struct rollout_result *results);
+	/* Run all the jobs and wait for them. results[i] is the result of
+	 * jobs[i]. Returns -E_OK, or -E_NOMEM if a worker could not get
+	 * memory or the error of a recording, in which case some of the
+	 * results are missing (their 'job' field is -1). */
+
+struct rollout_stats rollout_thread_stats(const struct rollout_pool *rp,
+								int thread);
+	/* Accumulated since the pool was created */
+
+#endif /* _CSLIME_ROLLOUT_H_ */
@@ -0,0 +1,89 @@
+/*
+ * cslime_server.c
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Shared memory environment server, see cslime_shm.h */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include "common.h"
+#include "cslime_shm.h"
+
+#define DEF_CHANNELS 16
+#define DEF_GAMES 256
+#define DEF_THREADS 1
+
+static struct env_server Server;
+
+static void _stop(int sig)
+{
+	env_server_stop(&Server);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-c channels] [-g games per channel] [-t threads] "
+		"name\n"
+		"Serves the games in the shared memory object 'name' (e.g. "
+		"/cslime) until\ninterrupted.\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	int channels = DEF_CHANNELS, games = DEF_GAMES, threads = DEF_THREADS;
+	int opt, code;
+
+	while ((opt = getopt(argc, argv, "c:g:t:h")) != -1) {
+		switch (opt) {
+		case 'c': channels = atoi(optarg);	break;
+		case 'g': games = atoi(optarg);		break;
+		case 't': threads = atoi(optarg);	break;
+		default:
+			usage(argv[0]);
+			return E_BADARGS;
+		}
+	}
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return E_BADARGS;
+	}
+
+	Server = env_server_create(argv[optind], channels, games, threads,
+									&code);
+	if (!env_server_valid(Server)) {
+		fprintf(stderr, "cannot create %s\n", argv[optind]);
+		return -code;
+	}
+	signal(SIGINT, _stop);
+	signal(SIGTERM, _stop);
+
+	code = env_server_run(&Server);
+	env_server_destroy(Server);
+
+	return -code;
+}
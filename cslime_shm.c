@@ -0,0 +1,383 @@
+/*
+ * cslime_shm.c
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "common.h"
+#include "cslime_env.h"
+#include "cslime_shm.h"
+
+/* Polls of the other side before going to sleep on the futex */
+#define SHM_SPIN 4096
+
+#define SHM_ALIGN(n) (((n) + 63) & ~(uint64_t)63)
+#define SHM_PTR(shm, off) ((void*)((char*)(shm) + (off)))
+
+static void _futex_wait(volatile uint32_t *addr, uint32_t val)
+{
+	syscall(SYS_futex, addr, FUTEX_WAIT, val, NULL, NULL, 0);
+}
+
+static void _futex_wake(volatile uint32_t *addr)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/* Wait until *addr is no longer 'val'. 'sleeps' tells the other side that it
+ * has to wake us. */
+static void _wait_change(volatile uint32_t *addr, uint32_t val,
+			volatile uint32_t *sleeps, volatile uint32_t *quit)
+{
+	int i;
+
+	for (i = 0; i < SHM_SPIN; i++) {
+		if (*addr != val || (quit != NULL && *quit))
+			return;
+	}
+	while (*addr == val && (quit == NULL || !*quit)) {
+		*sleeps = 1;
+		__sync_synchronize();
+		if (*addr == val && (quit == NULL || !*quit))
+			_futex_wait(addr, val);
+		*sleeps = 0;
+	}
+}
+
+static void _wake(volatile uint32_t *addr, volatile uint32_t *sleeps)
+{
+	__sync_synchronize();
+	if (*sleeps)
+		_futex_wake(addr);
+}
+
+/* Server */
+
+struct env_server env_server_create(const char *name, int n_channels,
+		int games_per_channel, int n_threads, int *ret_code)
+{
+	struct env_server s = {0};
+	struct env_shm_header *shm;
+	uint64_t size, per_channel;
+	uint64_t off_actions, off_obs, off_rewards, off_dones, off_mask;
+	int code = -E_OK, fd = -1, i, n = games_per_channel;
+
+	if (n_channels <= 0 || n <= 0 || n_threads <= 0
+	    || n_threads > ENV_SHM_MAX_THREADS) {
+		code = -E_BADARGS;
+		goto env_server_create_end;
+	}
+
+	/* the buffers of each channel, one after the other */
+	off_actions = 0;
+	off_obs = off_actions + SHM_ALIGN(n*N_PLAYERS*sizeof(uint8_t));
+	off_rewards = off_obs + SHM_ALIGN(n*N_PLAYERS*ENV_N_OBS*sizeof(float));
+	off_dones = off_rewards + SHM_ALIGN(n*N_PLAYERS*sizeof(float));
+	off_mask = off_dones + SHM_ALIGN(n*sizeof(bool));
+	per_channel = off_mask + SHM_ALIGN(n*sizeof(bool));
+	size = SHM_ALIGN(sizeof(*shm) + n_channels*sizeof(shm->channel[0]))
+						+ n_channels*per_channel;
+
+	if (NCALLOC(s.eb, n_channels) == NULL
+	    || (s.name = malloc(strlen(name) + 1)) == NULL) {
+		code = -E_NOMEM;
+		goto env_server_create_end;
+	}
+	strcpy(s.name, name);
+
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0 || ftruncate(fd, size) < 0) {
+		code = -E_OTHER;
+		goto env_server_create_end;
+	}
+	shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED) {
+		code = -E_OTHER;
+		goto env_server_create_end;
+	}
+
+	/* ftruncate() filled it with zeros */
+	shm->n_channels = n_channels;
+	shm->games_per_channel = n;
+	shm->n_threads = n_threads;
+	shm->size = size;
+	for (i = 0; i < n_channels; i++) {
+		struct env_shm_channel *ch = shm->channel + i;
+		uint64_t base = SHM_ALIGN(sizeof(*shm)
+				+ n_channels*sizeof(shm->channel[0]))
+							+ i*per_channel;
+
+		ch->thread = i % n_threads;
+		ch->actions = base + off_actions;
+		ch->obs = base + off_obs;
+		ch->rewards = base + off_rewards;
+		ch->dones = base + off_dones;
+		ch->mask = base + off_mask;
+
+		s.eb[i] = env_batch_create(n, DEF_START_POINTS, &code);
+		if (!env_batch_valid(s.eb[i])) {
+			munmap(shm, size);
+			goto env_server_create_end;
+		}
+		env_batch_reset_mask(s.eb + i, NULL, SHM_PTR(shm, ch->obs));
+	}
+	s.shm = shm;
+	__sync_synchronize();
+	shm->magic = ENV_SHM_MAGIC;
+
+env_server_create_end:
+	if (fd >= 0)
+		close(fd);
+	if (!env_server_valid(s)) {
+		if (fd >= 0)
+			shm_unlink(name);
+		if (s.eb != NULL) {
+			for (i = 0; i < n_channels; i++)
+				env_batch_destroy(s.eb[i]);
+		}
+		free(s.eb);
+		free(s.name);
+		s.eb = NULL;
+		s.name = NULL;
+	}
+	if (ret_code != NULL)
+		*ret_code = code;
+
+	return s;
+}
+
+void env_server_destroy(struct env_server s)
+{
+	int i;
+
+	if (!env_server_valid(s))
+		return;
+
+	for (i = 0; i < s.shm->n_channels; i++)
+		env_batch_destroy(s.eb[i]);
+	shm_unlink(s.name);
+	munmap(s.shm, s.shm->size);
+	free(s.eb);
+	free(s.name);
+}
+
+static void _serve(struct env_server *s, int c)
+{
+	struct env_shm_header *shm = s->shm;
+	struct env_shm_channel *ch = shm->channel + c;
+	float *obs = SHM_PTR(shm, ch->obs);
+
+	if (ch->kind == ENV_REQ_RESET) {
+		int n = shm->games_per_channel;
+
+		env_batch_reset_mask(s->eb + c, SHM_PTR(shm, ch->mask), obs);
+		memset(SHM_PTR(shm, ch->rewards), 0, n*N_PLAYERS*sizeof(float));
+		memset(SHM_PTR(shm, ch->dones), 0, n*sizeof(bool));
+	} else {
+		env_batch_step(s->eb + c, SHM_PTR(shm, ch->actions), obs,
+			SHM_PTR(shm, ch->rewards), SHM_PTR(shm, ch->dones));
+	}
+}
+
+struct _server_thread {
+	pthread_t thread;
+	struct env_server *s;
+	int t;
+};
+
+static void *_server_loop(void *arg)
+{
+	struct _server_thread *st = arg;
+	struct env_shm_header *shm = st->s->shm;
+	volatile uint32_t *bell = &shm->doorbell[st->t].bell;
+	int c;
+
+	while (!shm->quit) {
+		uint32_t rung = *bell;
+		bool served = 0;
+
+		__sync_synchronize();
+		for (c = st->t; c < shm->n_channels; c += shm->n_threads) {
+			struct env_shm_channel *ch = shm->channel + c;
+			uint32_t req = ch->request;
+
+			if (req == ch->response)
+				continue;
+			__sync_synchronize();
+			_serve(st->s, c);
+			__sync_synchronize();
+			ch->response = req;
+			_wake(&ch->response, &ch->client_sleeps);
+			served = 1;
+		}
+		if (!served)
+			_wait_change(bell, rung, &shm->doorbell[st->t].sleeps,
+								&shm->quit);
+	}
+
+	return NULL;
+}
+
+int env_server_run(struct env_server *s)
+{
+	struct _server_thread st[ENV_SHM_MAX_THREADS];
+	int n_threads = s->shm->n_threads, t, started, code = -E_OK;
+
+	for (t = 0; t < n_threads; t++) {
+		st[t].s = s;
+		st[t].t = t;
+	}
+	for (started = 1; started < n_threads; started++) {
+		if (pthread_create(&st[started].thread, NULL, _server_loop,
+							st + started)) {
+			env_server_stop(s);
+			code = -E_OTHER;
+			break;
+		}
+	}
+
+	_server_loop(st);
+	for (t = 1; t < started; t++)
+		pthread_join(st[t].thread, NULL);
+
+	return code;
+}
+
+void env_server_stop(struct env_server *s)
+{
+	int t, i;
+
+	s->shm->quit = 1;
+	__sync_synchronize();
+	for (t = 0; t < s->shm->n_threads; t++)
+		_futex_wake(&s->shm->doorbell[t].bell);
+	/* and the clients waiting for an answer */
+	for (i = 0; i < s->shm->n_channels; i++)
+		_futex_wake(&s->shm->channel[i].response);
+}
+
+/* Client */
+
+struct env_client env_client_open(const char *name, int *ret_code)
+{
+	struct env_client c = {0};
+	struct env_shm_header *shm;
+	struct stat st;
+	uint32_t pid = getpid();
+	int code = -E_BADCFG, fd, i;
+
+	fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0)
+		goto env_client_open_end;
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof(*shm)) {
+		close(fd);
+		goto env_client_open_end;
+	}
+	shm = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+								fd, 0);
+	close(fd);
+	if (shm == MAP_FAILED)
+		goto env_client_open_end;
+	if (shm->magic != ENV_SHM_MAGIC || shm->size != st.st_size) {
+		munmap(shm, st.st_size);
+		goto env_client_open_end;
+	}
+
+	code = -E_OTHER;
+	for (i = 0; i < shm->n_channels; i++) {
+		struct env_shm_channel *ch = shm->channel + i;
+
+		if (__sync_bool_compare_and_swap(&ch->owner, 0, pid)) {
+			c.shm = shm;
+			c.ch = ch;
+			c.n = shm->games_per_channel;
+			c.seq = ch->response;
+			c.actions = SHM_PTR(shm, ch->actions);
+			c.obs = SHM_PTR(shm, ch->obs);
+			c.rewards = SHM_PTR(shm, ch->rewards);
+			c.dones = SHM_PTR(shm, ch->dones);
+			c.mask = SHM_PTR(shm, ch->mask);
+			code = -E_OK;
+			break;
+		}
+	}
+	if (!env_client_valid(c))
+		munmap(shm, st.st_size);
+
+env_client_open_end:
+	if (ret_code != NULL)
+		*ret_code = code;
+
+	return c;
+}
+
+void env_client_close(struct env_client c)
+{
+	if (!env_client_valid(c))
+		return;
+
+	__sync_synchronize();
+	c.ch->owner = 0;
+	munmap(c.shm, c.shm->size);
+}
+
+/* Returns -E_OTHER if the server quit before answering */
+static int _request(struct env_client *c, int kind)
+{
+	struct env_shm_header *shm = c->shm;
+	int t = c->ch->thread;
+
+	c->ch->kind = kind;
+	__sync_synchronize();
+	c->ch->request = ++c->seq;
+	__sync_fetch_and_add(&shm->doorbell[t].bell, 1);
+	_wake(&shm->doorbell[t].bell, &shm->doorbell[t].sleeps);
+
+	_wait_change(&c->ch->response, c->seq - 1, &c->ch->client_sleeps,
+								&shm->quit);
+	__sync_synchronize();
+
+	return (c->ch->response == c->seq)? -E_OK : -E_OTHER;
+}
+
+int env_client_step(struct env_client *c)
+{
+	return _request(c, ENV_REQ_STEP);
+}
+
+int env_client_reset(struct env_client *c)
+{
+	return _request(c, ENV_REQ_RESET);
+}
@@ -0,0 +1,138 @@
+/*
+ * cslime_shm.h
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Shared memory environment server, for trainers that run in other
+ * processes (Linux only).
+ * The server owns a pool of games, split in channels with the same number of
+ * games, and puts them in a POSIX shared memory object. A client takes a free
+ * channel and, for each step, writes the actions of its games in it and rings
+ * the server. The server steps the channel with env_batch_step(), which reads
+ * the actions from, and writes the observations, rewards and dones to the
+ * shared memory itself, and answers. There is nothing to serialize: the
+ * buffers are the ones described in cslime_env.h.
+ *
+ * Each side waits for the other by spinning for a while and then sleeping on
+ * a futex, so a round trip costs a few microseconds when both are running.
+ * A channel has one request in flight; a client that wants to overlap its own
+ * work with the stepping can take several channels.
+ * If a client dies without env_client_close() its channel stays taken until
+ * the server is restarted.
+ */
+
+#ifndef _CSLIME_SHM_H_
+#define _CSLIME_SHM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cslime_env.h"
+
+#define ENV_SHM_MAGIC 0x43534c31	/* "CSL1" */
+#define ENV_SHM_MAX_THREADS 16
+
+#ifdef __GNUC__
+#define _SHM_ALIGNED __attribute__((aligned(64)))
+#else
+#define _SHM_ALIGNED
+#endif
+
+enum {ENV_REQ_STEP, ENV_REQ_RESET};
+
+/* The buffers are given as offsets from the start of the object, which is
+ * mapped at different addresses in each process. */
+struct env_shm_channel {
+	volatile uint32_t owner;	/* pid of the client, 0 if free */
+	volatile uint32_t request;	/* sequence numbers, also futexes */
+	volatile uint32_t response;
+	volatile uint32_t client_sleeps;
+	int32_t kind;			/* ENV_REQ_* */
+	int32_t thread;			/* server thread that serves it */
+	uint64_t actions, obs, rewards, dones, mask;
+} _SHM_ALIGNED;
+
+struct env_shm_header {
+	uint32_t magic;
+	int32_t n_channels, games_per_channel, n_threads;
+	uint64_t size;		/* of the whole object */
+	volatile uint32_t quit;
+	/* one per server thread, bumped by the clients on each request */
+	struct {
+		volatile uint32_t bell;
+		volatile uint32_t sleeps;
+	} _SHM_ALIGNED doorbell[ENV_SHM_MAX_THREADS];
+	struct env_shm_channel channel[];
+};
+
+struct env_server {
+	struct env_shm_header *shm;
+	struct env_batch *eb;	/* one per channel */
+	char *name;
+};
+
+#define env_server_valid(s) ((s).shm != NULL)
+
+struct env_server env_server_create(const char *name, int n_channels,
+		int games_per_channel, int n_threads, int *ret_code);
+	/* Create the shared memory object 'name' (e.g. "/cslime") with new
+	 * games. Fails if it already exists. */
+void env_server_destroy(struct env_server s);
+	/* Also removes the object. The clients that still have it mapped can
+	 * go on using the memory, but nobody will answer them. */
+int env_server_run(struct env_server *s);
+	/* Serve the clients until env_server_stop(). Uses the calling thread
+	 * and n_threads - 1 new ones, each with its share of the channels.
+	 * Returns -E_OK, or -E_OTHER if the threads could not be created. */
+void env_server_stop(struct env_server *s);
+	/* Can be called from another thread or from a signal handler */
+
+struct env_client {
+	struct env_shm_header *shm;
+	struct env_shm_channel *ch;
+	int n;			/* games in the channel */
+	uint32_t seq;
+
+	/* the buffers of the channel, see cslime_env.h */
+	uint8_t *actions;
+	float *obs, *rewards;
+	bool *dones;
+	bool *mask;		/* for env_client_reset() */
+};
+
+#define env_client_valid(c) ((c).shm != NULL)
+
+struct env_client env_client_open(const char *name, int *ret_code);
+	/* Map the object and take a free channel. Returns -E_BADCFG if there
+	 * is no server with that name and -E_OTHER if all the channels are
+	 * taken. */
+void env_client_close(struct env_client c);
+
+int env_client_step(struct env_client *c);
+	/* Step the games with the actions in c->actions and wait for the
+	 * new observations, rewards and dones. */
+int env_client_reset(struct env_client *c);
+	/* Start new games in those with c->mask[i] set and wait for the
+	 * observations. The rewards and dones are cleared.
+	 * Both return -E_OK, or -E_OTHER if the server was stopped before
+	 * answering; the buffers are not valid then. */
+
+#endif /* _CSLIME_SHM_H_ */
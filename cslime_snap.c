@@ -0,0 +1,186 @@
+/*
+ * cslime_snap.c
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include "common.h"
+#include "cslime.h"
+#include "cslime_phys.h"
+#include "cslime_snap.h"
+
+/* The snapshot must fit in one cache line */
+typedef char _snapshot_size_check[(sizeof(struct game_snapshot)
+					<= SNAPSHOT_ALIGN)? 1 : -1];
+
+static inline void _snap_body(float *d, const struct free_body *b)
+{
+	d[0] = b->pos.x;
+	d[1] = b->pos.y;
+	d[2] = b->vel.x;
+	d[3] = b->vel.y;
+}
+
+static inline void _restore_body(struct free_body *b, const float *d)
+{
+	b->pos.x = d[0];
+	b->pos.y = d[1];
+	b->vel.x = d[2];
+	b->vel.y = d[3];
+}
+
+void game_snapshot(const struct game *g, struct game_snapshot *s)
+{
+	int i;
+
+	s->on_fire = 0;
+	for (i = 0; i < N_PLAYERS; i++) {
+		_snap_body(s->body[i], &g->p[i].body);
+		s->points[i] = g->p[i].points;
+		s->on_fire |= (g->p[i].on_fire != 0) << i;
+	}
+	_snap_body(s->body[N_PLAYERS], &g->b.body);
+}
+
+void game_restore_params(struct game *g, const struct game_snapshot *s,
+					const struct physics_params *pp)
+{
+	int i;
+
+	for (i = 0; i < N_PLAYERS; i++) {
+		g->p[i] = def_player;
+		body_set_class(&g->p[i].body, pp->body_class + BODY_CLASS_PLAYER);
+		_restore_body(&g->p[i].body, s->body[i]);
+		g->p[i].points = s->points[i];
+		g->p[i].on_fire = (s->on_fire >> i) & 1;
+	}
+	g->b = def_ball;
+	body_set_class(&g->b.body, pp->body_class + BODY_CLASS_BALL);
+	_restore_body(&g->b.body, s->body[N_PLAYERS]);
+	g->phys = pp;
+}
+
+void game_restore(struct game *g, const struct game_snapshot *s)
+{
+	game_restore_params(g, s, &PhysicsDefault);
+}
+
+/* The game only lives on the stack, the constants are copied from the class
+ * table once per frame. */
+struct game_result run_game_snapshot(struct game_snapshot *s,
+		const struct physics_params *pp, struct commands comm)
+{
+	struct game g;
+	struct game_result gr;
+
+	game_restore_params(&g, s, pp);
+	gr = run_game_p(&g, &comm);
+	game_snapshot(&g, s);
+
+	return gr;
+}
+
+/* Encoding: everything is stored as 32 bit little endian words */
+
+static inline unsigned char *_put32(unsigned char *buf, uint32_t w)
+{
+	buf[0] = w;
+	buf[1] = w >> 8;
+	buf[2] = w >> 16;
+	buf[3] = w >> 24;
+
+	return buf + 4;
+}
+
+static inline const unsigned char *_get32(const unsigned char *buf,
+								uint32_t *w)
+{
+	*w = buf[0] | (uint32_t)buf[1] << 8 | (uint32_t)buf[2] << 16
+						| (uint32_t)buf[3] << 24;
+	return buf + 4;
+}
+
+void game_snapshot_encode(const struct game_snapshot *s, unsigned char *buf)
+{
+	int i, k;
+
+	memcpy(buf, SNAPSHOT_MAGIC, 4);
+	buf += 4;
+	for (i = 0; i < N_PLAYERS + 1; i++) {
+		for (k = 0; k < 4; k++) {
+			uint32_t w;
+
+			memcpy(&w, &s->body[i][k], sizeof(w));
+			buf = _put32(buf, w);
+		}
+	}
+	for (i = 0; i < N_PLAYERS; i++)
+		buf = _put32(buf, s->points[i]);
+	_put32(buf, s->on_fire);
+}
+
+int game_snapshot_decode(struct game_snapshot *s, const unsigned char *buf)
+{
+	int i, k;
+	uint32_t w;
+
+	if (memcmp(buf, SNAPSHOT_MAGIC, 4))
+		return -E_BADCFG;
+	buf += 4;
+	for (i = 0; i < N_PLAYERS + 1; i++) {
+		for (k = 0; k < 4; k++) {
+			buf = _get32(buf, &w);
+			memcpy(&s->body[i][k], &w, sizeof(w));
+		}
+	}
+	for (i = 0; i < N_PLAYERS; i++) {
+		buf = _get32(buf, &w);
+		s->points[i] = (int32_t)w;
+	}
+	_get32(buf, &w);
+	if (w >> N_PLAYERS)
+		return -E_BADCFG;
+	s->on_fire = w;
+
+	return -E_OK;
+}
+
+int game_snapshot_fwrite(FILE *f, const struct game_snapshot *s)
+{
+	unsigned char buf[SNAPSHOT_ENCODED_SIZE];
+
+	game_snapshot_encode(s, buf);
+	if (fwrite(buf, sizeof(buf), 1, f) != 1)
+		return -E_OTHER;
+
+	return -E_OK;
+}
+
+int game_snapshot_fread(FILE *f, struct game_snapshot *s)
+{
+	unsigned char buf[SNAPSHOT_ENCODED_SIZE];
+
+	if (fread(buf, sizeof(buf), 1, f) != 1)
+		return -E_OTHER;
+
+	return game_snapshot_decode(s, buf);
+}
@@ -0,0 +1,86 @@
+/*
+ * cslime_snap.h
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Snapshots of the game state.
+ * struct game carries, for every body, data that never changes during a match
+ * (acc, box, mass, drag). A snapshot only keeps what run_game() modifies, in
+ * one cache line, so that search and rollback code can save and restore games
+ * cheaply. The constant data is taken from def_player, def_ball and the
+ * body_class table of the physics parameters on restore; the parameters are
+ * not part of the snapshot.
+ *
+ * The encoded form is a fixed size, byte order independent representation of
+ * a snapshot, suitable for files and sockets. It stores the exact bits of the
+ * floats, so a decoded game behaves exactly like the original one.
+ */
+
+#ifndef _CSLIME_SNAP_H_
+#define _CSLIME_SNAP_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "cslime.h"
+
+#define SNAPSHOT_ALIGN 64
+
+#ifdef __GNUC__
+#define _SNAPSHOT_ALIGNED __attribute__((aligned(SNAPSHOT_ALIGN)))
+#else
+#define _SNAPSHOT_ALIGNED
+#endif
+
+struct game_snapshot {
+	/* pos.x, pos.y, vel.x, vel.y of the players and then of the ball */
+	float body[N_PLAYERS + 1][4];
+	int32_t points[N_PLAYERS];
+	uint32_t on_fire; /* bit i is set if player i is on fire */
+} _SNAPSHOT_ALIGNED;
+
+#define SNAPSHOT_MAGIC "CSS1"
+/* magic, the floats, the points and on_fire, 4 bytes each */
+#define SNAPSHOT_ENCODED_SIZE (4 + 4*(4*(N_PLAYERS + 1) + N_PLAYERS + 1))
+
+void game_snapshot(const struct game *g, struct game_snapshot *s);
+void game_restore(struct game *g, const struct game_snapshot *s);
+void game_restore_params(struct game *g, const struct game_snapshot *s,
+					const struct physics_params *pp);
+	/* After game_restore(), g behaves exactly as the game the snapshot
+	 * was taken from, if that game used PhysicsDefault. Otherwise use
+	 * game_restore_params() with the parameters of that game. */
+struct game_result run_game_snapshot(struct game_snapshot *s,
+		const struct physics_params *pp, struct commands comm);
+	/* Same as restoring the snapshot, calling run_game() and taking it
+	 * again */
+
+void game_snapshot_encode(const struct game_snapshot *s, unsigned char *buf);
+	/* Write SNAPSHOT_ENCODED_SIZE bytes to buf */
+int game_snapshot_decode(struct game_snapshot *s, const unsigned char *buf);
+	/* Returns -E_BADCFG if buf does not hold an encoded snapshot */
+
+int game_snapshot_fwrite(FILE *f, const struct game_snapshot *s);
+int game_snapshot_fread(FILE *f, struct game_snapshot *s);
+	/* Both return -E_OK, or -E_OTHER on I/O errors and -E_BADCFG on bad
+	 * data */
+
+#endif /* _CSLIME_SNAP_H_ */
@@ -0,0 +1,103 @@
+/*
+ * cslime_stepper.h
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Template for the specialized steppers of cslime.c. Not a regular header: it
+ * is included once for each engine variant, with these defined:
+ *
+ * 	STEPPER_NAME		generates run_game_<STEPPER_NAME>()
+ * 	STEPPER_OVERSAMPLING	substeps per frame, a constant expression
+ * 	STEPPER_PLAYER_MODEL	PLAYER_MODEL_ORIGINAL or PLAYER_MODEL_OBLIQUE
+ * 	STEPPER_WORLD		WORLD_POLY (the court polygon) or WORLD_BOX
+ * 				(the rectangle of the court)
+ *
+ * Everything is known at compile time, so the collision tests are inlined
+ * without the model switches and the substep loop has a constant trip count.
+ * The loop is not unrolled on purpose: a fully unrolled frame is over 50KB of
+ * code per variant and runs slower than the rolled one.
+ * The generated function only uses its specialized loop when the oversampling
+ * of g->phys matches STEPPER_OVERSAMPLING, otherwise it runs the same models
+ * with the run-time count. The other parameters of g->phys are honoured.
+ */
+
+#ifndef STEPPER_NAME
+#error "cslime_stepper.h needs STEPPER_NAME"
+#endif
+
+#ifndef PLAYER_MODEL_ORIGINAL
+#define PLAYER_MODEL_ORIGINAL 0
+#define PLAYER_MODEL_OBLIQUE 1
+#define WORLD_POLY 0
+#define WORLD_BOX 1
+
+/* The player model is only implemented without trigonometry */
+#define STEPPER_NOTRIG(model) ((model) == PLAYER_MODEL_OBLIQUE \
+						|| CSLIME_NOTRIG_DEFAULT)
+
+static ALWAYS_INLINE struct game_result _stepper_substep(struct game *g,
+			const struct commands *comm, int model, int world)
+{
+	struct kinetic kin;
+
+	_players_step(g, comm);
+
+	COUNT_SUBSTEP();
+	kin = kinetic_step(g->b.body);
+	kin = _ball_collisions_spec(g, kin, STEPPER_NOTRIG(model),
+				model == PLAYER_MODEL_OBLIQUE,
+				world == WORLD_BOX);
+	apply_kinetic(&(g->b.body), kin);
+
+	return game_umpire(g);
+}
+#endif /* PLAYER_MODEL_ORIGINAL */
+
+struct game_result GLUE(run_game_, STEPPER_NAME)(struct game *g,
+							struct commands comm)
+{
+	int i;
+	struct game_result gr = {0};
+
+	if (g->phys->oversampling != STEPPER_OVERSAMPLING) {
+		for (i = 0; i < g->phys->oversampling; i++) {
+			gr = _stepper_substep(g, &comm, STEPPER_PLAYER_MODEL,
+							STEPPER_WORLD);
+			if (gr.set_end)
+				break;
+		}
+		return gr;
+	}
+
+	for (i = 0; i < STEPPER_OVERSAMPLING; i++) {
+		gr = _stepper_substep(g, &comm, STEPPER_PLAYER_MODEL,
+							STEPPER_WORLD);
+		if (gr.set_end)
+			break;
+	}
+	return gr;
+}
+
+#undef STEPPER_NAME
+#undef STEPPER_OVERSAMPLING
+#undef STEPPER_PLAYER_MODEL
+#undef STEPPER_WORLD
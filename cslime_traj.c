@@ -0,0 +1,396 @@
+/*
+ * cslime_traj.c
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "cslime.h"
+#include "cslime_snap.h"
+#include "cslime_traj.h"
+
+/* frames and bit stream size, before the keyframe */
+#define TRAJ_BLOCK_HEADER 8
+/* zero bytes after the bit stream, so that decoding one frame past its end
+ * does not need any check */
+#define TRAJ_PAD (TRAJ_MAX_FRAME_BYTES + 8)
+
+static inline unsigned char *_put32(unsigned char *buf, uint32_t w)
+{
+	buf[0] = w;
+	buf[1] = w >> 8;
+	buf[2] = w >> 16;
+	buf[3] = w >> 24;
+
+	return buf + 4;
+}
+
+static inline const unsigned char *_get32(const unsigned char *buf,
+								uint32_t *w)
+{
+	*w = buf[0] | (uint32_t)buf[1] << 8 | (uint32_t)buf[2] << 16
+						| (uint32_t)buf[3] << 24;
+	return buf + 4;
+}
+
+static inline int _bit_length(uint32_t z)
+{
+#ifdef __GNUC__
+	return 32 - __builtin_clz(z);
+#else
+	int n = 0;
+
+	while (z) {
+		z >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+static void _pred_reset(struct traj_pred *tp, const struct game_snapshot *s)
+{
+	const float *x = &s->body[0][0];
+	int k;
+
+	for (k = 0; k < TRAJ_N_FLOATS; k++) {
+		memcpy(tp->last + k, x + k, sizeof(uint32_t));
+		tp->delta[k] = tp->prev_delta[k] = 0;
+		tp->width[k] = 0;
+	}
+	memcpy(tp->points, s->points, sizeof(tp->points));
+	tp->on_fire = s->on_fire;
+}
+
+/* The bits of a field extrapolated from its last three values, which is exact
+ * while they change by a constant step or along a parabola */
+static inline uint32_t _predict(const struct traj_pred *tp, int k)
+{
+	return tp->last[k] + 2*tp->delta[k] - tp->prev_delta[k];
+}
+
+/* Encoder.
+ * The bits are written from the least significant one of each byte on. */
+
+static inline void _put_bits(struct traj_encoder *e, uint32_t v, int n)
+{
+	e->acc |= (uint64_t)v << e->n_acc;
+	e->n_acc += n;
+	if (e->n_acc >= 32) {
+		e->p = _put32(e->p, e->acc);
+		e->acc >>= 32;
+		e->n_acc -= 32;
+	}
+}
+
+/* The difference 'z' (zigzag coded) of a field whose last one took 'width'
+ * bits: 0, or 10 and 'width' bits, or 11, the length and the bits */
+static inline void _put_diff(struct traj_encoder *e, uint32_t z,
+							unsigned char *width)
+{
+	int len;
+
+	if (z == 0) {
+		_put_bits(e, 0, 1);
+		return;
+	}
+	len = _bit_length(z);
+	if (len <= *width && *width <= len + 5) {
+		_put_bits(e, 1, 2);
+		_put_bits(e, z, *width);
+	} else {
+		_put_bits(e, 3 | (len - 1) << 2, 7);
+		_put_bits(e, z, len);
+		*width = len;
+	}
+}
+
+static void _encode_frame(struct traj_encoder *e, const struct game_snapshot *s)
+{
+	struct traj_pred *tp = &e->pred;
+	const float *x = &s->body[0][0];
+	int k;
+
+	for (k = 0; k < TRAJ_N_FLOATS; k++) {
+		uint32_t b, r;
+
+		memcpy(&b, x + k, sizeof(b));
+		r = b - _predict(tp, k);
+		_put_diff(e, (r << 1) ^ (0 - (r >> 31)), tp->width + k);
+		tp->prev_delta[k] = tp->delta[k];
+		tp->delta[k] = b - tp->last[k];
+		tp->last[k] = b;
+	}
+
+	if (memcmp(tp->points, s->points, sizeof(tp->points))
+	    || tp->on_fire != s->on_fire) {
+		_put_bits(e, 1, 1);
+		for (k = 0; k < N_PLAYERS; k++)
+			_put_bits(e, s->points[k], 32);
+		_put_bits(e, s->on_fire, N_PLAYERS);
+		memcpy(tp->points, s->points, sizeof(tp->points));
+		tp->on_fire = s->on_fire;
+	} else {
+		_put_bits(e, 0, 1);
+	}
+}
+
+static void _write(struct traj_encoder *e, const void *buf, size_t n)
+{
+	if (e->code == -E_OK && n > 0 && fwrite(buf, n, 1, e->f) != 1)
+		e->code = -E_OTHER;
+}
+
+static void _flush_block(struct traj_encoder *e)
+{
+	unsigned char head[TRAJ_BLOCK_HEADER];
+
+	while (e->n_acc > 0) {
+		*e->p++ = e->acc;
+		e->acc >>= 8;
+		e->n_acc -= 8;
+	}
+	_put32(_put32(head, e->n), e->p - e->buf);
+	_write(e, head, sizeof(head));
+	_write(e, e->key, sizeof(e->key));
+	_write(e, e->buf, e->p - e->buf);
+	e->n = 0;
+}
+
+int traj_encoder_open(struct traj_encoder *e, FILE *f, int key_interval)
+{
+	unsigned char head[8];
+
+	e->f = f;
+	e->key_interval = key_interval;
+	e->frames = 0;
+	e->n = 0;
+	e->buf = NULL;
+	e->code = -E_OK;
+
+	if (key_interval < 1 || key_interval > TRAJ_MAX_KEY_INTERVAL) {
+		e->code = -E_BADARGS;
+		goto traj_encoder_open_end;
+	}
+	if (NMALLOC(e->buf, (size_t)key_interval * TRAJ_MAX_FRAME_BYTES)
+								== NULL) {
+		e->code = -E_NOMEM;
+		goto traj_encoder_open_end;
+	}
+
+	memcpy(head, TRAJ_MAGIC, 4);
+	_put32(head + 4, key_interval);
+	_write(e, head, sizeof(head));
+
+traj_encoder_open_end:
+	return e->code;
+}
+
+void traj_encode(struct traj_encoder *e, const struct game_snapshot *s)
+{
+	if (e->n == 0) {
+		_pred_reset(&e->pred, s);
+		game_snapshot_encode(s, e->key);
+		e->p = e->buf;
+		e->acc = 0;
+		e->n_acc = 0;
+	} else {
+		_encode_frame(e, s);
+	}
+	e->frames++;
+	if (++e->n == e->key_interval)
+		_flush_block(e);
+}
+
+int traj_encoder_close(struct traj_encoder *e)
+{
+	unsigned char end[4];
+
+	if (!traj_encoder_valid(e))
+		return e->code;
+
+	if (e->n > 0)
+		_flush_block(e);
+	_put32(end, 0);
+	_write(e, end, sizeof(end));
+	if (e->code == -E_OK && fflush(e->f) != 0)
+		e->code = -E_OTHER;
+	free(e->buf);
+	e->buf = NULL;
+
+	return e->code;
+}
+
+/* Decoder */
+
+/* Make sure that at least 57 bits are in the accumulator */
+static inline void _refill(struct traj_decoder *d)
+{
+	while (d->n_acc <= 56) {
+		d->acc |= (uint64_t)*d->p++ << d->n_acc;
+		d->n_acc += 8;
+	}
+}
+
+static inline uint32_t _get_bits(struct traj_decoder *d, int n)
+{
+	uint32_t v = d->acc & ((UINT64_C(1) << n) - 1);
+
+	d->acc >>= n;
+	d->n_acc -= n;
+	return v;
+}
+
+static inline uint32_t _get_diff(struct traj_decoder *d, unsigned char *width)
+{
+	uint32_t c;
+
+	_refill(d);
+	c = d->acc & 3;
+	if (!(c & 1)) {
+		_get_bits(d, 1);
+		return 0;
+	}
+	if (c == 1) {
+		_get_bits(d, 2);
+	} else {
+		*width = ((_get_bits(d, 7) >> 2) & 31) + 1;
+		_refill(d);
+	}
+
+	return _get_bits(d, *width);
+}
+
+static void _decode_frame(struct traj_decoder *d, struct game_snapshot *s)
+{
+	struct traj_pred *tp = &d->pred;
+	float *x = &s->body[0][0];
+	int k;
+
+	for (k = 0; k < TRAJ_N_FLOATS; k++) {
+		uint32_t z = _get_diff(d, tp->width + k);
+		uint32_t b = _predict(tp, k)
+					+ ((z >> 1) ^ (0 - (z & 1)));
+
+		tp->prev_delta[k] = tp->delta[k];
+		tp->delta[k] = b - tp->last[k];
+		tp->last[k] = b;
+		memcpy(x + k, &b, sizeof(b));
+	}
+
+	_refill(d);
+	if (_get_bits(d, 1)) {
+		for (k = 0; k < N_PLAYERS; k++) {
+			_refill(d);
+			tp->points[k] = (int32_t)_get_bits(d, 32);
+		}
+		_refill(d);
+		tp->on_fire = _get_bits(d, N_PLAYERS);
+	}
+	memcpy(s->points, tp->points, sizeof(s->points));
+	s->on_fire = tp->on_fire;
+}
+
+int traj_decoder_open(struct traj_decoder *d, FILE *f)
+{
+	unsigned char head[8];
+	uint32_t w;
+
+	d->f = f;
+	d->frames = 0;
+	d->n = d->block_frames = 0;
+	d->buf = NULL;
+
+	if (fread(head, sizeof(head), 1, f) != 1
+	    || memcmp(head, TRAJ_MAGIC, 4))
+		return -E_BADCFG;
+	_get32(head + 4, &w);
+	if (w < 1 || w > TRAJ_MAX_KEY_INTERVAL)
+		return -E_BADCFG;
+	d->key_interval = w;
+
+	if (NMALLOC(d->buf, (size_t)w * TRAJ_MAX_FRAME_BYTES + TRAJ_PAD)
+								== NULL)
+		return -E_NOMEM;
+
+	return -E_OK;
+}
+
+/* Read the next block, and its keyframe into 's'. Returns 0 at the end. */
+static int _read_block(struct traj_decoder *d, struct game_snapshot *s)
+{
+	unsigned char head[TRAJ_BLOCK_HEADER + SNAPSHOT_ENCODED_SIZE];
+	uint32_t frames, size;
+
+	if (fread(head, 4, 1, d->f) != 1)
+		return -E_BADCFG;
+	_get32(head, &frames);
+	if (frames == 0)
+		return 0;
+
+	if (frames > d->key_interval
+	    || fread(head + 4, sizeof(head) - 4, 1, d->f) != 1)
+		return -E_BADCFG;
+	_get32(head + 4, &size);
+	if (size > (size_t)d->key_interval * TRAJ_MAX_FRAME_BYTES
+	    || (size > 0 && fread(d->buf, size, 1, d->f) != 1)
+	    || game_snapshot_decode(s, head + TRAJ_BLOCK_HEADER) < 0)
+		return -E_BADCFG;
+	memset(d->buf + size, 0, TRAJ_PAD);
+
+	_pred_reset(&d->pred, s);
+	d->p = d->buf;
+	d->end = d->buf + size;
+	d->acc = 0;
+	d->n_acc = 0;
+	d->block_frames = frames;
+	d->n = 1;
+
+	return 1;
+}
+
+int traj_decode(struct traj_decoder *d, struct game_snapshot *s)
+{
+	int code;
+
+	if (d->n == d->block_frames) {
+		code = _read_block(d, s);
+		d->frames += code > 0;
+		return code;
+	}
+
+	_decode_frame(d, s);
+	/* the bytes in the accumulator have not been used yet */
+	if (d->p - d->n_acc/8 > d->end)
+		return -E_BADCFG;
+	d->n++;
+	d->frames++;
+
+	return 1;
+}
+
+void traj_decoder_close(struct traj_decoder *d)
+{
+	free(d->buf);
+	d->buf = NULL;
+}
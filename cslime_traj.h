@@ -0,0 +1,128 @@
+/*
+ * cslime_traj.h
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Compressed trajectories.
+ * A replay (cslime_rec.h) has to be played again to know where the bodies
+ * were. A trajectory stores the state of every frame (a game_snapshot), so it
+ * can be read without the engine, at the cost of more bytes.
+ *
+ * The frames are grouped in blocks. Each block starts with a keyframe, the
+ * full encoded snapshot, and the rest of its frames only store how each
+ * field differs from a prediction. The floats are predicted by extrapolating
+ * their bits in the three previous frames along a parabola. This is done in
+ * integer arithmetic, so it is exact on every machine, and it is right most of
+ * the time for the players and close for the ball. The difference is coded
+ * like in Gorilla: one bit if it is zero, otherwise its length and its
+ * significant bits, reusing the length of the previous one when it fits.
+ * The points and on_fire take one bit per frame while they do not change.
+ *
+ * The file is:
+ * 	"CST1" and the frames per block (32 bit little endian words)
+ * 	the blocks, each one made of
+ * 		the number of frames in it and the size of its bit stream
+ * 		the keyframe, encoded as in cslime_snap.h
+ * 		the bit stream of the other frames, padded to a byte
+ * 	a zero word, as the frame count of the end mark
+ * Every block can be decoded on its own.
+ */
+
+#ifndef _CSLIME_TRAJ_H_
+#define _CSLIME_TRAJ_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "cslime.h"
+#include "cslime_snap.h"
+
+#define TRAJ_MAGIC "CST1"
+#define TRAJ_KEY_INTERVAL 256
+#define TRAJ_MAX_KEY_INTERVAL (1 << 16)
+#define TRAJ_N_FLOATS (4*(N_PLAYERS + 1))
+/* Largest frame: 2 control bits + 5 length bits + 32 bits for each float, and
+ * the points and on_fire with their flag */
+#define TRAJ_MAX_FRAME_BYTES ((TRAJ_N_FLOATS*39 + 1 + 32*N_PLAYERS \
+							+ N_PLAYERS + 7) / 8)
+
+/* The prediction of the fields of a frame, from the previous ones */
+struct traj_pred {
+	uint32_t last[TRAJ_N_FLOATS];
+	uint32_t delta[TRAJ_N_FLOATS];	/* last - previous */
+	uint32_t prev_delta[TRAJ_N_FLOATS];
+	unsigned char width[TRAJ_N_FLOATS];	/* of the last difference */
+	int32_t points[N_PLAYERS];
+	uint32_t on_fire;
+};
+
+struct traj_encoder {
+	FILE *f;
+	int key_interval;
+	long frames;
+	int code;	/* first error, -E_OK if none */
+
+	/* current block */
+	int n;
+	struct traj_pred pred;
+	unsigned char key[SNAPSHOT_ENCODED_SIZE];
+	uint64_t acc;
+	int n_acc;
+	unsigned char *buf, *p;
+};
+
+#define traj_encoder_valid(e) ((e)->buf != NULL)
+
+int traj_encoder_open(struct traj_encoder *e, FILE *f, int key_interval);
+	/* Write the header. key_interval is the number of frames per block,
+	 * between 1 and TRAJ_MAX_KEY_INTERVAL. Returns -E_NOMEM, -E_BADARGS
+	 * or -E_OTHER on I/O errors. */
+void traj_encode(struct traj_encoder *e, const struct game_snapshot *s);
+	/* Append a frame. Errors are kept in e->code. */
+int traj_encoder_close(struct traj_encoder *e);
+	/* Write the last block and the end mark and flush. Returns the first
+	 * error of the whole trajectory. The file is not closed. */
+
+struct traj_decoder {
+	FILE *f;
+	int key_interval;
+	long frames;
+
+	/* current block */
+	int n, block_frames;
+	struct traj_pred pred;
+	uint64_t acc;
+	int n_acc;
+	unsigned char *buf;
+	const unsigned char *p, *end;
+};
+
+#define traj_decoder_valid(d) ((d)->buf != NULL)
+
+int traj_decoder_open(struct traj_decoder *d, FILE *f);
+	/* Read the header. Returns -E_BADCFG if it is not a trajectory,
+	 * -E_NOMEM. */
+int traj_decode(struct traj_decoder *d, struct game_snapshot *s);
+	/* Returns 1 with the next frame in 's', 0 at the end mark or
+	 * -E_BADCFG if the data is cut or corrupt. */
+void traj_decoder_close(struct traj_decoder *d);
+
+#endif /* _CSLIME_TRAJ_H_ */
@@ -24,6 +24,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <math.h>
 #include <SDL/SDL.h>
@@ -31,6 +32,7 @@
 #include "common.h"
 #include "cslime.h"
 #include "cslime_ai.h"
+#include "cslime_rec.h"
 
 
 #define DEFAULT_SCALE 1500
@@ -364,9 +366,88 @@ void ui_uninit(struct uidata *ui)
 enum {NEURAL_PLAYER, GREEDY_PLAYER};
 #define NEURAL_CFG_FILE "player.net"
 
+/* frames moved per screen frame while the arrows are held */
+#define SCRUB_FRAMES 10
+
+/* Show a recorded match. The arrows move backwards and forwards through it,
+ * seeking from the keyframes of the replay. */
+void play_replay(struct uidata *ui, const struct replay_map *m)
+{
+	struct game g;
+	long frame = 0;
+	int t0 = SDL_GetTicks();
+
+	replay_map_seek(m, 0, &g);
+
+	while (1) {
+		struct input inp;
+		int new_sleep, t1;
+		long target = frame;
+
+		inp = poll_input();
+		if (inp.quit)
+			break;
+		if (inp.resize.requested)
+			uiresize(ui, inp.resize.w, inp.resize.h);
+
+		if (inp.comm.player[1].l)
+			target = (frame > SCRUB_FRAMES)? frame - SCRUB_FRAMES : 0;
+		else if (inp.comm.player[1].r)
+			target = (frame + SCRUB_FRAMES < m->frames)?
+					frame + SCRUB_FRAMES : m->frames;
+		if (target < frame)
+			replay_map_seek(m, target, &g);
+		for (; frame < target; frame++)
+			replay_map_step(m, frame, &g);
+		frame = target;
+
+		ui->gr.set_end = ui->gr.game_end = 0;
+		if (frame < m->frames) {
+			uint16_t w = replay_map_word(m, frame++);
+			struct commands comm;
+
+			replay_decode_commands(w, &comm);
+			ui->gr = run_game(&g, comm);
+			draw_game(g, ui);
+			replay_next_set(&g, ui->gr, w, m->start_points);
+			ui->t += FRAMERATE;
+		} else {
+			draw_game(g, ui);
+		}
+
+		t1 = SDL_GetTicks();
+		new_sleep = 2*FRAMERATE - (t1-t0);
+		if (new_sleep > 0)
+			SDL_Delay(new_sleep);
+		if (ui->gr.set_end && !inp.comm.player[1].r)
+			SDL_Delay(SET_INTERVAL);
+		if (inp.pause) {
+			wait_unpause();
+			t0 = SDL_GetTicks();
+		} else {
+			t0 = t1;
+		}
+	}
+}
+
 int main(int argc, char **argv)
 {
 	struct uidata ui;
+	unsigned int seed = time(NULL);
+	FILE *rec_file = NULL;
+	struct replay_map map = {0};
+
+	/* cslime -p replay, shows a recorded match */
+	if (argc > 2 && !strcmp(argv[1], "-p")) {
+		if (replay_map_open(&map, argv[2]) < 0) {
+			fprintf(stderr, "cannot open %s\n", argv[2]);
+			return E_BADARGS;
+		}
+	/* cslime [replay file], records the match */
+	} else if (argc > 1 && (rec_file = fopen(argv[1], "wb")) == NULL) {
+		fprintf(stderr, "cannot create %s\n", argv[1]);
+		return E_BADARGS;
+	}
 
 	if (SDL_Init(SDL_INIT_VIDEO|SDL_INIT_TIMER) != 0)
 		goto end_program;
@@ -374,16 +455,25 @@ int main(int argc, char **argv)
 	ui = ui_init(DEFAULT_SCALE);
 	if (!ui_ok(ui))
 		goto free_ui;
+	if (replay_map_valid(&map)) {
+		play_replay(&ui, &map);
+		goto free_ui;
+	}
 
-	srand(time(NULL));
+	srand(seed);
 	{
 		struct game g = game_init(DEF_START_POINTS, rand()%2);
+		struct replay_writer rec;
 		int t0 = SDL_GetTicks();
 		int p0_manual = 1, p1_manual = 1;
 		int player_type;
 		NeuralData brain;
 		FILE *cfg;
 
+		if (rec_file != NULL)
+			replay_writer_open(&rec, rec_file, seed,
+						DEF_START_POINTS, &g);
+
 		if ((cfg = fopen(NEURAL_CFG_FILE, "r")) != NULL
 		    && neural_bp_player_valid_data(
 				brain = neural_bp_player_fread(cfg)
@@ -398,7 +488,7 @@ int main(int argc, char **argv)
 
 		while (1) {
 			struct input inp;
-			int new_sleep, t1, i;
+			int new_sleep, t1, i, new_turn = -1;
 
 			inp = poll_input();
 			if (inp.comm.player[0].aux)
@@ -444,12 +534,20 @@ int main(int argc, char **argv)
 			} else {
 				t0 = t1;
 			}
-			if (ui.gr.game_end)
-				g = game_init(DEF_START_POINTS, rand()%2);
-			else if (ui.gr.set_end)
+			if (ui.gr.game_end) {
+				new_turn = rand()%2;
+				g = game_init(DEF_START_POINTS, new_turn);
+			} else if (ui.gr.set_end) {
 				game_reset(&g, ui.gr.has_to_start);
+			}
+			if (rec_file != NULL)
+				replay_write_frame(&rec, &inp.comm, new_turn,
+									&g);
 		}
 
+		if (rec_file != NULL
+		    && replay_writer_close(&rec, &g) < 0)
+			fprintf(stderr, "the replay could not be written\n");
 		if (player_type == NEURAL_PLAYER)
 			neural_bp_player_destroy_data(brain);
 	}
@@ -459,6 +557,9 @@ free_ui:
 	ui_uninit(&ui);
 end_program:
 	SDL_Quit();
+	if (rec_file != NULL)
+		fclose(rec_file);
+	replay_map_close(&map);
 
 	return 0;
 }
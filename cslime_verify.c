@@ -0,0 +1,408 @@
+/*
+ * cslime_verify.c
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Checks that the engine still plays recorded matches as it did when they
+ * were recorded, e.g. after changing the compiler flags or the collisions.
+ *
+ * 	cslime-verify [-t threads] replay|directory ...
+ *
+ * Every replay (see cslime_rec.h) is split at its keyframes, and each part is
+ * played from its keyframe with run_game() and compared with the next one,
+ * or with the final state. The parts of all the replays are shared among the
+ * threads. For each replay that differs, the first part that did so is
+ * reported with the fields that are not the same: the engine went a different
+ * way somewhere between those two keyframes.
+ *
+ * 	cslime-verify -r replays [-t threads] directory
+ *
+ * records that many rollouts with the current engine in the directory, to be
+ * checked by later builds.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include "common.h"
+#include "cslime.h"
+#include "cslime_rec.h"
+#include "cslime_rollout.h"
+
+#define REPLAY_SUFFIX ".csr"
+#define RECORD_FRAMES 10000
+/* rollouts recorded at the same time (each one has a file open) */
+#define RECORD_BATCH 64
+
+struct verify_file {
+	char *path;
+	struct replay_map m;
+	long bad_key;	/* first part that did not match, LONG_MAX if none */
+};
+
+struct verify_part {
+	int file;
+	long key;
+};
+
+struct verify_shared {
+	struct verify_file *files;
+	struct verify_part *parts;
+	long n_parts;
+	long next;
+};
+
+struct verify_worker {
+	struct verify_shared *shared;
+	long frames;
+	pthread_t thread;
+};
+
+static const char *const BodyName[N_PLAYERS + 1] = {"player 0", "player 1",
+									"ball"};
+static const char *const FieldName[4] = {"pos.x", "pos.y", "vel.x", "vel.y"};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static void _set_min(long *p, long v)
+{
+	long old;
+
+	while ((old = *p) > v && !__sync_bool_compare_and_swap(p, old, v))
+		;
+}
+
+static void *_verify_worker(void *arg)
+{
+	struct verify_worker *w = arg;
+	struct verify_shared *sh = w->shared;
+	long i;
+
+	while ((i = __sync_fetch_and_add(&sh->next, 1)) < sh->n_parts) {
+		struct verify_file *vf = sh->files + sh->parts[i].file;
+		const struct replay_map *m = &vf->m;
+		long k = sh->parts[i].key, left = m->frames - k*m->key_interval;
+		struct game_snapshot expected, got;
+
+		if (replay_map_check(m, k, &expected, &got) != 1)
+			_set_min(&vf->bad_key, k);
+		w->frames += (left < m->key_interval)? left : m->key_interval;
+	}
+
+	return NULL;
+}
+
+static int _cmp_files(const void *a, const void *b)
+{
+	return strcmp(((const struct verify_file *)a)->path,
+			((const struct verify_file *)b)->path);
+}
+
+static int _add_file(struct verify_file **files, int *n, int *max,
+							const char *path)
+{
+	if (*n == *max) {
+		struct verify_file *more;
+
+		*max = (*max > 0)? 2 * *max : 64;
+		more = realloc(*files, *max * sizeof(*more));
+		if (more == NULL)
+			return -E_NOMEM;
+		*files = more;
+	}
+	if (NMALLOC((*files)[*n].path, strlen(path) + 1) == NULL)
+		return -E_NOMEM;
+	strcpy((*files)[*n].path, path);
+	(*files)[*n].m.mem = NULL;
+	(*files)[*n].bad_key = LONG_MAX;
+	(*n)++;
+
+	return -E_OK;
+}
+
+/* The replays in a directory, or the file itself */
+static int _add_path(struct verify_file **files, int *n, int *max,
+							const char *path)
+{
+	DIR *d = opendir(path);
+	struct dirent *de;
+	int code = -E_OK;
+
+	if (d == NULL)
+		return _add_file(files, n, max, path);
+
+	while (code == -E_OK && (de = readdir(d)) != NULL) {
+		size_t len = strlen(de->d_name);
+		char *full;
+
+		if (len <= strlen(REPLAY_SUFFIX) || strcmp(de->d_name + len
+				- strlen(REPLAY_SUFFIX), REPLAY_SUFFIX))
+			continue;
+		if (NMALLOC(full, strlen(path) + len + 2) == NULL) {
+			code = -E_NOMEM;
+			break;
+		}
+		sprintf(full, "%s/%s", path, de->d_name);
+		code = _add_file(files, n, max, full);
+		free(full);
+	}
+	closedir(d);
+
+	return code;
+}
+
+static void _print_diff(const struct game_snapshot *expected,
+					const struct game_snapshot *got)
+{
+	int i, k;
+
+	for (i = 0; i < N_PLAYERS + 1; i++) {
+		for (k = 0; k < 4; k++) {
+			if (!memcmp(&expected->body[i][k], &got->body[i][k],
+							sizeof(float)))
+				continue;
+			printf("\t%s %s: recorded %.9g, played %.9g\n",
+				BodyName[i], FieldName[k],
+				expected->body[i][k], got->body[i][k]);
+		}
+	}
+	for (i = 0; i < N_PLAYERS; i++) {
+		if (expected->points[i] != got->points[i])
+			printf("\t%s points: recorded %d, played %d\n",
+				BodyName[i], (int)expected->points[i],
+				(int)got->points[i]);
+	}
+	if (expected->on_fire != got->on_fire)
+		printf("\ton_fire: recorded %u, played %u\n",
+			(unsigned)expected->on_fire, (unsigned)got->on_fire);
+}
+
+/* Print the replays that differ. Returns how many. */
+static int _report(const struct verify_file *files, int n)
+{
+	int i, bad = 0;
+
+	for (i = 0; i < n; i++) {
+		const struct verify_file *vf = files + i;
+		const struct replay_map *m = &vf->m;
+		struct game_snapshot expected, got;
+		long from, to;
+
+		if (vf->bad_key == LONG_MAX)
+			continue;
+		bad++;
+		from = vf->bad_key * m->key_interval;
+		to = from + m->key_interval;
+		if (to > m->frames)
+			to = m->frames;
+		if (replay_map_check(m, vf->bad_key, &expected, &got) < 0) {
+			printf("%s: corrupt keyframe at frame %ld\n", vf->path,
+									from);
+			continue;
+		}
+		printf("%s: DIFFERENT between frames %ld and %ld\n", vf->path,
+								from, to);
+		_print_diff(&expected, &got);
+	}
+
+	return bad;
+}
+
+static int verify(struct verify_file *files, int n, int n_threads)
+{
+	struct verify_shared sh = {files, NULL, 0, 0};
+	struct verify_worker *workers = NULL;
+	long frames = 0, p = 0;
+	int i, k, started, bad = 0, code = -E_NOMEM;
+	double t0, t;
+
+	qsort(files, n, sizeof(*files), _cmp_files);
+	for (i = 0; i < n; i++) {
+		if (replay_map_open(&files[i].m, files[i].path) < 0) {
+			printf("%s: not a replay with an index\n",
+								files[i].path);
+			bad++;
+			continue;
+		}
+		sh.n_parts += files[i].m.n_keys;
+	}
+
+	if (NMALLOC(sh.parts, sh.n_parts + 1) == NULL
+	    || NCALLOC(workers, n_threads) == NULL)
+		goto verify_end;
+	for (i = 0; i < n; i++) {
+		for (k = 0; replay_map_valid(&files[i].m)
+					&& k < files[i].m.n_keys; k++) {
+			sh.parts[p].file = i;
+			sh.parts[p++].key = k;
+		}
+	}
+
+	/* The calling thread is the first worker. If some threads cannot be
+	 * created, the ones that were take their parts. */
+	t0 = now();
+	for (i = 0; i < n_threads; i++)
+		workers[i].shared = &sh;
+	for (started = 1; started < n_threads; started++) {
+		if (pthread_create(&workers[started].thread, NULL,
+					_verify_worker, workers + started)) {
+			fprintf(stderr, "only %d threads could be started\n",
+								started);
+			break;
+		}
+	}
+	_verify_worker(workers);
+	for (i = 1; i < started; i++)
+		pthread_join(workers[i].thread, NULL);
+	for (i = 0; i < started; i++)
+		frames += workers[i].frames;
+	t = now() - t0;
+
+	bad += _report(files, n);
+	printf("%d replays, %ld frames, %d different, %.0f replays/min, "
+		"%.0f frames/s with %d threads\n", n, frames, bad,
+		60 * n / t, frames / t, started);
+	code = bad? -E_OTHER : -E_OK;
+
+verify_end:
+	for (i = 0; i < n; i++)
+		replay_map_close(&files[i].m);
+	free(sh.parts);
+	free(workers);
+
+	return code;
+}
+
+/* Greedy against greedy or against passive greedy, from both turns */
+static int record(const char *dir, int n, int n_threads)
+{
+	struct rollout_pool rp;
+	struct rollout_job jobs[RECORD_BATCH];
+	struct rollout_result res[RECORD_BATCH];
+	char *path = NULL;
+	int i, j, batch, code;
+
+	rp = rollout_pool_create(n_threads, &code);
+	if (!rollout_pool_valid(rp))
+		goto record_end;
+	if (NMALLOC(path, strlen(dir) + 32) == NULL) {
+		code = -E_NOMEM;
+		goto record_end;
+	}
+
+	memset(jobs, 0, sizeof(jobs));
+	for (i = 0; i < n && code == -E_OK; i += batch) {
+		batch = (n - i < RECORD_BATCH)? n - i : RECORD_BATCH;
+
+		for (j = 0; j < batch && code == -E_OK; j++) {
+			struct rollout_job *job = jobs + j;
+
+			job->g = game_init(DEF_START_POINTS, (i + j)%2);
+			job->policy[0].kind = POLICY_GREEDY;
+			job->policy[1].kind = ((i + j)/2 % 2)? POLICY_GREEDY
+						: POLICY_GREEDY_PASSIVE;
+			job->max_frames = RECORD_FRAMES;
+			job->seed = i + j + 1;
+			sprintf(path, "%s/%06d" REPLAY_SUFFIX, dir, i + j);
+			if ((job->replay = fopen(path, "wb")) == NULL) {
+				fprintf(stderr, "cannot create %s\n", path);
+				code = -E_BADARGS;
+			}
+		}
+		if (code == -E_OK)
+			code = rollout_run(&rp, jobs, batch, res);
+		for (j = 0; j < batch; j++) {
+			if (jobs[j].replay != NULL)
+				fclose(jobs[j].replay);
+			jobs[j].replay = NULL;
+		}
+	}
+
+record_end:
+	free(path);
+	if (rollout_pool_valid(rp))
+		rollout_pool_destroy(rp);
+	return code;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-t threads] replay|directory ...\n"
+		"       %s -r replays [-t threads] directory\n"
+		"Plays the replays again and reports the ones that end up in a "
+		"different state\nthan recorded. With -r, records new ones in "
+		"the directory.\n", prog, prog);
+}
+
+int main(int argc, char *argv[])
+{
+	struct verify_file *files = NULL;
+	int n_threads = sysconf(_SC_NPROCESSORS_ONLN), n_record = 0;
+	int opt, i, n = 0, max = 0, code = -E_OK;
+
+	while ((opt = getopt(argc, argv, "r:t:h")) != -1) {
+		switch (opt) {
+		case 'r': n_record = atoi(optarg);	break;
+		case 't': n_threads = atoi(optarg);	break;
+		default:
+			usage(argv[0]);
+			return E_BADARGS;
+		}
+	}
+	if (optind == argc || n_threads < 1
+	    || (n_record > 0 && optind != argc - 1)) {
+		usage(argv[0]);
+		return E_BADARGS;
+	}
+
+	if (n_record > 0) {
+		code = record(argv[optind], n_record, n_threads);
+		if (code < 0)
+			fprintf(stderr, "the replays could not be recorded\n");
+		return -code;
+	}
+
+	for (i = optind; i < argc && code == -E_OK; i++)
+		code = _add_path(&files, &n, &max, argv[i]);
+	if (code == -E_OK)
+		code = verify(files, n, n_threads);
+
+	for (i = 0; i < n; i++)
+		free(files[i].path);
+	free(files);
+
+	return -code;
+}
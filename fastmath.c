@@ -0,0 +1,43 @@
+/*
+ * fastmath.c
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#define _FMKW
+
+#include "fastmath.h"
+
+/* Blocks with a constant trip count are vectorized even with the cheap cost
+ * model of -O2 */
+#define FM_BLOCK 8
+
+void fm_tanhf_array(float *x, int n)
+{
+	int i, j;
+
+	for (i = 0; i + FM_BLOCK <= n; i += FM_BLOCK) {
+		for (j = 0; j < FM_BLOCK; j++)
+			x[i + j] = fm_tanhf(x[i + j]);
+	}
+	for (; i < n; i++)
+		x[i] = fm_tanhf(x[i]);
+}
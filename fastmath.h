@@ -0,0 +1,253 @@
+/*
+ * fastmath.h
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Tiered versions of the libm functions used by the engine and the AI.
+ * FASTMATH_TIER selects what fm_hypotf(), fm_atan2f(), fm_sincosf() and
+ * fm_tanhf() are:
+ *
+ * 	FASTMATH_LIBM (0, the default)	the libm functions
+ * 	FASTMATH_ACCURATE (1)		polynomials and rationals with about
+ * 					the error of the float libm
+ * 	FASTMATH_FAST (2)		shorter ones
+ *
+ * vector.h and nn.c use them, so building with e.g. -DFASTMATH_TIER=2 changes
+ * the whole program. The functions of each tier can also be called directly
+ * (fm_atan2f_1, fm_tanhf_2...) whatever the switch says.
+ *
+ * Maximum absolute errors against the double precision libm, measured by
+ * "cslime-bench math" (hypot: relative error):
+ *
+ * 			libm	 accurate	fast
+ * 	hypotf		1.2e-7	 2.2e-7		2.2e-7
+ * 	atan2f		2.3e-7	 2.7e-7		1.2e-5
+ * 	sincosf		3e-8	 1.2e-7		1.0e-5
+ * 	tanhf		9e-8	 2.9e-7		4.8e-5
+ *
+ * The sines and cosines are for |angle| < 1e4, with or without -ffast-math.
+ * tanh is computed with the argument clamped to a range beyond which the
+ * approximation is constant. Both tiers compute hypot as sqrtf(x*x + y*y),
+ * which is faster than hypotf() and accurate enough for the court sizes.
+ *
+ * The approximations do not branch, and the same expressions are used by the
+ * 4, 8 and 16 wide versions in vector_wide.h, which give the same results
+ * lane by lane.
+ */
+
+#ifndef _FASTMATH_H_
+#define _FASTMATH_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define FASTMATH_LIBM 0
+#define FASTMATH_ACCURATE 1
+#define FASTMATH_FAST 2
+
+#ifndef FASTMATH_TIER
+#define FASTMATH_TIER FASTMATH_LIBM
+#endif
+
+#ifndef _FMKW
+#define _FMKW extern
+#endif
+
+/* Coefficients, fitted with the Remez algorithm. They are written as macros
+ * of the argument so that they work on floats and on GCC vectors alike.
+ * atan(a) = a*P(a^2) for a in [0, 1] */
+#define FM_ATAN_1(s) (0.99999934f + (s)*(-0.33329861f + (s)*(0.19946565f \
+	+ (s)*(-0.13908628f + (s)*(0.09642194f + (s)*(-0.05591229f \
+	+ (s)*(0.02186294f + (s)*-0.00405456f)))))))
+#define FM_ATAN_2(s) (0.99986633f + (s)*(-0.33030479f + (s)*(0.18015930f \
+	+ (s)*(-0.08515635f + (s)*0.02084512f))))
+
+/* sin(r) = r*S(r^2), cos(r) = C(r^2) for |r| <= pi/4 */
+#define FM_SIN_1(s) (0.99999998f + (s)*(-0.16666623f + (s)*(0.00833113f \
+	+ (s)*-0.00019420f)))
+#define FM_COS_1(s) (0.99999997f + (s)*(-0.49999857f + (s)*(0.04165503f \
+	+ (s)*-0.00135859f)))
+#define FM_SIN_2(s) (0.99999500f + (s)*(-0.16660162f + (s)*0.00812156f))
+#define FM_COS_2(s) (0.99999003f + (s)*(-0.49970814f + (s)*0.04039854f))
+
+/* tanh(t) = t*P(t^2)/Q(t^2) for |t| <= FM_TANH_MAX */
+#define FM_TANH_MAX_1 7.90531110763549805f
+#define FM_TANH_P_1(s) (4.89352455891786e-03f + (s)*(6.37261928875436e-04f \
+	+ (s)*(1.48572235717979e-05f + (s)*(5.12229709037114e-08f \
+	+ (s)*(-8.60467152213735e-11f + (s)*(2.00018790482477e-13f \
+	+ (s)*-2.76076847742355e-16f))))))
+#define FM_TANH_Q_1(s) (4.89352518554385e-03f + (s)*(2.26843463243900e-03f \
+	+ (s)*(1.18534705686654e-04f + (s)*1.19825839466702e-06f)))
+#define FM_TANH_MAX_2 5.0f
+#define FM_TANH_P_2(s) (0.99981028f + (s)*(0.10172513f + (s)*0.00065500f))
+#define FM_TANH_Q_2(s) (1.0f + (s)*(0.43450640f + (s)*0.01263976f))
+
+#define FM_PI 3.14159265f
+#define FM_PI_2 1.57079633f
+#define FM_2_PI 0.63661977f
+
+/* pi/2 in three parts, with few significant bits in the first two so that
+ * multiplying them by the quadrant is exact */
+#define FM_PIO2_HI 1.5703125f
+#define FM_PIO2_MID 4.837512969970703125e-4f
+#define FM_PIO2_LO 7.54978995489188216e-8f
+
+/* Keeps -ffast-math from folding the three parts back into one constant.
+ * FM_BARRIER_MEM is for the GCC vectors that do not fit in a register. */
+#if defined(__GNUC__) && defined(__SSE__)
+#define FM_BARRIER(x) __asm__("" : "+xm" (x))
+#define FM_BARRIER_MEM(x) __asm__("" : "+m" (x))
+#elif defined(__GNUC__)
+#define FM_BARRIER(x) __asm__("" : "+m" (x))
+#define FM_BARRIER_MEM(x) __asm__("" : "+m" (x))
+#else
+#define FM_BARRIER(x)
+#define FM_BARRIER_MEM(x)
+#endif
+
+_FMKW inline uint32_t _fm_bits(float f)
+{
+	uint32_t u;
+
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+_FMKW inline float _fm_float(uint32_t u)
+{
+	float f;
+
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+/* hypot */
+
+_FMKW inline float fm_hypotf_1(float x, float y)
+{
+	return sqrtf(x*x + y*y);
+}
+
+#define fm_hypotf_2 fm_hypotf_1
+
+/* atan2. atan2(0, 0) is 0, whatever the signs. */
+
+#define _FM_ATAN2(name, poly)						\
+_FMKW inline float name(float y, float x)				\
+{									\
+	float ax = fabsf(x), ay = fabsf(y);				\
+	float mx = (ay > ax)? ay : ax, mn = (ay > ax)? ax : ay;		\
+	float a = (mx > 0)? mn / mx : 0;				\
+	float r = a*poly(a*a);						\
+									\
+	r = (ay > ax)? FM_PI_2 - r : r;					\
+	r = (x < 0)? FM_PI - r : r;					\
+	return _fm_float(_fm_bits(r) | (_fm_bits(y) & 0x80000000u));	\
+}
+
+_FM_ATAN2(fm_atan2f_1, FM_ATAN_1)
+_FM_ATAN2(fm_atan2f_2, FM_ATAN_2)
+
+/* sincos. The angle is reduced to r in [-pi/4, pi/4] and the quadrant k,
+ * then sin and cos of r are swapped and negated according to k. */
+
+#define _FM_SINCOS(name, sin_poly, cos_poly)				\
+_FMKW inline void name(float a, float *s, float *c)			\
+{									\
+	float t = a * FM_2_PI;						\
+	int32_t k = t + ((t < 0)? -.5f : .5f);				\
+	float kf = k;							\
+	float r = a - kf*FM_PIO2_HI, r2, sn, cs;			\
+	uint32_t sign_s, sign_c;					\
+									\
+	FM_BARRIER(r);							\
+	r -= kf*FM_PIO2_MID;						\
+	FM_BARRIER(r);							\
+	r -= kf*FM_PIO2_LO;						\
+	r2 = r*r;							\
+	sn = r*sin_poly(r2);						\
+	cs = cos_poly(r2);						\
+	sign_s = -(uint32_t)((k >> 1) & 1) & 0x80000000u;		\
+	sign_c = -(uint32_t)(((k + 1) >> 1) & 1) & 0x80000000u;		\
+									\
+	*s = _fm_float(_fm_bits((k & 1)? cs : sn) ^ sign_s);		\
+	*c = _fm_float(_fm_bits((k & 1)? sn : cs) ^ sign_c);		\
+}
+
+_FM_SINCOS(fm_sincosf_1, FM_SIN_1, FM_COS_1)
+_FM_SINCOS(fm_sincosf_2, FM_SIN_2, FM_COS_2)
+
+/* tanh */
+
+#define _FM_TANH(name, max, p, q)					\
+_FMKW inline float name(float x)					\
+{									\
+	float t = (x > max)? max : ((x < -max)? -max : x);		\
+	float s = t*t;							\
+									\
+	return t*p(s) / q(s);						\
+}
+
+_FM_TANH(fm_tanhf_1, FM_TANH_MAX_1, FM_TANH_P_1, FM_TANH_Q_1)
+_FM_TANH(fm_tanhf_2, FM_TANH_MAX_2, FM_TANH_P_2, FM_TANH_Q_2)
+
+void fm_tanhf_array(float *x, int n);
+	/* x[i] = fm_tanhf(x[i]), written so that the compiler vectorizes it */
+
+/* The functions selected by FASTMATH_TIER */
+
+#if FASTMATH_TIER == FASTMATH_LIBM
+#define fm_hypotf hypotf
+#define fm_atan2f atan2f
+#define fm_tanhf tanhf
+
+_FMKW inline void fm_sincosf(float a, float *s, float *c)
+{
+#ifdef _GNU_SOURCE
+	sincosf(a, s, c);
+#else
+	*s = sinf(a);
+	*c = cosf(a);
+#endif /* _GNU_SOURCE */
+}
+#elif FASTMATH_TIER == FASTMATH_ACCURATE
+#define fm_hypotf fm_hypotf_1
+#define fm_atan2f fm_atan2f_1
+#define fm_sincosf fm_sincosf_1
+#define fm_tanhf fm_tanhf_1
+#define FM_ATAN FM_ATAN_1
+#define FM_SIN FM_SIN_1
+#define FM_COS FM_COS_1
+#elif FASTMATH_TIER == FASTMATH_FAST
+#define fm_hypotf fm_hypotf_2
+#define fm_atan2f fm_atan2f_2
+#define fm_sincosf fm_sincosf_2
+#define fm_tanhf fm_tanhf_2
+#define FM_ATAN FM_ATAN_2
+#define FM_SIN FM_SIN_2
+#define FM_COS FM_COS_2
+#else
+#error "Unknown FASTMATH_TIER"
+#endif /* FASTMATH_TIER */
+
+#endif /* _FASTMATH_H_ */
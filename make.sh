@@ -1,2 +1,32 @@
 #!/bin/sh
-gcc -pedantic -Wall -lSDL -lSDL_gfx -O2 -ffast-math cslime.c cslime_ui.c cslime_ai.c vector.c -o cslime
+# Usage: ./make.sh [headless]
+# Builds the physics/AI library (libcslime.a, libcslime.so), the benchmark
+# (cslime-bench), the environment server (cslime-server), the replay player
+# (cslime-replay), the replay verifier (cslime-verify) and, unless "headless"
+# is given, the SDL front-end (cslime).
+# Extra definitions can be passed in DEFS, e.g. DEFS=-DCSLIME_FIXED_POINT
+set -e
+
+CC=${CC:-gcc}
+CFLAGS="${CFLAGS:--pedantic -Wall -O2 -ffast-math -fgnu89-inline} $DEFS"
+LIB_SRC="cslime.c cslime_fixed.c cslime_ccd.c cslime_adaptive.c cslime_multi.c cslime_batch.c cslime_env.c cslime_shm.c cslime_snap.c cslime_rec.c cslime_traj.c cslime_rollout.c cslime_ai.c vector.c fastmath.c nn.c mat/mat.c mat/mat_math.c mat/mat_io.c"
+
+LIB_OBJ=""
+for src in $LIB_SRC; do
+	obj=${src%.c}.o
+	$CC $CFLAGS -fPIC -c $src -o $obj
+	LIB_OBJ="$LIB_OBJ $obj"
+done
+
+rm -f libcslime.a
+ar rcs libcslime.a $LIB_OBJ
+$CC -shared $LIB_OBJ -o libcslime.so -lm -pthread -lrt
+
+$CC $CFLAGS cslime_bench.c libcslime.a -o cslime-bench -lm -pthread -lrt
+$CC $CFLAGS cslime_server.c libcslime.a -o cslime-server -lm -pthread -lrt
+$CC $CFLAGS cslime_replay.c libcslime.a -o cslime-replay -lm -pthread -lrt
+$CC $CFLAGS cslime_verify.c libcslime.a -o cslime-verify -lm -pthread -lrt
+
+if [ "$1" != "headless" ]; then
+	$CC $CFLAGS cslime_ui.c libcslime.a -o cslime -lSDL -lSDL_gfx -lm -pthread -lrt
+fi
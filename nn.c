@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <math.h>
 #include "common.h"
+#include "fastmath.h"
 
 #ifdef NN_DEBUG
 #include "vector.h"
@@ -16,8 +17,8 @@
 #include "mat/mat_math.h"
 #include "mat/mat_io.h"
 
-/* activation function */
-#define perceptron_tf tanhf
+/* The activation function is tanh, fm_tanhf() of fastmath.h. It is applied
+ * to a whole layer at once, see MLPLayer_eval(). */
 
 static inline numeric _sq(numeric x)
 {
@@ -25,10 +26,14 @@ static inline numeric _sq(numeric x)
 }
 
 /* derivative of the activation function
- * d/dx(tanh(x)) = sech^2(x) = (1/cosh(x))^2 */
+ * d/dx(tanh(x)) = sech^2(x) = (1/cosh(x))^2 = 1 - tanh(x)^2 */
 static inline numeric d_perceptron_tf(numeric x)
 {
+#if FASTMATH_TIER == FASTMATH_LIBM
 	return _sq(1/coshf(x));
+#else
+	return 1 - _sq(fm_tanhf(x));
+#endif
 }
 
 const struct MLPLayer MLPLayer_INVALID = {MAT_INVALID_TXT, MAT_INVALID_TXT};
@@ -87,7 +92,8 @@ void MLPLayer_randFill(struct MLPLayer l)
 
 void MLPLayer_eval(struct MLPLayer *l, struct matrix vec, struct matrix dest)
 {
-	mat_FMA2(l->w, vec, l->w0, dest, perceptron_tf);
+	mat_FMA(l->w, vec, l->w0, dest);
+	fm_tanhf_array(dest.M, mat_length(dest));
 }
 
 /* err y new_err pueden superponerse en la memoria */
@@ -257,6 +263,27 @@ MLP_create_end:
 	return r;
 }
 
+struct MLP MLP_share(struct MLP mlp, int *ret_code)
+{
+	int _ret_code;
+	struct MLP r;
+
+	r = MLP_create_from_layers(mlp.layers, mlp.n_layers, &_ret_code);
+	if (_ret_code < 0)
+		MLP_mark_invalid(r);
+
+	if (ret_code != NULL)
+		*ret_code = _ret_code;
+
+	return r;
+}
+
+void MLP_unshare(struct MLP mlp)
+{
+	free(mlp.work_area_even);
+	free(mlp.work_area_odd);
+}
+
 int MLP_fwrite(struct MLP mlp, FILE *f)
 {
 	int count = 0, i;
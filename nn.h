@@ -41,6 +41,13 @@ int MLP_n_outputs(struct MLP mlp);
 struct MLP MLP_create(const int *layer_sizes, int layer_sizes_n, int *ret_code);
 void MLP_destroy(struct MLP mlp);
 
+/* MLP_eval uses the work areas of the network, so a network cannot be
+ * evaluated from two threads at once. MLP_share gives a network that uses the
+ * same layers, with its own work areas. It must be released with MLP_unshare
+ * before destroying the original. */
+struct MLP MLP_share(struct MLP mlp, int *ret_code);
+void MLP_unshare(struct MLP mlp);
+
 MLPTrainSpace MLP_create_train_space(struct MLP mlp);
 void MLP_destroy_train_space(struct MLP mlp, MLPTrainSpace ts);
 #define MLP_ts_valid(ts) ((ts) != NULL)
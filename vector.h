@@ -25,6 +25,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include "vector_common.h"
+#include "fastmath.h"
 
 #ifndef _VKW
 
@@ -68,7 +69,7 @@ _VKW inline struct p_vector p_make(float value, float titha)
 
 _VKW inline float r_abs(struct r_vector v)
 {
-	return hypotf(v.x, v.y);
+	return fm_hypotf(v.x, v.y);
 }
 
 _VKW inline struct r_vector r_scale(struct r_vector v, float a)
@@ -131,13 +132,8 @@ _VKW inline struct r_vector p_to_r(struct p_vector v)
 {
 	struct r_vector r;
 	float s, c;
-#ifdef _GNU_SOURCE
-	sincosf(v.titha, &s, &c)
-#else
-	s = sinf(v.titha);
-	c = cosf(v.titha);
-#endif /* _GNU_SOURCE */
 
+	fm_sincosf(v.titha, &s, &c);
 	r.x = v.value * c;
 	r.y = v.value * s;
 
@@ -148,8 +144,8 @@ _VKW inline struct p_vector r_to_p(struct r_vector r)
 {
 	struct p_vector v;
 
-	v.value = hypotf(r.x, r.y);
-	v.titha = atan2f(r.y, r.x);
+	v.value = fm_hypotf(r.x, r.y);
+	v.titha = fm_atan2f(r.y, r.x);
 
 	return v;
 }
@@ -242,12 +238,12 @@ _VKW inline struct r_vector r_toruswrap(struct r_vector v, struct limit lim_x,
 
 _VKW inline float r_dist(struct r_vector v1, struct r_vector v2)
 {
-	return hypotf(v1.x - v2.x, v1.y - v2.y);
+	return fm_hypotf(v1.x - v2.x, v1.y - v2.y);
 }
 
 _VKW inline float r_angle(struct r_vector v)
 {
-	return atan2(v.y, v.x);
+	return fm_atan2f(v.y, v.x);
 }
 
 _VKW inline float r_dot(struct r_vector v1, struct r_vector v2)
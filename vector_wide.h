@@ -0,0 +1,110 @@
+/*
+ * vector_wide.h
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Wide versions of the r_vector operations of vector.h.
+ * A struct r_vector4 holds four r_vectors, as a vector of x and a vector of
+ * y, and r4_sum(), r4_dot(), r4_clip()... do to each of them what r_sum(),
+ * r_dot(), r_clip()... do to one. The same goes for r_vector8/r8_ and
+ * r_vector16/r16_. Each lane is computed with the same operations as the
+ * scalar function, so the results are the same (except for r_abs and its
+ * users, which use hypotf() and are within a rounding of the wide version).
+ *
+ * The types are GCC vectors, so the compiler emits SSE, AVX or NEON
+ * instructions depending on the target flags and splits the wide types into
+ * several registers when they do not fit in one.
+ * Lanes are loaded from and stored to structure-of-arrays storage (one array
+ * for x and one for y, like struct body_lanes in cslime_batch.h) with
+ * rN_load() and rN_store(); they need not be aligned. The 8 and 16 wide types
+ * are only aligned to 16 bytes, so that they are passed around like the 4 wide
+ * ones on targets without AVX.
+ */
+
+#ifndef _VECTOR_WIDE_H_
+#define _VECTOR_WIDE_H_
+
+#include <string.h>
+#include "vector.h"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#define _RW_INLINE inline __attribute__((always_inline))
+
+/* Lane by lane comparisons, giving -1 where true and 0 where false. GCC does
+ * the comparisons of vectors wider than the registers of the target one lane
+ * at a time, so these go through them four lanes at a time. */
+#define _rw_cmp(a, op, b) (__extension__ ({				\
+	union {								\
+		__typeof__(a) v;					\
+		v4f q[4];						\
+	} _a = {(a)}, _b = {(b)};					\
+	union {								\
+		__typeof__((a) op (b)) v;				\
+		v4i q[4];						\
+	} _m;								\
+									\
+	_m.q[0] = _a.q[0] op _b.q[0];					\
+	if (sizeof(a) > 16) 						\
+		_m.q[1] = _a.q[1] op _b.q[1];				\
+	if (sizeof(a) > 32) {						\
+		_m.q[2] = _a.q[2] op _b.q[2];				\
+		_m.q[3] = _a.q[3] op _b.q[3];				\
+	}								\
+	_m.v;								\
+}))
+
+#define rw_lt(a, b) _rw_cmp(a, <, b)
+#define rw_gt(a, b) _rw_cmp(a, >, b)
+
+/* mask ? a : b, lane by lane */
+#define rw_select(mask, a, b) ((__typeof__(a))(((mask) & (__typeof__(mask))(a)) \
+					| (~(mask) & (__typeof__(mask))(b))))
+
+/* Macros rather than functions, vectors wider than the registers of the
+ * target cannot be passed as arguments without changing the ABI */
+#define r4_make(x, y) ((struct r_vector4){(x), (y)})
+#define r8_make(x, y) ((struct r_vector8){(x), (y)})
+#define r16_make(x, y) ((struct r_vector16){(x), (y)})
+
+#define _RW_GLUE(a,b) _RW_GLUE_AGAIN(a,b)
+#define _RW_GLUE_AGAIN(a,b) a ## b
+
+/* The functions are always inlined, so the warnings about returning vectors
+ * wider than the registers of the target do not apply. GCC also gives them
+ * where the 8 and 16 wide functions are called, so the files that use those
+ * turn -Wpsabi off themselves. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+#define RW_N 4
+#include "vector_wide_t.h"
+#define RW_N 8
+#include "vector_wide_t.h"
+#define RW_N 16
+#include "vector_wide_t.h"
+
+#pragma GCC diagnostic pop
+
+#endif /* _VECTOR_WIDE_H_ */
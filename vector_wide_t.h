@@ -0,0 +1,295 @@
+/*
+ * vector_wide_t.h
+ *
+ * Copyright 2013:
+ * 	Juan I Carrano <juan@carrano.com.ar>
+ * 	Marcelo Lerendegui <marcelolerendegui@gmail.com>
+ * 	Juan Manuel Oxoby <jm@oxoby.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Template for the wide vector types of vector_wide.h. Not a regular header:
+ * it is included once for each width, with RW_N defined to the number of
+ * lanes (a multiple of 4).
+ */
+
+#ifndef RW_N
+#error "vector_wide_t.h needs RW_N"
+#endif
+
+#define RW_F _RW_GLUE(_RW_GLUE(v, RW_N), f)	/* v4f */
+#define RW_I _RW_GLUE(_RW_GLUE(v, RW_N), i)	/* v4i */
+#define RW_T _RW_GLUE(r_vector, RW_N)		/* r_vector4 */
+#define RW_P _RW_GLUE(p_vector, RW_N)		/* p_vector4 */
+#define RW_PFN(op) _RW_GLUE(_RW_GLUE(_RW_GLUE(p, RW_N), _), op) /* p4_op */
+#define RW_FN(op) _RW_GLUE(_RW_GLUE(_RW_GLUE(r, RW_N), _), op) /* r4_op */
+
+typedef float RW_F __attribute__((vector_size(RW_N*sizeof(float)),
+								aligned(16)));
+typedef int RW_I __attribute__((vector_size(RW_N*sizeof(int)), aligned(16)));
+
+struct RW_T {
+	RW_F x, y;
+};
+
+struct RW_P {
+	RW_F value, titha;
+};
+
+static _RW_INLINE RW_F RW_FN(set1)(float a)
+{
+	RW_F v;
+	int i;
+
+	for (i = 0; i < RW_N; i++)
+		v[i] = a;
+	return v;
+}
+
+/* Construction and access */
+
+static _RW_INLINE struct RW_T RW_FN(splat)(struct r_vector r)
+{
+	return RW_FN(make)(RW_FN(set1)(r.x), RW_FN(set1)(r.y));
+}
+
+static _RW_INLINE struct RW_T RW_FN(load)(const float *x, const float *y)
+{
+	struct RW_T v;
+
+	memcpy(&v.x, x, sizeof(v.x));
+	memcpy(&v.y, y, sizeof(v.y));
+	return v;
+}
+
+static _RW_INLINE void RW_FN(store)(struct RW_T v, float *x, float *y)
+{
+	memcpy(x, &v.x, sizeof(v.x));
+	memcpy(y, &v.y, sizeof(v.y));
+}
+
+static _RW_INLINE struct r_vector RW_FN(get)(struct RW_T v, int lane)
+{
+	return r_make(v.x[lane], v.y[lane]);
+}
+
+/* The operations of vector.h */
+
+static _RW_INLINE struct RW_T RW_FN(sum)(struct RW_T v1, struct RW_T v2)
+{
+	v1.x += v2.x;
+	v1.y += v2.y;
+
+	return v1;
+}
+
+static _RW_INLINE struct RW_T RW_FN(subs)(struct RW_T v1, struct RW_T v2)
+{
+	v1.x -= v2.x;
+	v1.y -= v2.y;
+
+	return v1;
+}
+
+static _RW_INLINE struct RW_T RW_FN(scale)(struct RW_T v, float a)
+{
+	v.x *= RW_FN(set1)(a);
+	v.y *= RW_FN(set1)(a);
+
+	return v;
+}
+
+static _RW_INLINE RW_F RW_FN(abs2)(struct RW_T v)
+{
+	return v.x*v.x + v.y*v.y;
+}
+
+static _RW_INLINE RW_F RW_FN(abs)(struct RW_T v)
+{
+#ifdef __SSE__
+	union {
+		RW_F v;
+		__m128 q[RW_N/4];
+	} u;
+	int i;
+
+	u.v = RW_FN(abs2)(v);
+	for (i = 0; i < RW_N/4; i++)
+		u.q[i] = _mm_sqrt_ps(u.q[i]);
+	return u.v;
+#else
+	RW_F a = RW_FN(abs2)(v);
+	int i;
+
+	for (i = 0; i < RW_N; i++)
+		a[i] = sqrtf(a[i]);
+	return a;
+#endif /* __SSE__ */
+}
+
+static _RW_INLINE struct RW_T RW_FN(unit)(struct RW_T v)
+{
+	RW_F inv = 1.0f / RW_FN(abs)(v);
+
+	v.x *= inv;
+	v.y *= inv;
+
+	return v;
+}
+
+static _RW_INLINE RW_F RW_FN(dot)(struct RW_T v1, struct RW_T v2)
+{
+	return v1.x * v2.x + v1.y * v2.y;
+}
+
+static _RW_INLINE RW_F RW_FN(dist)(struct RW_T v1, struct RW_T v2)
+{
+	return RW_FN(abs)(RW_FN(subs)(v1, v2));
+}
+
+static _RW_INLINE RW_F RW_FN(cross_z)(struct RW_T v1, struct RW_T v2)
+{
+	return v1.x*v2.y - v1.y*v2.x;
+}
+
+static _RW_INLINE struct RW_T RW_FN(normal)(struct RW_T v)
+{
+	struct RW_T r;
+
+	r.x = -v.y;
+	r.y = v.x;
+	return r;
+}
+
+static _RW_INLINE struct RW_T RW_FN(clip)(struct RW_T v, struct limit lim_x,
+							struct limit lim_y)
+{
+	RW_F xmax = RW_FN(set1)(lim_x.max), xmin = RW_FN(set1)(lim_x.min);
+	RW_F ymax = RW_FN(set1)(lim_y.max), ymin = RW_FN(set1)(lim_y.min);
+
+	v.x = rw_select(rw_gt(v.x, xmax), xmax,
+				rw_select(rw_lt(v.x, xmin), xmin, v.x));
+	v.y = rw_select(rw_gt(v.y, ymax), ymax,
+				rw_select(rw_lt(v.y, ymin), ymin, v.y));
+
+	return v;
+}
+
+static _RW_INLINE struct RW_T RW_FN(norm_clip)(struct RW_T v, float lim)
+{
+	RW_F vn = RW_FN(abs)(v);
+	RW_F f = RW_FN(set1)(lim) / vn;
+	RW_I keep = rw_lt(vn, RW_FN(set1)(lim));
+
+	v.x = rw_select(keep, v.x, v.x * f);
+	v.y = rw_select(keep, v.y, v.y * f);
+
+	return v;
+}
+
+/* The trigonometry, with the functions of fastmath.h selected by
+ * FASTMATH_TIER. The approximations are the same expressions as the scalar
+ * ones. */
+
+static _RW_INLINE RW_F RW_FN(angle)(struct RW_T v)
+{
+#if FASTMATH_TIER == FASTMATH_LIBM
+	RW_F r;
+	int i;
+
+	for (i = 0; i < RW_N; i++)
+		r[i] = atan2f(v.y[i], v.x[i]);
+	return r;
+#else
+	const RW_F zero = RW_FN(set1)(0);
+	RW_F ax = (RW_F)((RW_I)v.x & INT32_MAX);
+	RW_F ay = (RW_F)((RW_I)v.y & INT32_MAX);
+	RW_I y_major = rw_gt(ay, ax);
+	RW_F mx = rw_select(y_major, ay, ax), mn = rw_select(y_major, ax, ay);
+	RW_F a = rw_select(rw_gt(mx, zero), mn / mx, zero);
+	RW_F r = a*FM_ATAN(a*a);
+
+	r = rw_select(y_major, FM_PI_2 - r, r);
+	r = rw_select(rw_lt(v.x, zero), FM_PI - r, r);
+	return (RW_F)((RW_I)r | ((RW_I)v.y & INT32_MIN));
+#endif /* FASTMATH_TIER */
+}
+
+static _RW_INLINE struct RW_P RW_FN(to_p)(struct RW_T r)
+{
+	struct RW_P v;
+
+	v.value = RW_FN(abs)(r);
+	v.titha = RW_FN(angle)(r);
+
+	return v;
+}
+
+static _RW_INLINE struct RW_T RW_PFN(to_r)(struct RW_P v)
+{
+	struct RW_T r;
+	RW_F s, c;
+#if FASTMATH_TIER == FASTMATH_LIBM
+	int i;
+
+	for (i = 0; i < RW_N; i++) {
+		float si, ci;
+
+		fm_sincosf(v.titha[i], &si, &ci);
+		s[i] = si;
+		c[i] = ci;
+	}
+#else
+	const RW_F zero = RW_FN(set1)(0);
+	RW_F t = v.titha * FM_2_PI;
+	RW_I k = __builtin_convertvector(t + rw_select(rw_lt(t, zero),
+			RW_FN(set1)(-.5f), RW_FN(set1)(.5f)), RW_I);
+	RW_F kf = __builtin_convertvector(k, RW_F);
+	RW_F red = v.titha - kf*FM_PIO2_HI, red2, sn, cs;
+	RW_I swap = -(k & 1);
+	RW_I sign_s = -((k >> 1) & 1) & INT32_MIN;
+	RW_I sign_c = -(((k + 1) >> 1) & 1) & INT32_MIN;
+
+#if RW_N == 4
+	FM_BARRIER(red);
+	red -= kf*FM_PIO2_MID;
+	FM_BARRIER(red);
+#else
+	FM_BARRIER_MEM(red);
+	red -= kf*FM_PIO2_MID;
+	FM_BARRIER_MEM(red);
+#endif
+	red -= kf*FM_PIO2_LO;
+	red2 = red*red;
+	sn = red*FM_SIN(red2);
+	cs = FM_COS(red2);
+	s = (RW_F)((RW_I)rw_select(swap, cs, sn) ^ sign_s);
+	c = (RW_F)((RW_I)rw_select(swap, sn, cs) ^ sign_c);
+#endif /* FASTMATH_TIER */
+	r.x = v.value * c;
+	r.y = v.value * s;
+
+	return r;
+}
+
+#undef RW_PFN
+#undef RW_P
+#undef RW_FN
+#undef RW_T
+#undef RW_I
+#undef RW_F
+#undef RW_N